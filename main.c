@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -8,21 +8,55 @@
 #include <semaphore.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <time.h>
 #include <stdbool.h>
 #include <signal.h>
 #include <errno.h>
 #include <spawn.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <linux/sched.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/inotify.h>
 
 // ##########################################
 // OS CONFIGURATION
 // ##########################################
-#define MAX_TASKS 20
+#define MAX_TASKS 20 // Default number of process table slots (--max-tasks)
 #define OS_NAME "NexOS"
 #define MAX_PATH_LENGTH 100
 #define TASK_NAME_LENGTH 50
-#define MAX_THREADS 5
+#define TASK_REGISTRY_PATH "./tasks/registry.conf" // Default task registry (--registry)
 #define MAX_LEVELS 3 
+#define QUANTUM_UNIT_MS 100 // Length of one time-quantum unit in milliseconds
+#define SJF_INITIAL_BURST_MS QUANTUM_UNIT_MS // Burst estimate of a process that never ran
+#define MAX_WORKER_QUEUES 64 // Simulated cores beyond this share the last worker queues
+#define BALANCE_INTERVAL_MS 200 // How often the load balancer compares the cores
+#define WORKER_IDLE_MS 2000 // A core's worker beyond the host CPU count retires after this long without work
+#define METRICS_INTERVAL_MS 1000 // Default export interval of --metrics-file
+#define MAX_METRIC_SHARDS 64 // Threads beyond this share shards
+#define TRACE_RING_EVENTS 65536 // Events kept per thread for --trace-file, a power of two
+#define MAX_TRACE_RINGS 64
+#define HISTOGRAM_BUCKETS 28 // Bucket i counts values below 2^(i + 10) ns, the last one is open
+#define TERM_TIMEOUT_MS 3000 // Grace period between SIGTERM and SIGKILL (--term-timeout)
+#define KILL_TIMEOUT_MS 1000 // How long to wait for the reap after SIGKILL
+#define USAGE_SAMPLE_MS 500 // How often the supervisor samples RSS and CPU time of tasks
+#define CPU_PERIOD_US 100000 // cpu.max period; the quota is one period per core
+#define SCROLLBACK_BYTES 65536 // Output the multiplexer keeps per task, a power of two
+#define CONSOLE_PREFIX_KEY 0x02 // Ctrl+B starts a multiplexer hotkey, as in tmux
+#define CONSOLE_DETACHED (-2) // foreground_task: the user went back to the menus
 
 // ##########################################
 // CPU SCHEDULER TYPES
@@ -31,7 +65,8 @@ typedef enum {
     SCHEDULER_FCFS,        // First-Come-First-Served
     SCHEDULER_SJF,         // Shortest Job First
     SCHEDULER_PRIORITY,    // Priority Scheduling
-    SCHEDULER_RR           // Round Robin
+    SCHEDULER_RR,          // Round Robin
+    SCHEDULER_MLFQ         // Multilevel Feedback Queue
 } SchedulerType;
 
 // ##########################################
@@ -42,13 +77,98 @@ typedef struct {
     int ram_gb;
     int hdd_gb;
     int cpu_cores;
-    int available_ram;
-    int available_hdd;
-    int available_cores;
+    uint64_t available; // Free RAM, HDD and cores, packed (see RESOURCE ACCOUNTING)
 } HardwareResources;
 
-// Process Control Block
+// Unpacked view of the free resources
+typedef struct {
+    int ram_mb;
+    int hdd_gb;
+    int cores;
+} ResourceCounts;
+
+#define RESERVATION_HELD (1 << 30)
+
+// RAM, HDD and a core held by one task; released exactly once
+typedef struct {
+    int state;          // RESERVATION_HELD | MB charged to the pool, 0 once released
+    int ram_base;       // Block in the simulated RAM
+    int ram_mb;         // Declared size of the block
+    int hdd_gb;
+} ResourceReservation;
+
+// Resource types of the deadlock avoidance engine
+#define NUM_RESOURCE_TYPES 3
+#define RESOURCE_RAM 0      // MB
+#define RESOURCE_HDD 1      // GB
+#define RESOURCE_CORES 2
+
+// How the claim engine handles requests that fit the free resources
+typedef enum {
+    DEADLOCK_AVOID,     // Banker's algorithm: grant only if the state stays safe
+    DEADLOCK_DETECT     // Grant whatever fits, find deadlocks in the wait-for graph
+} DeadlockMode;
+
+typedef enum {
+    CLAIM_GRANTED,
+    CLAIM_WAIT,         // Recorded as pending until resources are released
+    CLAIM_INVALID       // More than the process declared as its maximum
+} ClaimResult;
+
+// Maximum claims, allocations and pending requests of up to capacity processes.
+// The active processes are linked in a safe sequence: an order in which each
+// one can get its remaining need from what the earlier ones give back.
+typedef struct {
+    DeadlockMode mode;
+    int capacity;
+    int active_count;
+    int total[NUM_RESOURCE_TYPES];
+    int available[NUM_RESOURCE_TYPES];
+    int* max;               // capacity x NUM_RESOURCE_TYPES
+    int* alloc;
+    int* pending;
+    unsigned char* status;  // CLAIM_UNUSED, CLAIM_ACTIVE or CLAIM_WAITING
+    int* seq_next;          // Safe sequence (detection mode: just the active processes)
+    int* seq_prev;
+    int seq_head;
+    int seq_tail;
+    
+    // Scratch space of the safety check and the deadlock detector
+    int* counts;
+    int* stack;
+    int* sequence;
+    uint64_t* sort_keys;
+    int* order[NUM_RESOURCE_TYPES];
+    int* blocked[NUM_RESOURCE_TYPES];
+    
+    // Statistics
+    long long requests;
+    long long grants;
+    long long waits;
+    long long fast_paths;   // The requester can finish right away
+    long long prefix_checks; // Only the processes ahead in the sequence were checked
+    long long full_checks;  // A new safe sequence had to be found
+    long long check_ns;
+} ClaimTable;
+
+// Measured usage of a task's child, from /proc while it runs and from the
+// wait4 rusage once it exits. Times and faults include helpers it reaped.
 typedef struct {
+    long long sampled_ns;       // When the values were taken, 0 if never
+    int from_exit;              // Final values from wait4
+    long user_ms;
+    long system_ms;
+    long voluntary_switches;    // -1 if unknown
+    long involuntary_switches;
+    long max_rss_kb;
+    long minor_faults;
+    long major_faults;
+    long long read_bytes;       // Bytes passed through read-like syscalls, -1 if /proc/<pid>/io is unreadable
+    long long write_bytes;
+} TaskUsage;
+
+// Process Control Block
+typedef struct PCB {
     int pid;
     char name[TASK_NAME_LENGTH];
     int ram_required;
@@ -58,50 +178,488 @@ typedef struct {
     int priority;
     time_t start_time;
     char task_path[MAX_PATH_LENGTH];
+    int is_queued;              // Sitting in the ready queue
+    int is_dispatched;          // Currently holding a CPU slot (SIGCONT'ed)
+    unsigned long enqueue_seq;  // Time the process entered the ready queue (FCFS/RR order)
+    unsigned long dispatch_count;
+    long burst_estimate_ms;     // Expected CPU time of the next dispatch (SJF key)
+    int queue_level;            // Level the process was queued at
+    int mlfq_level;             // Current MLFQ level, 0 is the highest
+    int core;                   // Core whose run queue holds the process, or that dispatched it
+    int last_core;              // Core the process last ran on, -1 before its first dispatch
+    int pinned_cpu;             // Host CPU the child is pinned to, -1 if none
+    struct PCB* inject_next;    // Link in a lock-free injection stack
+    int pid_next;               // Next slot in the same PID hash bucket
+    int name_next;              // Next slot in the same name hash bucket
+    int free_next;              // Next slot in the free list
+    int child_pid;              // Live child the supervisor still has to reap, or -1
+    int child_pidfd;            // pidfd watched for the child's exit, or -1
+    int exit_status;            // Wait status of the last reaped child
+    ResourceReservation reservation; // Resources held by the task; charges measured RAM above the declared size
+    ResourceCounts granted;     // Granted on request beyond the reservation (claim_mutex)
+    int cgroup_id;              // The child runs in cgroup task-<id>, 0 if it has none
+    int terminating;            // Being terminated; its exit is not an ordinary one
+    long rss_kb;                // Last sampled resident memory
+    long peak_rss_kb;
+    long cpu_ms;                // Last sampled user + system CPU time
+    TaskUsage usage;            // Cached for the Task Manager (supervisor_mutex)
+    struct PageTable* page_table; // Virtual memory of the process (memory manager)
 } PCB;
 
+// Writers of the process table serialize on a futex; readers never block
+// them and retry when the sequence moved while they read
+typedef struct {
+    int state;                  // 0 unlocked, 1 locked, 2 locked with sleepers
+    unsigned int sequence;      // Odd while a writer is inside
+} TableLock;
+
+// Copy of the fields the process lists show, taken consistently
+typedef struct {
+    int index;                  // Slot in process_table when the copy was taken
+    int pid;
+    char name[TASK_NAME_LENGTH];
+    int ram_required;
+    int hdd_required;
+    int priority;
+    long rss_kb;
+    long cpu_ms;
+    int sampled;                // The supervisor sampled usage at least once
+    int is_minimized;
+    int is_dispatched;
+    int is_queued;
+    time_t start_time;
+    TaskUsage usage;
+} ProcessRow;
+
 // Structure for thread arguments
 typedef struct {
     int task_id;
     int thread_id;
 } ThreadArgs;
 
-// Structure for multilevel queue scheduling
+// Entry of a binary min-heap; ties on key are broken by insertion order
+typedef struct {
+    long long key;
+    unsigned long seq;
+    void* item;
+} HeapEntry;
+
+// Growable binary min-heap
+typedef struct {
+    HeapEntry* entries;
+    int size;
+    int capacity;
+} MinHeap;
+
+// Growable FIFO ring buffer
+typedef struct {
+    void** items;
+    int head;
+    int count;
+    int capacity;
+} Fifo;
+
+// Per-level run queue structures
+// Each level is an unbounded FIFO (FCFS/RR) or a min-heap (SJF keyed by the
+// estimated CPU burst, PRIORITY keyed by priority), depending on the active ordering
 typedef struct {
-    PCB* queue[MAX_LEVELS][MAX_TASKS]; // Array of queues for different priority levels
-    int front[MAX_LEVELS];
-    int rear[MAX_LEVELS];
+    Fifo fifo[MAX_LEVELS];
+    MinHeap heap[MAX_LEVELS];
     int count[MAX_LEVELS];
+    SchedulerType ordering;       // Scheduler the queued entries are ordered for
+} RunQueue;
+
+// Structure for multilevel queue scheduling
+typedef struct {
     int time_quantum[MAX_LEVELS]; // Time quantum for each level (for RR)
 } MultiLevelQueue;
 
+// Tunables of the multilevel feedback queue (quanta live in ml_queue)
+typedef struct {
+    int boost_interval_ms;  // Every process is moved back to level 0 this often
+    int cpu_bound_pct;      // Using this much of a full quantum counts as CPU-bound
+} MlfqConfig;
+
+// Per-level residency statistics of the multilevel feedback queue
+typedef struct {
+    unsigned long dispatches[MAX_LEVELS];
+    unsigned long demotions[MAX_LEVELS];      // Moves from this level to the next one down
+    unsigned long long run_ms[MAX_LEVELS];    // Time spent on a CPU slot at this level
+    unsigned long long wait_ms[MAX_LEVELS];   // Time spent in the ready queue at this level
+    unsigned long boosts;
+} MlfqStats;
+
+// Backing array of a work-stealing deque; replaced arrays are kept until
+// shutdown because a thief may still be reading them
+typedef struct DequeArray {
+    long capacity;                // Power of two
+    PCB** slots;
+    struct DequeArray* retired;
+} DequeArray;
+
+// Chase-Lev work-stealing deque: the owner pushes and pops at the bottom,
+// other workers steal from the top
+typedef struct {
+    long top;
+    long bottom;
+    DequeArray* array;
+} WorkStealingDeque;
+
+// Run queue of one simulated core; each core has its own worker thread
+typedef struct {
+    WorkStealingDeque deque;
+    PCB* mailbox;                 // Lock-free stack of processes placed on or preempted by this core
+    RunQueue sorter;              // Orders batches before they go into the deque
+    PCB** batch;
+    int batch_capacity;
+    unsigned long scheduler_epoch;
+    unsigned long random_state;   // Picks steal victims
+    unsigned long steals;
+    int host_cpu;                 // Real CPU the core's processes are pinned to, -1 if unknown
+    int queued;                   // Processes waiting in the mailbox and the deque
+    int running;                  // A process holds the core
+    unsigned long dispatches;
+    unsigned long redispatches;   // Dispatches of processes that ran before
+    unsigned long warm_dispatches; // ... on this core, so its cache may still be warm
+    unsigned long migrations;     // Processes the load balancer moved here
+} WorkerQueue;
+
+// Counters of the metrics subsystem; names and help texts are in METRICS
+typedef enum {
+    METRIC_LAUNCHES,
+    METRIC_ADMISSION_REJECTIONS,
+    METRIC_TERMINATIONS,
+    METRIC_EXITS,
+    METRIC_MINIMIZES,
+    METRIC_ENQUEUES,
+    METRIC_DEQUEUES,
+    METRIC_DISPATCHES,
+    METRIC_PREEMPTIONS,
+    NUM_METRIC_COUNTERS
+} MetricCounter;
+
+typedef enum {
+    HISTOGRAM_DISPATCH_LATENCY, // Ready queue entry to dispatch
+    HISTOGRAM_SLOT_TIME,        // Time a process held a core per dispatch
+    HISTOGRAM_LAUNCH_LATENCY,   // posix_spawn of a task
+    NUM_METRIC_HISTOGRAMS
+} MetricHistogram;
+
+// Metrics recorded by one thread. Each thread adds to its own shard, so the
+// hot paths never share a cache line; the exporter sums all shards.
+typedef struct {
+    unsigned long long counters[NUM_METRIC_COUNTERS];
+    unsigned long long level_enqueues[MAX_LEVELS];  // Depth per level = enqueues - dequeues
+    unsigned long long level_dequeues[MAX_LEVELS];
+    unsigned long long buckets[NUM_METRIC_HISTOGRAMS][HISTOGRAM_BUCKETS];
+    unsigned long long sums_ns[NUM_METRIC_HISTOGRAMS];
+} __attribute__((aligned(64))) MetricShard;
+
+// Scheduler and process lifecycle events recorded for --trace-file
+typedef enum {
+    TRACE_ENQUEUE,
+    TRACE_DEQUEUE,
+    TRACE_DISPATCH,     // Complete event: the time a process held a core
+    TRACE_PREEMPT,
+    TRACE_MINIMIZE,
+    TRACE_RESUME,
+    TRACE_EXIT,
+    TRACE_TERMINATE,
+    TRACE_ALLOC,
+    TRACE_FREE,
+    NUM_TRACE_EVENTS
+} TraceEventType;
+
+typedef struct {
+    long long ticks;    // trace_clock() when recorded; the end of a complete event
+    long long dur_ns;
+    int type;
+    int pid;
+    int args[2];        // Meaning per type, see trace_event_info
+} TraceEvent;
+
+// One thread's events; only that thread writes, dumps read behind it
+typedef struct {
+    TraceEvent* events;             // TRACE_RING_EVENTS entries
+    unsigned long long head;        // Events recorded so far
+    int tid;
+    char name[24];
+} __attribute__((aligned(64))) TraceRing;
+
+// Pseudo-terminal of a process table slot and the tail of its output
+typedef struct {
+    pthread_mutex_t lock;           // Guards everything below
+    int master_fd;                  // Master side of the task's pseudo-terminal, -1 if none
+    char* ring;                     // SCROLLBACK_BYTES of output, allocated on first use
+    unsigned long long head;        // Bytes written so far
+} TaskConsole;
+
+// Load balancer statistics of the per-core run queues
+typedef struct {
+    unsigned long runs;
+    unsigned long migrations;
+    int imbalance;                // Busiest minus idlest core at the last run
+    int max_imbalance;
+} BalanceStats;
+
+// One job of a simulator trace
+typedef struct {
+    long long arrival;
+    long long burst;
+    long long remaining;
+    long long first_run;   // -1 until the job is dispatched for the first time
+    long long completion;  // -1 until the job finishes
+    int priority;
+    int ram_required;      // MB
+    int hdd_required;      // GB
+    int level;             // MLFQ level
+    long id;               // Line order in the trace
+} SimJob;
+
+// Simulated machine for the headless simulator
+typedef struct {
+    int cores;
+    int ram_mb;
+    int hdd_gb;
+    int quantum; // 0 means use the per-level quantum of the multilevel queue
+    int mlfq_boost; // MLFQ boost interval in time units, 0 disables it
+} SimConfig;
+
+// Metrics of one simulator run
+typedef struct {
+    long completed;
+    long rejected;          // Jobs that can never fit in RAM/HDD
+    long long dispatches;
+    long long makespan;
+    double avg_waiting;
+    double avg_turnaround;
+    double avg_response;
+    double throughput;      // Completed jobs per 1000 time units
+    double cpu_utilisation; // Busy core time / available core time
+    double wall_seconds;
+    long mlfq_boosts;
+    long long level_dispatches[MAX_LEVELS];
+    long long level_run_time[MAX_LEVELS];
+    long long level_demotions[MAX_LEVELS];
+    long level_completions[MAX_LEVELS];
+} SimResult;
+
+// Two-level page table of one process. Leaves are allocated on first touch,
+// so a sparse multi-GB address space only costs the pages it uses.
+// Entries hold frame + 1, 0 means not present.
+typedef struct PageTable {
+    uint32_t** leaves;
+    uint32_t leaf_count;
+} PageTable;
+
+// Page replacement policies of the virtual memory manager
+typedef enum {
+    REPLACE_FIFO,
+    REPLACE_LRU,
+    REPLACE_CLOCK,
+    REPLACE_SECOND_CHANCE
+} ReplacementPolicy;
+
+// Settings of a virtual memory simulation
+typedef struct {
+    long long ram_mb;       // Physical memory, split into frames
+    long long space_mb;     // Virtual address space of each process
+    int page_kb;
+    int tlb_entries;
+    int procs;              // Processes of the synthetic reference string
+} VmConfig;
+
+// Metrics of one virtual memory simulation run
+typedef struct {
+    long long references;
+    long long faults;
+    long long evictions;
+    long long tlb_hits;
+    double wall_seconds;
+} VmResult;
+
+// Placement algorithms for the simulated RAM
+typedef enum {
+    RAM_FIRST_FIT,
+    RAM_BEST_FIT,
+    RAM_WORST_FIT,
+    RAM_NEXT_FIT,
+    RAM_BUDDY
+} RamAllocatorType;
+
+#define BUDDY_MAX_ORDERS 32
+
+// Free extent of the contiguous allocators, linked in address order
+typedef struct {
+    int start;  // MB
+    int size;   // MB
+    int prev;
+    int next;
+} FreeExtent;
+
+// Simulated RAM in 1 MB units, placed by one of the algorithms above
+typedef struct {
+    RamAllocatorType type;
+    int total_mb;
+    
+    // First/best/worst/next fit: free extents from a node pool
+    FreeExtent* extents;
+    int* spare_nodes;       // Stack of unused nodes
+    int spare_count;
+    int head;
+    int rover;              // Next fit resumes here
+    
+    // Buddy: free lists per order, linked through the block start
+    int max_order;
+    int free_head[BUDDY_MAX_ORDERS];
+    int* buddy_next;
+    int* buddy_prev;
+    signed char* free_order;  // Order of a free block starting here, else -1
+    signed char* alloc_order; // Order of an allocated block starting here, else -1
+    
+    // Statistics
+    long long allocations;
+    long long failures;
+    long long alloc_ns;
+    int free_mb;
+    int allocated_mb;       // Including buddy rounding
+    int requested_mb;
+} RamAllocator;
+
+// Fragmentation snapshot of a RamAllocator
+typedef struct {
+    int free_mb;
+    int largest_free_mb;
+    int holes;
+    double external;    // 1 - largest hole / free memory
+    double internal;    // Rounding waste / allocated memory
+} RamStats;
+
 // ##########################################
 // GLOBAL VARIABLES
 // ##########################################
+extern char** environ;
 HardwareResources hardware;
-PCB process_table[MAX_TASKS];
+PCB* process_table = NULL;
+int max_tasks = MAX_TASKS;      // Number of slots in process_table
 int process_count = 0;
+int process_table_used = 0;     // Slots handed out at least once; table scans stop here
 int is_kernel_mode = 1; // 1 for kernel mode, 0 for user mode
+int batch_mode = 0;     // Commands come from --batch: no prompts, delays or screen clears
+const char* batch_path = NULL;
+int hardware_preset = 0; // Hardware was given with --ram/--hdd/--cores
 SchedulerType current_scheduler = SCHEDULER_FCFS; // Default scheduler
+RamAllocatorType ram_allocator_type = RAM_FIRST_FIT; // Chosen at boot with --ram-allocator
+RamAllocator ram_allocator;     // Placement of tasks in the simulated RAM (ram_allocator_mutex)
+DeadlockMode deadlock_mode = DEADLOCK_AVOID; // Chosen at boot with --deadlock
+ClaimTable claim_table;         // Maximum claims of the running tasks, by slot (claim_mutex)
 
 // ##########################################
 // SYNCHRONIZATION PRIMITIVES
 // ##########################################
-pthread_mutex_t resource_mutex = PTHREAD_MUTEX_INITIALIZER;
-sem_t *process_semaphore;
+pthread_mutex_t ram_allocator_mutex = PTHREAD_MUTEX_INITIALIZER; // Only placement; the counters are lock-free
+pthread_mutex_t claim_mutex = PTHREAD_MUTEX_INITIALIZER;
+TableLock table_lock;           // Guards process_table and its indexes
 
 // NexOS Thread Management
-pthread_t worker_threads[MAX_THREADS];
-int thread_active[MAX_THREADS] = {0};
-ThreadArgs thread_args[MAX_THREADS];
+// At most one worker thread per simulated core. Cores up to the number of
+// host CPUs keep theirs; the others get one when a process is queued on
+// them and let it retire after WORKER_IDLE_MS without work
+pthread_t worker_threads[MAX_WORKER_QUEUES];
+int thread_active[MAX_WORKER_QUEUES] = {0}; // worker_threads[i] still has to be joined (pool_mutex)
+int worker_live[MAX_WORKER_QUEUES] = {0};   // The core has a worker that has not retired
+ThreadArgs thread_args[MAX_WORKER_QUEUES];
+int workers_running = 0;           // Cleared to stop the pool
+int resident_workers = 1;          // Cores whose worker never retires
+unsigned long workers_started = 0;
+unsigned long workers_retired = 0;
+pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER; // Starting and joining workers
 
 // NexOS Synchronization Primitives
+// thread_mutex and process_ready_cond only park idle workers; queueing and
+// dispatching are lock-free
 pthread_cond_t process_ready_cond = PTHREAD_COND_INITIALIZER;
 pthread_cond_t resources_available_cond = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // NexOS Process Scheduling Queue
 MultiLevelQueue ml_queue;
+WorkerQueue worker_queues[MAX_WORKER_QUEUES];
+int num_worker_queues = 1;         // Simulated cores, set when the workers start
+unsigned long scheduler_epoch = 0; // Bumped on every scheduler change
+int dispatched_count = 0;          // Processes currently running on a CPU slot
+int idle_workers = 0;              // Workers parked on process_ready_cond
+
+// NexOS Load Balancer
+int work_stealing = 1;             // Idle cores steal queued processes
+int load_balancing = 1;            // Periodic migration from the busiest to the idlest core
+int balance_interval_ms = BALANCE_INTERVAL_MS;
+long long last_balance_ns = 0;
+BalanceStats balance_stats;
+
+// NexOS Metrics
+MetricShard metric_shards[MAX_METRIC_SHARDS];
+int metric_shard_count = 0;
+const char* metrics_path = NULL;   // --metrics-file, NULL disables the exporter
+int metrics_interval_ms = METRICS_INTERVAL_MS;
+pthread_t metrics_thread;
+int metrics_running = 0;
+pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t metrics_cond = PTHREAD_COND_INITIALIZER;
+
+// NexOS Tracing
+TraceRing trace_rings[MAX_TRACE_RINGS];
+int trace_ring_count = 0;
+int tracing_enabled = 0;           // Set by --trace-file
+const char* trace_file_path = NULL;
+long long trace_start_ns = 0;
+long long trace_start_ticks = 0;
+pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER; // Serializes dumps
+
+// NexOS Multilevel Feedback Queue
+MlfqConfig mlfq_config = { 5000, 80 };
+MlfqStats mlfq_stats;
+long long last_boost_ns = 0;
+
+// NexOS Process Table Indexes
+// Buckets hold the first slot of a chain linked through pid_next/name_next
+int* pid_buckets = NULL;
+int* name_buckets = NULL;
+unsigned int index_mask = 0;
+int free_slot_head = -1;
+
+// NexOS Child Supervisor
+// The supervisor thread reaps children as they exit; foreground launchers
+// wait on child_exit_cond instead of calling waitpid themselves
+pthread_t supervisor_thread;
+int supervisor_running = 0;
+int supervisor_epoll_fd = -1;
+int supervisor_signal_fd = -1;
+int supervisor_wake_fd = -1;
+int supervisor_timer_fd = -1;
+pthread_mutex_t supervisor_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t child_exit_cond = PTHREAD_COND_INITIALIZER;
+int term_timeout_ms = TERM_TIMEOUT_MS;
+
+// NexOS Terminal Multiplexer
+// Every task gets its own pseudo-terminal. The console thread drains them
+// all into per-task scrollback and copies the visible one to the screen
+int terminal_fd = -1;              // Our controlling terminal, -1 if we do not own one
+struct termios terminal_modes;     // Our own modes, restored after every task
+TaskConsole* consoles = NULL;      // One per process table slot
+int visible_console = -1;          // Slot whose output goes to the screen, -1 for the menus
+pthread_t console_thread;
+int console_running = 0;
+int console_epoll_fd = -1;
+int console_wake_fd = -1;
+int console_event_fd = -1;         // Written when a child exits or stops; wakes the attached view
+
+// NexOS Task Resource Limits
+// Empty when cgroup v2 cannot be used; tasks then get a setrlimit fallback
+char cgroup_base[MAX_PATH_LENGTH * 2] = "";
+char cgroup_parent[MAX_PATH_LENGTH * 2] = ""; // The cgroup we were started in
+int cgroup_parent_enabled = 0;     // We enabled memory and cpu in cgroup_parent
+int next_cgroup_id = 0;            // Tasks get task-<id> below cgroup_base
 
 // ##########################################
 // FUNCTION DECLARATIONS
@@ -112,99 +670,323 @@ void display_main_menu();
 void display_applications_menu();
 void display_task_manager();
 void launch_task(int task_id);
-void launch_task_background(int task_id); // New function to launch tasks in background
-int allocate_resources(int ram_required, int hdd_required);
+int launch_task_background(int task_id); // New function to launch tasks in background
+void init_resource_pool(int ram_mb, int hdd_gb, int cores);
+ResourceCounts available_resources();
+int take_resources(int ram_mb, int hdd_gb, int cores);
+void adjust_resources(int ram_mb, int hdd_gb, int cores);
+int reserve_resources(ResourceReservation* reservation, int ram_required, int hdd_required);
+int release_reservation(ResourceReservation* reservation);
+void charge_reservation(ResourceReservation* reservation, int used_mb);
+int reservation_charged_mb(const ResourceReservation* reservation);
 void free_resources(int process_id);
+void run_resource_benchmark(int max_threads);
+void claim_table_init(ClaimTable* table, int capacity, const int total[], DeadlockMode mode);
+void claim_table_destroy(ClaimTable* table);
+void claim_register(ClaimTable* table, int id, const int max[]);
+ClaimResult claim_request(ClaimTable* table, int id, const int request[]);
+void claim_release(ClaimTable* table, int id, const int amount[]);
+void claim_finish(ClaimTable* table, int id);
+int claim_is_safe(ClaimTable* table);
+int detect_deadlock(ClaimTable* table, unsigned char* deadlocked);
+const char* deadlock_mode_name(DeadlockMode mode);
+int admit_task_claim(int index, int task_id);
+ClaimResult request_task_resources(int index, ResourceCounts amount);
+void release_task_resources(int index, ResourceCounts amount);
+void finish_task_claim(int index);
+void grant_waiting_requests();
+void run_deadlock_benchmark(long max_processes);
+void ram_allocator_init(RamAllocator* ram, RamAllocatorType type, int total_mb);
+void ram_allocator_destroy(RamAllocator* ram);
+int ram_alloc(RamAllocator* ram, int size_mb);
+void ram_free(RamAllocator* ram, int base, int size_mb);
+void ram_allocator_stats(const RamAllocator* ram, RamStats* stats);
+const char* ram_allocator_name(RamAllocatorType type);
+void run_alloc_benchmark(long operations, int ram_mb, unsigned long seed);
 void switch_mode();
 void shutdown_system();
 void list_running_processes();
 void terminate_process(int index);
+void terminate_processes(const int* indexes, int count);
+int stop_children(const int* indexes, int count, int timeout_ms);
 void minimize_process(int index);
 void resume_process(int index);
 void send_interrupt(int index, int signal_type);
+void table_write_lock();
+void table_write_unlock();
+unsigned int table_read_begin();
+int table_read_retry(unsigned int sequence);
+ProcessRow* snapshot_processes(int* count);
+void run_table_lock_benchmark(int max_threads);
 void initialize_process_table();
+void destroy_process_table();
+int process_table_insert(const char* name);
+void process_table_remove(int index);
+void process_table_set_pid(int index, int pid);
+int find_process_by_pid(int pid);
+int lookup_process_by_pid(int pid);
+int find_process_by_name(const char* name, int minimized_only);
+void run_table_benchmark(long max_entries);
 int is_application_running(const char* app_name); // New function declaration
-void handle_child_exit(int signum __attribute__((unused))); // New function declaration
+void start_child_supervisor();
+void stop_child_supervisor();
+void supervise_child(int index, pid_t pid);
+int wait_for_child(int index, pid_t pid);
+void* supervisor_loop(void* arg);
+int find_own_cgroup(char* directory, size_t size);
+void init_task_limits();
+void destroy_task_limits();
+int open_task_cgroup(int index);
+void limit_task_resources(int index, pid_t pid, int in_cgroup);
+int write_task_limits(int index);
+void release_task_limits(int index);
+void sample_task_usage(int index);
+int read_task_usage(pid_t pid, TaskUsage* usage, long* rss_kb);
+void record_exit_usage(PCB* process, const struct rusage* rusage);
+void print_usage_table();
+void display_live_usage();
+void run_usage_benchmark(long tasks);
+void metric_add(MetricCounter counter, unsigned long long amount);
+void metric_observe(MetricHistogram histogram, long long ns);
+void metric_level_move(int from_level, int to_level);
+void write_metrics(FILE* out);
+int export_metrics_file();
+void start_metrics_exporter();
+void stop_metrics_exporter();
+void start_tracing();
+void trace_name_thread(const char* name);
+void trace_attach_core(int core, const char* name);
+void trace_event(TraceEventType type, int pid, int arg0, int arg1);
+void trace_span(TraceEventType type, long long start_ns, int pid, int arg0, int arg1);
+void write_trace(FILE* out);
+int export_trace_file(const char* path);
+void stop_tracing();
+void run_trace_benchmark(long events);
+#ifdef NEXOS_BENCH
+int run_bench_suite(int argc, char* argv[]);
+#endif
 void change_scheduler(); // New function declaration
 const char* get_scheduler_name(SchedulerType scheduler); // New function declaration
 void init_multilevel_queue();
 void enqueue_process(PCB* process);
-PCB* dequeue_process(int level);
+PCB* dequeue_process(int worker_id);
+void requeue_process(int worker_id, PCB* process);
+void destroy_multilevel_queue();
+void run_queue_init(RunQueue* queue, SchedulerType ordering);
+void run_queue_push(RunQueue* queue, PCB* process);
+PCB* run_queue_pop(RunQueue* queue, int level);
+void run_queue_free(RunQueue* queue);
+void deque_init(WorkStealingDeque* deque);
+void deque_push(WorkStealingDeque* deque, PCB* process);
+PCB* deque_pop(WorkStealingDeque* deque);
+PCB* deque_steal(WorkStealingDeque* deque);
+long deque_size(WorkStealingDeque* deque);
+void deque_free(WorkStealingDeque* deque);
 void* thread_worker(void* arg);
 void create_worker_threads();
 void cleanup_worker_threads();
-void launch_task_with_exec(int task_id);
+int assign_host_cpus();
+int core_load(int core);
+int core_imbalance(int* busiest, int* idlest);
+int select_core(PCB* process);
+void queue_on_core(PCB* process, int core);
+void record_core_dispatch(int core, PCB* process);
+int balance_cores();
+void balance_cores_if_due();
+void pin_process(PCB* process, int cpu);
+void print_core_stats();
+void run_balance_benchmark(long processes, int cores);
+pid_t spawn_task(const char* path, const char* tty_path);
+pid_t spawn_task_in_cgroup(const char* path, const char* tty_path, int cgroup_fd);
+pid_t start_task(int index);
+void init_job_control();
+int signal_task(pid_t pid, int sig);
+int foreground_task(int* index, pid_t pid);
+int task_minimized(int status);
+void report_foreground(int index, int status);
+void start_console_multiplexer();
+void stop_console_multiplexer();
+int open_console(char* tty_path, size_t size);
+void set_console(int index, int master_fd);
+void notify_console_view();
+int attach_console(int* index, pid_t pid);
+void run_console_benchmark(int max_tasks_running);
+void clear_screen();
+void run_launch_benchmark(long launches);
+int run_share_check(int run_ms);
+int is_schedulable(PCB* process);
+PCB* select_next_process(RunQueue* queue, int* level_out);
+int dispatch_process(PCB* process, int level);
+void sleep_ms(int ms);
+void ui_delay(int ms);
+int run_batch_commands(const char* path);
+void run_vm_simulator(const char* trace_path, long synthetic_refs, const char* policy_name, const VmConfig* config, unsigned long seed);
+void generate_vm_trace(long count, const VmConfig* config, unsigned long seed);
+void simulate_paging(const uint64_t* refs, long count, int procs, ReplacementPolicy policy, const VmConfig* config, VmResult* result);
+long long monotonic_ns();
+int next_thread_count(int n, int max);
+void run_queue_benchmark(long max_pcbs);
+int scheduler_is_preemptive(SchedulerType scheduler);
+int queue_level_for(PCB* process);
+void mlfq_boost_if_due();
+void mlfq_account_slot(PCB* process, int level, int elapsed_units, long cpu_ms, long long waited_ns);
+void update_burst_estimate(PCB* process, long cpu_ms);
+void configure_mlfq();
+long read_process_cpu_ms(pid_t pid);
+void run_dispatch_benchmark(int max_threads);
+unsigned long next_random(unsigned long* state);
+int priority_to_level(int priority);
+void heap_init(MinHeap* heap);
+void heap_push(MinHeap* heap, long long key, unsigned long seq, void* item);
+void* heap_pop(MinHeap* heap);
+void heap_free(MinHeap* heap);
+void fifo_init(Fifo* fifo);
+void fifo_push(Fifo* fifo, void* item);
+void* fifo_pop(Fifo* fifo);
+void fifo_free(Fifo* fifo);
+int run_headless_mode(int argc, char* argv[]);
+int load_sim_trace(const char* path, SimJob** jobs_out, long* count_out);
+void generate_sim_trace(long count, int cores, unsigned long seed);
+void simulate_policy(SimJob* jobs, long count, SchedulerType policy, const SimConfig* config, SimResult* result);
+void run_simulator(const char* trace_path, const char* policy_name, const SimConfig* config);
+int init_task_registry();
+int find_registered_task(const char* name);
+void watch_task_registry();
+void reload_task_registry_if_changed();
+void unwatch_task_registry();
+int run_registry_benchmark(long tasks);
 
 // ##########################################
 // TASK DEFINITIONS
 // ##########################################
 typedef struct {
-    char name[TASK_NAME_LENGTH];
-    char path[MAX_PATH_LENGTH];
+    const char* name;   // Interned in the registry's string pool
+    const char* path;
     int ram_required;
     int hdd_required;
     int priority;
+    int max_ram;        // Maximum claim, acquired piecewise (Banker's algorithm)
+    int max_hdd;
+    int max_cores;
 } Task;
 
-Task available_tasks[] = {
-    {"Notepad", "./tasks/notepad.sh", 256, 10, 2},
-    {"Calculator", "./tasks/calculator.sh", 64, 2, 3},
-    {"Clock", "./tasks/clock.sh", 64, 2, 3},
-    {"Prime Checker", "./tasks/primechecker.sh", 64, 1, 2},
-    {"Unit Converter", "./tasks/unitconverter.sh", 64, 2, 1},
-    {"Calendar", "./tasks/calendar.sh", 128, 10, 2},
-    {"Number Sorter", "./tasks/sorter.sh", 128, 2, 1},
-    {"Text Reverser", "./tasks/reverser.sh", 64, 1, 2},
-    {"Game - Minesweeper", "./tasks/minesweeper.sh", 256, 20, 0},
-    {"Factorial Calculator", "./tasks/factorial.sh", 64, 1, 2},
-    {"BMI Calculator", "./tasks/bmicalc.sh", 96, 2, 2},
-    {"Temperature Converter", "./tasks/tempconverter.sh", 64, 2, 3},
-    {"Password Generator", "./tasks/passwordgen.sh", 64, 2, 1},
-    {"File Manager", "./tasks/filemanager.sh", 128, 5, 2}
+// A registry loaded from a file keeps its names and paths in one string
+// pool and indexes the names case-insensitively
+typedef struct {
+    Task* tasks;
+    int count;
+    char* strings;
+    int* name_index;            // Task id + 1 per bucket, 0 if empty
+    unsigned int index_mask;
+} TaskRegistry;
+
+// Used when there is no task registry file
+Task builtin_tasks[] = {
+    {"Notepad", "./tasks/notepad.sh", 256, 10, 2, 512, 20, 1},
+    {"Calculator", "./tasks/calculator.sh", 64, 2, 3, 128, 2, 1},
+    {"Clock", "./tasks/clock.sh", 64, 2, 3, 64, 2, 1},
+    {"Prime Checker", "./tasks/primechecker.sh", 64, 1, 2, 256, 1, 2},
+    {"Unit Converter", "./tasks/unitconverter.sh", 64, 2, 1, 64, 2, 1},
+    {"Calendar", "./tasks/calendar.sh", 128, 10, 2, 256, 10, 1},
+    {"Number Sorter", "./tasks/sorter.sh", 128, 2, 1, 512, 4, 2},
+    {"Text Reverser", "./tasks/reverser.sh", 64, 1, 2, 128, 1, 1},
+    {"Game - Minesweeper", "./tasks/minesweeper.sh", 256, 20, 0, 512, 20, 2},
+    {"Factorial Calculator", "./tasks/factorial.sh", 64, 1, 2, 256, 1, 2},
+    {"BMI Calculator", "./tasks/bmicalc.sh", 96, 2, 2, 96, 2, 1},
+    {"Temperature Converter", "./tasks/tempconverter.sh", 64, 2, 3, 64, 2, 1},
+    {"Password Generator", "./tasks/passwordgen.sh", 64, 2, 1, 128, 2, 1},
+    {"File Manager", "./tasks/filemanager.sh", 128, 5, 2, 256, 20, 1}
 };
 
-int num_available_tasks = sizeof(available_tasks) / sizeof(Task);
+// The registry in use; available_tasks and num_available_tasks mirror it.
+// Only the main thread reads it, and it is swapped there on reload.
+TaskRegistry task_registry = { builtin_tasks, sizeof(builtin_tasks) / sizeof(Task), NULL, NULL, 0 };
+Task* available_tasks = builtin_tasks;
+int num_available_tasks = sizeof(builtin_tasks) / sizeof(Task);
+const char* registry_path = TASK_REGISTRY_PATH;
+int registry_path_given = 0;
+int registry_watch_fd = -1;
 
 // ##########################################
 // MAIN FUNCTION
 // ##########################################
-int main() {
-    // Initialize semaphore
-    process_semaphore = sem_open("/process_sem", O_CREAT, 0644, 1);
-    if (process_semaphore == SEM_FAILED) {
-        perror("Failed to create semaphore");
-        return EXIT_FAILURE;
+int main(int argc, char* argv[]) {
+#ifdef NEXOS_BENCH
+    // nexos-bench (make bench) only runs the benchmark suite
+    return run_bench_suite(argc, argv);
+#endif
+    
+    // Headless modes run without the interactive OS
+    int headless_status = run_headless_mode(argc, argv);
+    if (headless_status >= 0) {
+        return headless_status;
     }
     
-    // Set up signal handler for child processes
+    // SIGCHLD also reports stops, so a task that stops itself is minimized
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = handle_child_exit;
+    sa.sa_handler = SIG_DFL;
+    sa.sa_flags = SA_RESTART;
     sigaction(SIGCHLD, &sa, NULL);
     
+    // Taking the terminal back from a task happens from the background
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGTTOU, &sa, NULL);
+    init_job_control();
+    
+    // SIGCHLD and SIGUSR1 (dump the trace) are read by the supervisor through
+    // a signalfd, so block them before any thread is created; spawned tasks
+    // get an empty mask back
+    sigset_t child_signal;
+    sigemptyset(&child_signal);
+    sigaddset(&child_signal, SIGCHLD);
+    sigaddset(&child_signal, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &child_signal, NULL);
+    start_tracing();
+    
     // Initialize the process table
     initialize_process_table();
+    start_console_multiplexer();
+    watch_task_registry();
     
     // Initialize the multilevel queue
     init_multilevel_queue();
     
-    // Create worker threads
-    create_worker_threads();
+    // Start reaping children in the background
+    start_child_supervisor();
     
     // Start the OS
     boot_sequence();
     initialize_hardware();
+    ram_allocator_init(&ram_allocator, ram_allocator_type, hardware.ram_gb * 1024);
+    int claim_total[NUM_RESOURCE_TYPES] = { hardware.ram_gb * 1024, hardware.hdd_gb, hardware.cpu_cores };
+    claim_table_init(&claim_table, max_tasks, claim_total, deadlock_mode);
+    init_task_limits();
+    
+    // One worker per core, now that the number of cores is known
+    create_worker_threads();
+    start_metrics_exporter();
     
     // Auto-start the clock in background mode
-    launch_task_background(2); // Index for clock
+    int clock_task = find_registered_task("Clock");
+    if (clock_task >= 0) {
+        launch_task_background(clock_task);
+    }
     
     int choice = 0;
     int submenu_choice = 0;
+    int exit_status = EXIT_SUCCESS;
+    
+    if (batch_mode) {
+        exit_status = run_batch_commands(batch_path);
+        shutdown_system();
+    }
     
     // ##########################################
     // MAIN OS LOOP
     // ##########################################
-    while (1) {
+    while (!batch_mode) {
+        reload_task_registry_if_changed();
         display_main_menu();
         printf("Enter your choice: ");
         scanf("%d", &choice);
@@ -215,14 +997,15 @@ int main() {
             break;
         } else if (choice == 1) {
             // Applications menu
+            reload_task_registry_if_changed();
             display_applications_menu();
             printf("Select an application (0 to go back): ");
             scanf("%d", &submenu_choice);
             while (getchar() != '\n'); 
             
             if (submenu_choice > 0 && submenu_choice <= num_available_tasks) {
-                // Use exec-based launcher instead of system-based one
-                launch_task_with_exec(submenu_choice - 1);
+                // Spawn the task under the dispatcher
+                launch_task(submenu_choice - 1);
             }
         } else if (choice == 2) {
             // Task Manager menu
@@ -237,7 +1020,7 @@ int main() {
                     // Terminate a process
                     if (!is_kernel_mode) {
                         printf("ERROR: Cannot terminate processes in User Mode!\n");
-                        sleep(2);
+                        ui_delay(2000);
                         continue;
                     }
                     
@@ -246,11 +1029,9 @@ int main() {
                     scanf("%d", &proc_id);
                     while (getchar() != '\n'); 
                     
-                    for (int i = 0; i < MAX_TASKS; i++) {
-                        if (process_table[i].pid == proc_id && process_table[i].is_active) {
-                            terminate_process(i);
-                            break;
-                        }
+                    int index = lookup_process_by_pid(proc_id);
+                    if (index >= 0) {
+                        terminate_process(index);
                     }
                 } else if (task_action == 2) {
                     // Minimize a process
@@ -259,30 +1040,26 @@ int main() {
                     scanf("%d", &proc_id);
                     while (getchar() != '\n'); 
                     
-                    for (int i = 0; i < MAX_TASKS; i++) {
-                        if (process_table[i].pid == proc_id && process_table[i].is_active) {
-                            minimize_process(i);
-                            break;
-                        }
+                    int index = lookup_process_by_pid(proc_id);
+                    if (index >= 0) {
+                        minimize_process(index);
                     }
                 } else if (task_action == 3) {
-                    // Resume a minimized process
+                    // Resume a minimized process or show one running in the background
                     int proc_id;
                     printf("Enter process ID to resume: ");
                     scanf("%d", &proc_id);
                     while (getchar() != '\n'); 
                     
-                    for (int i = 0; i < MAX_TASKS; i++) {
-                        if (process_table[i].pid == proc_id && process_table[i].is_active && process_table[i].is_minimized) {
-                            resume_process(i);
-                            break;
-                        }
+                    int index = lookup_process_by_pid(proc_id);
+                    if (index >= 0) {
+                        resume_process(index);
                     }
                 } else if (task_action == 4) {
                     // Send interrupt to a process
                     if (!is_kernel_mode) {
                         printf("ERROR: Cannot send interrupts in User Mode!\n");
-                        sleep(2);
+                        ui_delay(2000);
                         continue;
                     }
                     
@@ -294,12 +1071,13 @@ int main() {
                     scanf("%d", &signal_type);
                     while (getchar() != '\n'); 
                     
-                    for (int i = 0; i < MAX_TASKS; i++) {
-                        if (process_table[i].pid == proc_id && process_table[i].is_active) {
-                            send_interrupt(i, signal_type);
-                            break;
-                        }
+                    int index = lookup_process_by_pid(proc_id);
+                    if (index >= 0) {
+                        send_interrupt(index, signal_type);
                     }
+                } else if (task_action == 5) {
+                    // Live resource usage, refreshed every second
+                    display_live_usage();
                 }
             } while (task_action != 0);
         } else if (choice == 3) {
@@ -308,40 +1086,341 @@ int main() {
             change_scheduler();
         } else {
             printf("Invalid choice. Please try again.\n");
-            sleep(1);
+            ui_delay(1000);
         }
     }
     
     // ##########################################
     // CLEANUP SECTION
     // ##########################################
-    // Clean up worker threads before exiting
-    cleanup_worker_threads();
+    // shutdown_system already stopped the worker threads
+    stop_child_supervisor();
+    stop_console_multiplexer();
+    unwatch_task_registry();
+    stop_metrics_exporter();
+    stop_tracing();
+    destroy_task_limits();
     
     // Clean up
-    sem_close(process_semaphore);
-    sem_unlink("/process_sem");
+    destroy_multilevel_queue();
+    destroy_process_table();
+    ram_allocator_destroy(&ram_allocator);
+    claim_table_destroy(&claim_table);
     
     // Destroy mutex and condition variables
-    pthread_mutex_destroy(&resource_mutex);
+    pthread_mutex_destroy(&ram_allocator_mutex);
+    pthread_mutex_destroy(&claim_mutex);
     pthread_mutex_destroy(&thread_mutex);
+    pthread_mutex_destroy(&pool_mutex);
     pthread_cond_destroy(&process_ready_cond);
     pthread_cond_destroy(&resources_available_cond);
+    pthread_mutex_destroy(&metrics_mutex);
+    pthread_cond_destroy(&metrics_cond);
+    pthread_mutex_destroy(&trace_mutex);
     
-    return 0;
+    return exit_status;
+}
+
+// ##########################################
+// PROCESS TABLE LOCK
+// ##########################################
+// Launches, exits and Task Manager actions change the table under one writer
+// lock: a futex word that costs a single CAS when uncontended and sleeps in
+// the kernel otherwise. Writers also bump a sequence counter, odd while they
+// are inside, so the process lists read without any lock and retry when the
+// sequence moved (a seqlock). The hash chains stay acyclic through every
+// single write, so even a torn read of a chain terminates.
+
+static long table_futex(int op, int value) {
+    return syscall(SYS_futex, &table_lock.state, op, value, NULL, NULL, 0);
+}
+
+void table_write_lock() {
+    int state = 0;
+    if (!__atomic_compare_exchange_n(&table_lock.state, &state, 1, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        // Contended: mark the word so the owner wakes us, then sleep on it
+        if (state != 2) {
+            state = __atomic_exchange_n(&table_lock.state, 2, __ATOMIC_ACQUIRE);
+        }
+        while (state != 0) {
+            table_futex(FUTEX_WAIT_PRIVATE, 2);
+            state = __atomic_exchange_n(&table_lock.state, 2, __ATOMIC_ACQUIRE);
+        }
+    }
+    
+    __atomic_store_n(&table_lock.sequence, table_lock.sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void table_write_unlock() {
+    __atomic_store_n(&table_lock.sequence, table_lock.sequence + 1, __ATOMIC_RELEASE);
+    if (__atomic_exchange_n(&table_lock.state, 0, __ATOMIC_RELEASE) == 2) {
+        table_futex(FUTEX_WAKE_PRIVATE, 1);
+    }
+}
+
+// Start of a lock-free read; pass the result to table_read_retry
+unsigned int table_read_begin() {
+    unsigned int sequence;
+    int spins = 0;
+    while ((sequence = __atomic_load_n(&table_lock.sequence, __ATOMIC_ACQUIRE)) & 1) {
+        if (++spins > 100) {
+            sched_yield();
+        }
+    }
+    return sequence;
+}
+
+// Non-zero if a writer changed the table since table_read_begin
+int table_read_retry(unsigned int sequence) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&table_lock.sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+// Consistent copy of the active processes; the caller frees it
+ProcessRow* snapshot_processes(int* count) {
+    ProcessRow* rows = NULL;
+    int capacity = 0;
+    unsigned int sequence;
+    
+    do {
+        sequence = table_read_begin();
+        int used = __atomic_load_n(&process_table_used, __ATOMIC_ACQUIRE);
+        if (used > capacity) {
+            ProcessRow* grown = realloc(rows, used * sizeof(ProcessRow));
+            if (grown == NULL) {
+                free(rows);
+                *count = 0;
+                return NULL;
+            }
+            rows = grown;
+            capacity = used;
+        }
+        
+        *count = 0;
+        for (int i = 0; i < used; i++) {
+            const PCB* process = &process_table[i];
+            if (!process->is_active) {
+                continue;
+            }
+            ProcessRow* row = &rows[(*count)++];
+            row->index = i;
+            row->pid = process->pid;
+            memcpy(row->name, process->name, TASK_NAME_LENGTH);
+            row->name[TASK_NAME_LENGTH - 1] = '\0';
+            row->ram_required = process->ram_required;
+            row->hdd_required = process->hdd_required;
+            row->priority = process->priority;
+            row->rss_kb = process->rss_kb;
+            row->cpu_ms = process->cpu_ms;
+            row->sampled = process->usage.sampled_ns > 0;
+            row->is_minimized = process->is_minimized;
+            row->is_dispatched = process->is_dispatched;
+            row->is_queued = process->is_queued;
+            row->start_time = process->start_time;
+            row->usage = process->usage;
+        }
+    } while (table_read_retry(sequence));
+    
+    return rows;
+}
+
+// ##########################################
+// PROCESS TABLE
+// ##########################################
+// Slots are handed out from an intrusive free list. Active slots are chained
+// into a PID hash and a name hash so lookups do not scan the table.
+
+static unsigned int pid_bucket(int pid) {
+    return ((unsigned int)pid * 2654435761u) & index_mask;
+}
+
+// FNV-1a hash of a task name
+static unsigned int name_bucket(const char* name) {
+    unsigned int hash = 2166136261u;
+    while (*name != '\0') {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash & index_mask;
+}
+
+// Link field of a slot in the PID or the name chain
+static int* chain_next(int index, int by_name) {
+    return by_name ? &process_table[index].name_next : &process_table[index].pid_next;
+}
+
+// Unlink a slot from the hash chain starting at bucket
+static void unlink_slot(int* bucket, int index, int by_name) {
+    int* link = bucket;
+    while (*link != -1) {
+        int* next = chain_next(*link, by_name);
+        if (*link == index) {
+            *link = *next;
+            *next = -1;
+            return;
+        }
+        link = next;
+    }
 }
 
 void initialize_process_table() {
-    for (int i = 0; i < MAX_TASKS; i++) {
+    // Two buckets per slot keeps the chains short
+    unsigned int buckets = 1;
+    while (buckets < (unsigned int)max_tasks * 2) {
+        buckets <<= 1;
+    }
+    index_mask = buckets - 1;
+    
+    process_table = calloc(max_tasks, sizeof(PCB));
+    pid_buckets = malloc(buckets * sizeof(int));
+    name_buckets = malloc(buckets * sizeof(int));
+    if (process_table == NULL || pid_buckets == NULL || name_buckets == NULL) {
+        perror("Failed to allocate the process table");
+        exit(EXIT_FAILURE);
+    }
+    
+    for (unsigned int b = 0; b < buckets; b++) {
+        pid_buckets[b] = -1;
+        name_buckets[b] = -1;
+    }
+    
+    // Lower slots come off the free list first so scans stay short
+    for (int i = max_tasks - 1; i >= 0; i--) {
         process_table[i].pid = -1;
-        process_table[i].is_active = 0;
-        process_table[i].is_minimized = 0;
-        strcpy(process_table[i].name, "");
+        process_table[i].pid_next = -1;
+        process_table[i].name_next = -1;
+        process_table[i].child_pid = -1;
+        process_table[i].child_pidfd = -1;
+        process_table[i].reservation.ram_base = -1;
+        process_table[i].last_core = -1;
+        process_table[i].pinned_cpu = -1;
+        process_table[i].free_next = free_slot_head;
+        free_slot_head = i;
+    }
+    process_count = 0;
+    process_table_used = 0;
+}
+
+void destroy_process_table() {
+    free(process_table);
+    free(pid_buckets);
+    free(name_buckets);
+    process_table = NULL;
+    pid_buckets = NULL;
+    name_buckets = NULL;
+    free_slot_head = -1;
+}
+
+// Take a free slot, mark it active and index it by name; -1 if the table is full
+int process_table_insert(const char* name) {
+    int index = free_slot_head;
+    if (index == -1) {
+        return -1;
+    }
+    
+    PCB* process = &process_table[index];
+    free_slot_head = process->free_next;
+    process->free_next = -1;
+    
+    process->pid = -1;
+    process->is_active = 1;
+    process->is_minimized = 0;
+    process->is_queued = 0;
+    process->is_dispatched = 0;
+    process->dispatch_count = 0;
+    process->burst_estimate_ms = SJF_INITIAL_BURST_MS;
+    process->mlfq_level = 0;
+    process->last_core = -1;
+    process->pinned_cpu = -1;
+    process->child_pid = -1;
+    process->child_pidfd = -1;
+    process->exit_status = 0;
+    process->reservation.state = 0;
+    process->reservation.ram_base = -1;
+    process->cgroup_id = 0;
+    process->terminating = 0;
+    process->rss_kb = 0;
+    process->peak_rss_kb = 0;
+    process->cpu_ms = 0;
+    strncpy(process->name, name, TASK_NAME_LENGTH - 1);
+    process->name[TASK_NAME_LENGTH - 1] = '\0';
+    
+    unsigned int bucket = name_bucket(process->name);
+    process->name_next = name_buckets[bucket];
+    name_buckets[bucket] = index;
+    
+    if (index >= process_table_used) {
+        __atomic_store_n(&process_table_used, index + 1, __ATOMIC_RELEASE);
+    }
+    process_count++;
+    return index;
+}
+
+// Drop a slot from both indexes and return it to the free list.
+// The PCB contents stay readable until the slot is handed out again.
+void process_table_remove(int index) {
+    PCB* process = &process_table[index];
+    if (!process->is_active) {
+        return;
+    }
+    
+    if (process->pid != -1) {
+        unlink_slot(&pid_buckets[pid_bucket(process->pid)], index, 0);
+    }
+    unlink_slot(&name_buckets[name_bucket(process->name)], index, 1);
+    
+    process->is_active = 0;
+    process->is_minimized = 0;
+    process->free_next = free_slot_head;
+    free_slot_head = index;
+    process_count--;
+}
+
+// Change the PID of an active slot and move it to the matching bucket
+void process_table_set_pid(int index, int pid) {
+    PCB* process = &process_table[index];
+    
+    if (process->pid != -1) {
+        unlink_slot(&pid_buckets[pid_bucket(process->pid)], index, 0);
+    }
+    process->pid = pid;
+    if (pid != -1) {
+        unsigned int bucket = pid_bucket(pid);
+        process->pid_next = pid_buckets[bucket];
+        pid_buckets[bucket] = index;
+    }
+}
+
+// Slot of the active process with this PID, or -1
+int find_process_by_pid(int pid) {
+    for (int i = pid_buckets[pid_bucket(pid)]; i != -1; i = process_table[i].pid_next) {
+        if (process_table[i].pid == pid && process_table[i].is_active) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Slot of an active process with this name, or -1
+int find_process_by_name(const char* name, int minimized_only) {
+    for (int i = name_buckets[name_bucket(name)]; i != -1; i = process_table[i].name_next) {
+        if (strcmp(process_table[i].name, name) == 0 &&
+            (!minimized_only || process_table[i].is_minimized)) {
+            return i;
+        }
     }
+    return -1;
 }
 
 void boot_sequence() {
-    system("clear");
+    if (batch_mode) {
+        printf("%s booting in batch mode\n", OS_NAME);
+        return;
+    }
+    
+    clear_screen();
     
     
     printf("\n\n");
@@ -355,7 +1434,7 @@ void boot_sequence() {
     printf("╚═══════════════════════════════════════════════════════╝\n");
     printf("         Operating System Simulator v1.0\n\n");
     
-    sleep(2);
+    ui_delay(2000);
     
     // Boot animation
     printf("┌─────────────────────────────────────────────────┐\n");
@@ -381,14 +1460,14 @@ void boot_sequence() {
         
         // Animated dots
         for (int j = 0; j < 3; j++) {
-            usleep(200000);  
+            ui_delay(200);  
             printf(".");
             fflush(stdout);
         }
         
-        usleep(300000);  
+        ui_delay(300);  
         printf(" [DONE]\n");
-        usleep(250000);  
+        ui_delay(250);  
     }
     
     printf("\n");
@@ -396,10 +1475,18 @@ void boot_sequence() {
     printf("│ √ %s is now ready!                               │\n", OS_NAME);
     printf("└─────────────────────────────────────────────────────┘\n\n");
     
-    sleep(1);
+    ui_delay(1000);
 }
 
 void initialize_hardware() {
+    if (hardware_preset) {
+        // Given on the command line, nothing to ask
+        init_resource_pool(hardware.ram_gb * 1024, hardware.hdd_gb, hardware.cpu_cores);
+        printf("System initialized with %d GB RAM, %d GB HDD, and %d CPU cores.\n", 
+               hardware.ram_gb, hardware.hdd_gb, hardware.cpu_cores);
+        return;
+    }
+    
     printf("Hardware Configuration\n");
     printf("---------------------\n");
     
@@ -416,17 +1503,15 @@ void initialize_hardware() {
     while (getchar() != '\n'); 
     
     // Initialize available resources
-    hardware.available_ram = hardware.ram_gb * 1024; // Convert to MB
-    hardware.available_hdd = hardware.hdd_gb;
-    hardware.available_cores = hardware.cpu_cores;
+    init_resource_pool(hardware.ram_gb * 1024, hardware.hdd_gb, hardware.cpu_cores); // RAM in MB
     
     printf("\nSystem initialized with %d GB RAM, %d GB HDD, and %d CPU cores.\n", 
            hardware.ram_gb, hardware.hdd_gb, hardware.cpu_cores);
-    sleep(2);
+    ui_delay(2000);
 }
 
 void display_main_menu() {
-    system("clear");
+    clear_screen();
     
     // ASCII art header
     printf("\n");
@@ -445,9 +1530,21 @@ void display_main_menu() {
     printf("│ %-15s %-35s │\n", "MODE:", is_kernel_mode ? "[K] Kernel Mode" : "[U] User Mode");
     printf("│ %-15s %-35s │\n", "SCHEDULER:", get_scheduler_name(current_scheduler));
     printf("├─────────────────────────────────────────────────────┤\n");
-    printf("│ %-15s %d/%d MB                       │\n", "RAM:", hardware.available_ram, hardware.ram_gb * 1024);
-    printf("│ %-15s %d/%d GB                          │\n", "STORAGE:", hardware.available_hdd, hardware.hdd_gb);
-    printf("│ %-15s %d/%d                                 │\n", "CPU CORES:", hardware.available_cores, hardware.cpu_cores);
+    ResourceCounts available = available_resources();
+    printf("│ %-15s %d/%d MB                       │\n", "RAM:", available.ram_mb, hardware.ram_gb * 1024);
+    printf("│ %-15s %d/%d GB                          │\n", "STORAGE:", available.hdd_gb, hardware.hdd_gb);
+    int free_slots = hardware.cpu_cores - __atomic_load_n(&dispatched_count, __ATOMIC_RELAXED);
+    printf("│ %-15s %d/%d                                 │\n", "CPU CORES:", free_slots, hardware.cpu_cores);
+    
+    // Fragmentation of the simulated RAM
+    RamStats ram_stats;
+    char ram_summary[64];
+    pthread_mutex_lock(&ram_allocator_mutex);
+    ram_allocator_stats(&ram_allocator, &ram_stats);
+    pthread_mutex_unlock(&ram_allocator_mutex);
+    snprintf(ram_summary, sizeof(ram_summary), "%s, largest %d MB, %.0f%% frag",
+             ram_allocator_name(ram_allocator_type), ram_stats.largest_free_mb, ram_stats.external * 100);
+    printf("│ %-15s %-35s │\n", "PLACEMENT:", ram_summary);
     printf("└─────────────────────────────────────────────────────┘\n");
     
     // Menu options
@@ -464,7 +1561,7 @@ void display_main_menu() {
 }
 
 void display_applications_menu() {
-    system("clear");
+    clear_screen();
     
     // Header
     printf("\n");
@@ -482,7 +1579,7 @@ void display_applications_menu() {
     
     for (int i = 0; i < num_available_tasks; i++) {
         
-        printf("│  [%2d] %c %-20s RAM: %4d MB   HDD: %2d GB  │\n", 
+        printf("│  [%2d] %-20s RAM: %4d MB   HDD: %2d GB      │\n", 
                i + 1, available_tasks[i].name, 
                available_tasks[i].ram_required, 
                available_tasks[i].hdd_required);
@@ -500,7 +1597,7 @@ void display_applications_menu() {
 }
 
 void display_task_manager() {
-    system("clear");
+    clear_screen();
     
     // Header
     printf("\n");
@@ -513,40 +1610,65 @@ void display_task_manager() {
     printf("│ Mode: %-10s           Scheduler: %-12s │\n", 
            is_kernel_mode ? "[K] Kernel" : "[U] User", 
            get_scheduler_name(current_scheduler));
+    
+    // Spread of the work over the cores
+    unsigned long redispatches = 0;
+    unsigned long warm = 0;
+    for (int w = 0; w < num_worker_queues; w++) {
+        redispatches += worker_queues[w].redispatches;
+        warm += worker_queues[w].warm_dispatches;
+    }
+    char core_summary[64];
+    snprintf(core_summary, sizeof(core_summary), "Cores: %d, %lu migrations, %.0f%% cache-warm",
+             num_worker_queues, balance_stats.migrations, redispatches > 0 ? 100.0 * warm / redispatches : 100.0);
+    printf("│ %-51s │\n", core_summary);
     printf("└─────────────────────────────────────────────────────┘\n");
     
     // Display running processes
     printf("\n");
     printf("┌─────────────────── RUNNING PROCESSES ───────────────────┐\n");
-    printf("│ %-5s │ %-20s │ %-8s │ %-8s │ %-8s │\n", 
-           "PID", "NAME", "RAM (MB)", "HDD (GB)", "STATUS");
-    printf("├───────┼──────────────────────┼──────────┼──────────┼──────────┤\n");
+    printf("│ %-5s │ %-20s │ %-8s │ %-8s │ %-8s │ %-8s │ %-8s │\n", 
+           "PID", "NAME", "RAM (MB)", "RSS (MB)", "CPU (s)", "HDD (GB)", "STATUS");
+    printf("├───────┼──────────────────────┼──────────┼──────────┼──────────┼──────────┼──────────┤\n");
     
     
     int active_count = 0;
+    ProcessRow* rows = snapshot_processes(&active_count);
     
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (process_table[i].is_active) {
-            active_count++;
-            char status[20] = "[A] Active";
-            
-            if (process_table[i].is_minimized) {
-                strcpy(status, "[M] Minimized");
-            }
-            
-            printf("│ %-5d │ %-20s │ %-8d │ %-8d │ %-8s │\n", 
-                   process_table[i].pid, 
-                   process_table[i].name, 
-                   process_table[i].ram_required, 
-                   process_table[i].hdd_required,
-                   status);
-            
-            if (i < MAX_TASKS - 1 && active_count < process_count) {
-                printf("├───────┼──────────────────────┼──────────┼──────────┼──────────┤\n");
-            }
+    for (int i = 0; i < active_count; i++) {
+        char status[20] = "[A] Active";
+        
+        if (rows[i].is_minimized) {
+            strcpy(status, "[M] Minimized");
+        } else if (rows[i].is_dispatched) {
+            strcpy(status, "[R] Running");
+        } else if (rows[i].is_queued) {
+            strcpy(status, "[W] Waiting");
+        }
+        
+        // Cached by the supervisor; nothing is read from /proc here
+        char rss[24] = "-";
+        char cpu[24] = "-";
+        if (rows[i].sampled) {
+            snprintf(rss, sizeof(rss), "%ld", rows[i].rss_kb / 1024);
+            snprintf(cpu, sizeof(cpu), "%.1f", rows[i].cpu_ms / 1000.0);
+        }
+        
+        printf("│ %-5d │ %-20s │ %-8d │ %-8s │ %-8s │ %-8d │ %-8s │\n", 
+               rows[i].pid, 
+               rows[i].name, 
+               rows[i].ram_required, 
+               rss,
+               cpu,
+               rows[i].hdd_required,
+               status);
+        
+        if (i + 1 < active_count) {
+            printf("├───────┼──────────────────────┼──────────┼──────────┼──────────┼──────────┼──────────┤\n");
         }
     }
-    printf("└───────┴──────────────────────┴──────────┴──────────┴──────────┘\n");
+    free(rows);
+    printf("└───────┴──────────────────────┴──────────┴──────────┴──────────┴──────────┴──────────┘\n");
     
     if (active_count == 0) {
         printf("│                   No active processes.                    │\n");
@@ -571,352 +1693,158 @@ void display_task_manager() {
         printf("│  [4] Send Interrupt to a Process                    │\n");
     }
     
+    printf("├─────────────────────────────────────────────────────┤\n");
+    printf("│  [5] Live Resource Usage                            │\n");
     printf("├─────────────────────────────────────────────────────┤\n");
     printf("│  [0] Back to Main Menu                              │\n");
     printf("└─────────────────────────────────────────────────────┘\n");
 }
 
-int allocate_resources(int ram_required, int hdd_required) {
-    pthread_mutex_lock(&resource_mutex);
-    
-    if (hardware.available_ram >= ram_required && 
-        hardware.available_hdd >= hdd_required && 
-        hardware.available_cores > 0) {
-        
-        hardware.available_ram -= ram_required;
-        hardware.available_hdd -= hdd_required;
-        hardware.available_cores--;
-        
-        pthread_mutex_unlock(&resource_mutex);
-        return 1; // Resources allocated successfully
-    }
-    
-    pthread_mutex_unlock(&resource_mutex);
-    return 0; // Not enough resources
-}
-
-void free_resources(int index) {
-    pthread_mutex_lock(&resource_mutex);
-    
-    hardware.available_ram += process_table[index].ram_required;
-    hardware.available_hdd += process_table[index].hdd_required;
-    hardware.available_cores++;
-    
-    pthread_mutex_unlock(&resource_mutex);
+// find_process_by_pid for threads that do not hold the table write lock
+int lookup_process_by_pid(int pid) {
+    unsigned int sequence;
+    int index;
+    do {
+        sequence = table_read_begin();
+        index = find_process_by_pid(pid);
+    } while (table_read_retry(sequence));
+    return index;
 }
 
 // Check if an application is already running
 int is_application_running(const char* app_name) {
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (process_table[i].is_active && strcmp(process_table[i].name, app_name) == 0) {
-            return 1; // Application is already running
-        }
-    }
-    return 0; // Application is not running
+    unsigned int sequence;
+    int running;
+    do {
+        sequence = table_read_begin();
+        running = find_process_by_name(app_name, 0) >= 0;
+    } while (table_read_retry(sequence));
+    return running;
 }
 
-void launch_task(int task_id) {
+int launch_task_background(int task_id) {
     // Check if the application is already running
     if (is_application_running(available_tasks[task_id].name)) {
-        // If it's already running but minimized, we can resume it
-        for (int i = 0; i < MAX_TASKS; i++) {
-            if (process_table[i].is_active && 
-                strcmp(process_table[i].name, available_tasks[task_id].name) == 0 &&
-                process_table[i].is_minimized) {
-                printf("Resuming %s...\n", available_tasks[task_id].name);
-                resume_process(i);
-                return;
-            }
-        }
-        
-        // If it's active and not minimized, we can't start another instance
-        printf("ERROR: %s is already running!\n", available_tasks[task_id].name);
-        sleep(2);
-        return;
+        // If it's already running, we don't need to start it again
+        return -1;
     }
     
     // Check if we have available slots
-    if (process_count >= MAX_TASKS) {
+    if (process_count >= max_tasks) {
         printf("ERROR: Maximum number of processes reached!\n");
-        sleep(2);
-        return;
+        ui_delay(1000);
+        return -1;
     }
     
     int ram_required = available_tasks[task_id].ram_required;
     int hdd_required = available_tasks[task_id].hdd_required;
     
     // Try to allocate resources
-    if (!allocate_resources(ram_required, hdd_required)) {
+    ResourceReservation reservation;
+    if (!reserve_resources(&reservation, ram_required, hdd_required)) {
+        metric_add(METRIC_ADMISSION_REJECTIONS, 1);
         printf("ERROR: Not enough system resources to start %s!\n", 
                available_tasks[task_id].name);
-        sleep(2);
-        return;
+        ui_delay(1000);
+        return -1;
     }
     
     // Check if the task is executable
     if (access(available_tasks[task_id].path, X_OK) != 0) {
         printf("ERROR: %s is not executable!\n", available_tasks[task_id].name);
         // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sleep(2);
-        return;
+        release_reservation(&reservation);
+        ui_delay(1000);
+        return -1;
     }
     
     // Reserve a slot in the process table before executing the task
-    int index = -1;
-    if (sem_wait(process_semaphore) < 0) {
-        perror("sem_wait failed");
-        // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sleep(2);
-        return;
-    }
+    table_write_lock();
     
-    // Find an empty slot
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (!process_table[i].is_active) {
-            index = i;
-            break;
-        }
-    }
+    // Take a slot from the free list
+    int index = process_table_insert(available_tasks[task_id].name);
     
     if (index == -1) {
         // No empty slot found
         printf("ERROR: No empty slot in process table!\n");
         // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sem_post(process_semaphore);
-        sleep(2);
-        return;
-    }
-    
-    // Set up information in the process table
-    process_table[index].pid = getpid(); // Use our own PID for now
-    process_table[index].is_active = 1;
-    process_table[index].is_minimized = 0;
-    process_table[index].ram_required = ram_required;
-    process_table[index].hdd_required = hdd_required;
-    process_table[index].priority = available_tasks[task_id].priority;
-    process_table[index].start_time = time(NULL);
-    strcpy(process_table[index].name, available_tasks[task_id].name);
-    strcpy(process_table[index].task_path, available_tasks[task_id].path);
-    
-    process_count++;
-    
-    // Here we could add scheduler-specific logic
-    // For example, with Priority scheduling, we might want to prioritize this task
-    // based on its priority value
-    if (current_scheduler == SCHEDULER_PRIORITY) {
-        printf("Using Priority scheduling for this task (priority: %d).\n", 
-               available_tasks[task_id].priority);
-        sleep(1);
-    }
-    // For SJF, we might want to show estimated completion time
-    else if (current_scheduler == SCHEDULER_SJF) {
-        printf("Using Shortest Job First scheduling. Task size: %d MB.\n", 
-               available_tasks[task_id].ram_required);
-        sleep(1);
-    }
-    // For Round Robin, we might want to mention the time quantum
-    else if (current_scheduler == SCHEDULER_RR) {
-        printf("Using Round Robin scheduling with default time quantum.\n");
-        sleep(1);
-    }
-
-    printf("Starting %s...\n", available_tasks[task_id].name);
-    sem_post(process_semaphore);
-    
-    // Clear the screen before launching the task
-    system("clear");
-    
-    // Execute the task directly in the current terminal
-    int status;
-    pid_t result = system(available_tasks[task_id].path);
-    
-    if (WIFEXITED(result)) {
-        status = WEXITSTATUS(result);
-        
-        // Check the exit status to see if we need to minimize instead of close
-        if (status == 10) {
-            // Application requested to be minimized
-            if (sem_wait(process_semaphore) < 0) {
-                perror("sem_wait failed");
-            } else {
-                process_table[index].is_minimized = 1;
-                sem_post(process_semaphore);
-                printf("%s was minimized. You can resume it later.\n", available_tasks[task_id].name);
-                sleep(2);
-            }
-        } else {
-            // Application exited normally, free resources
-            if (sem_wait(process_semaphore) < 0) {
-                perror("sem_wait failed");
-            } else {
-                process_table[index].is_active = 0;
-                process_table[index].is_minimized = 0;
-                process_count--;
-                sem_post(process_semaphore);
-            }
-            
-            // Free resources allocated to this process
-            free_resources(index);
-            
-            printf("%s was closed.\n", available_tasks[task_id].name);
-            sleep(2);
-        }
-    } else {
-        printf("ERROR: Failed to execute %s!\n", available_tasks[task_id].name);
-        
-        // Free resources and update process table
-        if (sem_wait(process_semaphore) < 0) {
-            perror("sem_wait failed");
-        } else {
-            process_table[index].is_active = 0;
-            process_table[index].is_minimized = 0;
-            process_count--;
-            sem_post(process_semaphore);
-        }
-        
-        // Free resources allocated to this process
-        free_resources(index);
-        
-        sleep(2);
-    }
-    
-    // Clear the screen after the task finishes
-    system("clear");
-}
-
-void launch_task_background(int task_id) {
-    // Check if the application is already running
-    if (is_application_running(available_tasks[task_id].name)) {
-        // If it's already running, we don't need to start it again
-        return;
-    }
-    
-    // Check if we have available slots
-    if (process_count >= MAX_TASKS) {
-        printf("ERROR: Maximum number of processes reached!\n");
-        sleep(1);
-        return;
-    }
-    
-    int ram_required = available_tasks[task_id].ram_required;
-    int hdd_required = available_tasks[task_id].hdd_required;
-    
-    // Try to allocate resources
-    if (!allocate_resources(ram_required, hdd_required)) {
-        printf("ERROR: Not enough system resources to start %s!\n", 
-               available_tasks[task_id].name);
-        sleep(1);
-        return;
-    }
-    
-    // Check if the task is executable
-    if (access(available_tasks[task_id].path, X_OK) != 0) {
-        printf("ERROR: %s is not executable!\n", available_tasks[task_id].name);
-        // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sleep(1);
-        return;
-    }
-    
-    // Reserve a slot in the process table before executing the task
-    int index = -1;
-    if (sem_wait(process_semaphore) < 0) {
-        perror("sem_wait failed");
-        // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sleep(1);
-        return;
+        release_reservation(&reservation);
+        table_write_unlock();
+        ui_delay(1000);
+        return -1;
     }
     
-    // Find an empty slot
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (!process_table[i].is_active) {
-            index = i;
-            break;
-        }
-    }
-    
-    if (index == -1) {
-        // No empty slot found
-        printf("ERROR: No empty slot in process table!\n");
-        // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sem_post(process_semaphore);
-        sleep(1);
-        return;
+    // The initial grant must pass the deadlock check like any later request
+    if (!admit_task_claim(index, task_id)) {
+        process_table_remove(index);
+        release_reservation(&reservation);
+        table_write_unlock();
+        ui_delay(1000);
+        return -1;
     }
     
     // Set up information in the process table
-    process_table[index].pid = getpid(); // Use our own PID for now
-    process_table[index].is_active = 1;
     process_table[index].is_minimized = 1; // Start minimized
     process_table[index].ram_required = ram_required;
+    process_table[index].reservation = reservation;
     process_table[index].hdd_required = hdd_required;
     process_table[index].priority = available_tasks[task_id].priority;
     process_table[index].start_time = time(NULL);
-    strcpy(process_table[index].name, available_tasks[task_id].name);
     strcpy(process_table[index].task_path, available_tasks[task_id].path);
     
-    process_count++;
+    table_write_unlock();
     
-    // This is a background task, so don't show messages or clear the screen
-    sem_post(process_semaphore);
+    // The task gets its pseudo-terminal but not the screen; it stays stopped
+    // until it is resumed, like a task the user minimized
+    if (start_task(index) == -1) {
+        table_write_lock();
+        process_table_remove(index);
+        table_write_unlock();
+        free_resources(index);
+        ui_delay(1000);
+        return -1;
+    }
+    return index;
 }
 
 void list_running_processes() {
     printf("\nRunning Processes:\n");
-    printf("--------------------------------------------------------------------------------\n");
-    printf("| %-5s | %-20s | %-8s | %-8s | %-8s | %-15s |\n", 
-           "PID", "Name", "RAM (MB)", "HDD (GB)", "Priority", "Running Time");
-    printf("--------------------------------------------------------------------------------\n");
+    printf("------------------------------------------------------------------------------------------------\n");
+    printf("| %-5s | %-20s | %-8s | %-8s | %-8s | %-12s | %-8s | %-8s |\n", 
+           "PID", "Name", "User (s)", "Sys (s)", "Max RSS", "Switches v/i", "Faults", "Running");
+    printf("------------------------------------------------------------------------------------------------\n");
     
     time_t current_time = time(NULL);
     int active_count = 0;
+    ProcessRow* rows = snapshot_processes(&active_count);
     
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (process_table[i].is_active) {
-            active_count++;
-            int running_seconds = (int)difftime(current_time, process_table[i].start_time);
-            int minutes = running_seconds / 60;
-            int seconds = running_seconds % 60;
-            
-            printf("| %-5d | %-20s | %-8d | %-8d | %-8d | %02d:%02d           |\n", 
-                   process_table[i].pid, 
-                   process_table[i].name, 
-                   process_table[i].ram_required, 
-                   process_table[i].hdd_required,
-                   process_table[i].priority,
-                   minutes, seconds);
+    for (int i = 0; i < active_count; i++) {
+        int running_seconds = (int)difftime(current_time, rows[i].start_time);
+        int minutes = running_seconds / 60;
+        int seconds = running_seconds % 60;
+        
+        // Last sample of the supervisor, or the rusage of the exited child
+        const TaskUsage* usage = &rows[i].usage;
+        char max_rss[24] = "-";
+        char switches[48] = "-";
+        char faults[24] = "-";
+        if (usage->sampled_ns > 0) {
+            snprintf(max_rss, sizeof(max_rss), "%ld MB", usage->max_rss_kb / 1024);
+            snprintf(switches, sizeof(switches), "%ld/%ld", usage->voluntary_switches,
+                     usage->involuntary_switches);
+            snprintf(faults, sizeof(faults), "%ld", usage->minor_faults + usage->major_faults);
         }
+        
+        printf("| %-5d | %-20s | %-8.2f | %-8.2f | %-8s | %-12s | %-8s | %02d:%02d    |\n", 
+               rows[i].pid, 
+               rows[i].name, 
+               usage->user_ms / 1000.0,
+               usage->system_ms / 1000.0,
+               max_rss, switches, faults,
+               minutes, seconds);
     }
-    printf("--------------------------------------------------------------------------------\n");
+    free(rows);
+    printf("------------------------------------------------------------------------------------------------\n");
     
     if (active_count == 0) {
         printf("No active processes.\n");
@@ -931,20 +1859,17 @@ void minimize_process(int index) {
     if (process_table[index].is_active && !process_table[index].is_minimized) {
         printf("Minimizing process %s...\n", process_table[index].name);
         
-        // Set the process as minimized
-        if (sem_wait(process_semaphore) < 0) {
-            perror("sem_wait failed");
-            sleep(2);
-            return;
-        }
+        // Set the process as minimized and stop its task where it is
+        table_write_lock();
         process_table[index].is_minimized = 1;
-        sem_post(process_semaphore);
+        table_write_unlock();
+        signal_task(process_table[index].child_pid, SIGSTOP);
         
         printf("Process minimized successfully.\n");
-        sleep(1);
+        ui_delay(1000);
     } else if (process_table[index].is_minimized) {
         printf("Process %s is already minimized.\n", process_table[index].name);
-        sleep(1);
+        ui_delay(1000);
     }
 }
 
@@ -954,79 +1879,56 @@ void resume_process(int index) {
                process_table[index].name);
         
         // Set the process as not minimized
-        if (sem_wait(process_semaphore) < 0) {
-            perror("sem_wait failed");
-            sleep(2);
-            return;
-        }
+        table_write_lock();
         process_table[index].is_minimized = 0;
-        sem_post(process_semaphore);
-        
-        // Clear the screen before launching the task
-        system("clear");
+        table_write_unlock();
+        trace_event(TRACE_RESUME, process_table[index].pid, 0, 0);
         
-        // Execute the task directly in the current terminal
-        int status;
-        pid_t result = system(process_table[index].task_path);
+        // A resident task continues where it stopped; one that exited to
+        // minimize starts over
+        pid_t pid = process_table[index].child_pid;
+        if (pid > 0) {
+            enqueue_process(&process_table[index]);
+        } else {
+            clear_screen();
+            pid = start_task(index);
+        }
         
-        if (WIFEXITED(result)) {
-            status = WEXITSTATUS(result);
-            
-            // Check the exit status to see if we need to minimize instead of close
-            if (status == 10) {
-                // Application requested to be minimized
-                if (sem_wait(process_semaphore) < 0) {
-                    perror("sem_wait failed");
-                } else {
-                    process_table[index].is_minimized = 1;
-                    sem_post(process_semaphore);
-                    printf("%s was minimized again. You can resume it later.\n", process_table[index].name);
-                    sleep(2);
-                }
-            } else {
-                // Application exited normally, free resources
-                if (sem_wait(process_semaphore) < 0) {
-                    perror("sem_wait failed");
-                } else {
-                    process_table[index].is_active = 0;
-                    process_table[index].is_minimized = 0;
-                    process_count--;
-                    sem_post(process_semaphore);
-                }
-                
-                // Free resources allocated to this process
-                free_resources(index);
-                
-                printf("%s was closed.\n", process_table[index].name);
-                sleep(2);
-            }
+        if (pid != -1) {
+            // The supervisor already minimized or released the process
+            int status = foreground_task(&index, pid);
+            report_foreground(index, status);
+            ui_delay(2000);
         } else {
             printf("ERROR: Failed to execute %s!\n", process_table[index].name);
             
             // Process will stay minimized, keeping its resources
-            if (sem_wait(process_semaphore) < 0) {
-                perror("sem_wait failed");
-            } else {
-                process_table[index].is_minimized = 1;
-                sem_post(process_semaphore);
-            }
+            table_write_lock();
+            process_table[index].is_minimized = 1;
+            table_write_unlock();
             
-            sleep(2);
+            ui_delay(2000);
         }
         
         // Clear the screen after the task finishes
-        system("clear");
+        clear_screen();
+    } else if (process_table[index].is_active && process_table[index].child_pid > 0) {
+        // Running in the background: bring its console back to the screen
+        int status = foreground_task(&index, process_table[index].child_pid);
+        report_foreground(index, status);
+        ui_delay(2000);
+        clear_screen();
     } else if (!process_table[index].is_minimized) {
         printf("Process %s is already active.\n", 
                process_table[index].name);
-        sleep(1);
+        ui_delay(1000);
     }
 }
 
 void send_interrupt(int index, int signal_type) {
     if (!process_table[index].is_active) {
         printf("Process does not exist or is not active.\n");
-        sleep(1);
+        ui_delay(1000);
         return;
     }
     
@@ -1043,89 +1945,91 @@ void send_interrupt(int index, int signal_type) {
             break;
         default:
             printf("Invalid signal type.\n");
-            sleep(1);
+            ui_delay(1000);
             return;
     }
 }
 
 void terminate_process(int index) {
     if (process_table[index].is_active) {
-        char process_name[TASK_NAME_LENGTH];
-        strcpy(process_name, process_table[index].name);
-        
-        printf("Terminating process %s...\n", process_name);
-        
-        // First update the process table to mark it as inactive
-        if (sem_wait(process_semaphore) < 0) {
-            perror("sem_wait failed");
-            sleep(2);
-            return;
-        }
-        process_table[index].is_active = 0;
-        process_table[index].is_minimized = 0;
-        process_count--;
-        sem_post(process_semaphore);
-        
-        // Free resources allocated to this process
-        free_resources(index);
-        
-        // Force kill any related processes by name
-        char pkill_cmd[200];
-        sprintf(pkill_cmd, "pkill -f '%s'", process_name);
-        system(pkill_cmd);
-        
-        printf("Process terminated successfully.\n");
-        sleep(1);
+        terminate_processes(&index, 1);
+        ui_delay(1000);
+    }
+}
+
+// Terminate several processes at once: their tasks all get SIGTERM together
+// and share one grace period before SIGKILL, then the slots are released
+void terminate_processes(const int* indexes, int count) {
+    for (int i = 0; i < count; i++) {
+        printf("Terminating process %s...\n", process_table[indexes[i]].name);
+        metric_add(METRIC_TERMINATIONS, 1);
+        trace_event(TRACE_TERMINATE, process_table[indexes[i]].pid, 0, 0);
+    }
+    
+    int killed = stop_children(indexes, count, term_timeout_ms);
+    if (killed > 0) {
+        printf("%d process(es) ignored SIGTERM for %d ms and were killed.\n", killed, term_timeout_ms);
+    }
+    
+    // The supervisor released the slots of reaped tasks already; minimized
+    // tasks have no child and are released here
+    for (int i = 0; i < count; i++) {
+        table_write_lock();
+        process_table_remove(indexes[i]);
+        table_write_unlock();
+        free_resources(indexes[i]);
     }
+    printf("%s terminated successfully.\n", count == 1 ? "Process" : "Processes");
 }
 
 void switch_mode() {
     is_kernel_mode = !is_kernel_mode;
     printf("Switched to %s mode.\n", is_kernel_mode ? "Kernel" : "User");
-    sleep(1);
+    ui_delay(1000);
 }
 
 void shutdown_system() {
     printf("\nShutting down %s...\n", OS_NAME);
-    sleep(1);
+    ui_delay(1000);
     
     printf("Terminating all running processes...\n");
     
-    // Terminate all active processes
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (process_table[i].is_active) {
-            terminate_process(i); // Use our simplified termination function
+    // Terminate all active processes at once rather than one after another
+    int* active = malloc((process_table_used + 1) * sizeof(int));
+    int count = 0;
+    if (active != NULL) {
+        for (int i = 0; i < process_table_used; i++) {
+            if (process_table[i].is_active) {
+                active[count++] = i;
+            }
+        }
+        if (count > 0) {
+            terminate_processes(active, count);
         }
+        free(active);
     }
     
     printf("Stopping worker threads...\n");
     cleanup_worker_threads();
     
     printf("Saving system state...\n");
-    sleep(1);
+    ui_delay(1000);
     printf("Closing system services...\n");
-    sleep(1);
+    ui_delay(1000);
     printf("System shutdown complete.\n");
     
     printf("\nThank you for using %s!\n", OS_NAME);
 }
 
-// Signal handler for child process termination
-void handle_child_exit(int signum __attribute__((unused))) {
-    // This function is no longer needed with the in-window approach,
-    // but we keep it to maintain compatibility with any existing code
-    // that might expect it to be defined
-}
-
 // Function to change the CPU scheduler
 void change_scheduler() {
     if (!is_kernel_mode) {
         printf("ERROR: Cannot change scheduler in User Mode!\n");
-        sleep(2);
+        ui_delay(2000);
         return;
     }
     
-    system("clear");
+    clear_screen();
     printf("\n%s - CPU Scheduler Configuration\n", OS_NAME);
     printf("Current Scheduler: %s\n\n", get_scheduler_name(current_scheduler));
     
@@ -1134,6 +2038,8 @@ void change_scheduler() {
     printf("2. Shortest Job First (SJF)\n");
     printf("3. Priority Scheduling\n");
     printf("4. Round Robin (RR)\n");
+    printf("5. Multilevel Feedback Queue (MLFQ)\n");
+    printf("6. Tune MLFQ / View Level Statistics\n");
     printf("0. Back to Main Menu\n\n");
     
     int choice;
@@ -1141,6 +2047,7 @@ void change_scheduler() {
     scanf("%d", &choice);
     while (getchar() != '\n'); 
     
+    SchedulerType previous_scheduler = current_scheduler;
     switch (choice) {
         case 1:
             current_scheduler = SCHEDULER_FCFS;
@@ -1154,14 +2061,25 @@ void change_scheduler() {
         case 4:
             current_scheduler = SCHEDULER_RR;
             break;
+        case 5:
+            current_scheduler = SCHEDULER_MLFQ;
+            break;
+        case 6:
+            configure_mlfq();
+            return;
         case 0:
             return;
         default:
             printf("Invalid choice. Scheduler not changed.\n");
-            sleep(1);
+            ui_delay(1000);
             return;
     }
     
+    // Workers re-sort their waiting processes for the new algorithm
+    if (current_scheduler != previous_scheduler) {
+        __atomic_add_fetch(&scheduler_epoch, 1, __ATOMIC_RELEASE);
+    }
+    
     printf("CPU Scheduler changed to %s.\n", get_scheduler_name(current_scheduler));
     
     // When changing schedulers, we could optionally re-order the running processes
@@ -1170,7 +2088,7 @@ void change_scheduler() {
         printf("Note: Running processes will be scheduled according to the new algorithm.\n");
     }
     
-    sleep(2);
+    ui_delay(2000);
 }
 
 // Function to get the scheduler name as a string
@@ -1184,6 +2102,8 @@ const char* get_scheduler_name(SchedulerType scheduler) {
             return "Priority Scheduling";
         case SCHEDULER_RR:
             return "Round Robin";
+        case SCHEDULER_MLFQ:
+            return "Multilevel Feedback Queue";
         default:
             return "Unknown";
     }
@@ -1192,315 +2112,8339 @@ const char* get_scheduler_name(SchedulerType scheduler) {
 // New function to initialize the multilevel queue
 void init_multilevel_queue() {
     for (int i = 0; i < MAX_LEVELS; i++) {
-        ml_queue.front[i] = 0;
-        ml_queue.rear[i] = -1;
-        ml_queue.count[i] = 0;
-        
         // Set time quantum based on level
         // Lower levels get higher time quantum
         ml_queue.time_quantum[i] = (i + 1) * 2;
     }
+    
+    for (int w = 0; w < MAX_WORKER_QUEUES; w++) {
+        WorkerQueue* queue = &worker_queues[w];
+        deque_init(&queue->deque);
+        run_queue_init(&queue->sorter, current_scheduler);
+        queue->mailbox = NULL;
+        queue->batch = NULL;
+        queue->batch_capacity = 0;
+        queue->scheduler_epoch = scheduler_epoch;
+        queue->random_state = (unsigned long)w * 2654435761UL + 1;
+        queue->steals = 0;
+        queue->host_cpu = -1;
+        queue->queued = 0;
+        queue->running = 0;
+        queue->dispatches = 0;
+        queue->redispatches = 0;
+        queue->warm_dispatches = 0;
+        queue->migrations = 0;
+    }
+    memset(&balance_stats, 0, sizeof(balance_stats));
 }
 
-// New function to enqueue a process in the multilevel queue
-void enqueue_process(PCB* process) {
-    // Determine which level to place the process based on priority
-    int level;
-    if (process->priority >= 3) {
-        level = 0; // High priority
-    } else if (process->priority >= 1) {
-        level = 1; // Medium priority
-    } else {
-        level = 2; // Low priority
+// Release the memory held by the run queues
+void destroy_multilevel_queue() {
+    for (int w = 0; w < MAX_WORKER_QUEUES; w++) {
+        deque_free(&worker_queues[w].deque);
+        run_queue_free(&worker_queues[w].sorter);
+        free(worker_queues[w].batch);
+        worker_queues[w].batch = NULL;
+        worker_queues[w].batch_capacity = 0;
     }
-    
-    // Check if the queue at this level is full
-    if (ml_queue.count[level] >= MAX_TASKS) {
-        printf("Queue at level %d is full\n", level);
-        return;
+}
+
+void run_queue_init(RunQueue* queue, SchedulerType ordering) {
+    for (int i = 0; i < MAX_LEVELS; i++) {
+        fifo_init(&queue->fifo[i]);
+        heap_init(&queue->heap[i]);
+        queue->count[i] = 0;
     }
+    queue->ordering = ordering;
+}
+
+void run_queue_free(RunQueue* queue) {
+    for (int i = 0; i < MAX_LEVELS; i++) {
+        fifo_free(&queue->fifo[i]);
+        heap_free(&queue->heap[i]);
+        queue->count[i] = 0;
+    }
+}
+
+static int queue_uses_heap(SchedulerType ordering) {
+    return ordering == SCHEDULER_SJF || ordering == SCHEDULER_PRIORITY;
+}
+
+// Heap key of a process for the heap-ordered schedulers. SJF cannot know
+// the next CPU burst, so it uses an exponential average of the CPU time the
+// process used per dispatch: estimate = (measured + estimate) / 2, updated by
+// update_burst_estimate after every dispatch and starting at
+// SJF_INITIAL_BURST_MS. Processes that never ran tie and keep arrival order.
+static long long queue_heap_key(const PCB* process, SchedulerType ordering) {
+    if (ordering == SCHEDULER_SJF) {
+        return process->burst_estimate_ms;
+    }
+    return -(long long)process->priority; // Higher priority values run first
+}
+
+// Fold the CPU time of the dispatch that just ended into the SJF estimate
+// (weight 1/2, so older bursts fade geometrically)
+void update_burst_estimate(PCB* process, long cpu_ms) {
+    if (cpu_ms >= 0) {
+        process->burst_estimate_ms = (cpu_ms + process->burst_estimate_ms) / 2;
+    }
+}
+
+// Insert a process into its level without touching its arrival order
+void run_queue_push(RunQueue* queue, PCB* process) {
+    int level = process->queue_level;
     
-    // Add the process to the queue
-    ml_queue.rear[level] = (ml_queue.rear[level] + 1) % MAX_TASKS;
-    ml_queue.queue[level][ml_queue.rear[level]] = process;
-    ml_queue.count[level]++;
-    
-    // Signal that a process is ready
-    pthread_cond_signal(&process_ready_cond);
+    if (queue_uses_heap(queue->ordering)) {
+        heap_push(&queue->heap[level], queue_heap_key(process, queue->ordering),
+                  process->enqueue_seq, process);
+    } else {
+        fifo_push(&queue->fifo[level], process);
+    }
+    queue->count[level]++;
 }
 
-// New function to dequeue a process from the multilevel queue
-PCB* dequeue_process(int level) {
+PCB* run_queue_pop(RunQueue* queue, int level) {
     // Check if the queue at this level is empty
-    if (ml_queue.count[level] <= 0) {
+    if (queue->count[level] <= 0) {
         return NULL;
     }
     
-    // Remove the process from the queue
-    PCB* process = ml_queue.queue[level][ml_queue.front[level]];
-    ml_queue.front[level] = (ml_queue.front[level] + 1) % MAX_TASKS;
-    ml_queue.count[level]--;
-    
-    return process;
+    queue->count[level]--;
+    return queue_uses_heap(queue->ordering)
+         ? heap_pop(&queue->heap[level])
+         : fifo_pop(&queue->fifo[level]);
 }
 
-// New function to handle worker threads
-void* thread_worker(void* arg) {
-    ThreadArgs* thread_args = (ThreadArgs*)arg;
-    int thread_id = thread_args->thread_id;
-    
-    printf("Worker thread %d started\n", thread_id);
-    
-    while (1) {
-        pthread_mutex_lock(&thread_mutex);
-        
-        // Wait for a process to be ready
-        while (ml_queue.count[0] <= 0 && ml_queue.count[1] <= 0 && ml_queue.count[2] <= 0) {
-            pthread_cond_wait(&process_ready_cond, &thread_mutex);
-        }
-        
-        // Find a process to run (starting from the highest priority queue)
-        PCB* process = NULL;
-        int level = -1;
-        
-        for (int i = 0; i < MAX_LEVELS; i++) {
-            if (ml_queue.count[i] > 0) {
-                process = dequeue_process(i);
-                level = i;
-                break;
-            }
-        }
-        
-        pthread_mutex_unlock(&thread_mutex);
-        
-        if (process != NULL) {
-            printf("Thread %d is processing task %s (priority level %d)\n", 
-                  thread_id, process->name, level);
-            
-            // Execute the task
-            if (!process->is_minimized) {
-                // This would be where we actually run the process
-                // For now, let's just simulate it
-                sleep(ml_queue.time_quantum[level]);
-            }
-            
-            // Return the process to the queue if it's still active
-            if (process->is_active) {
-                pthread_mutex_lock(&thread_mutex);
-                enqueue_process(process);
-                pthread_mutex_unlock(&thread_mutex);
-            }
-        }
+static DequeArray* deque_array_new(long capacity) {
+    DequeArray* array = malloc(sizeof(DequeArray));
+    if (array != NULL) {
+        array->slots = malloc(capacity * sizeof(PCB*));
     }
-    
-    return NULL;
+    if (array == NULL || array->slots == NULL) {
+        perror("Failed to allocate run queue");
+        exit(EXIT_FAILURE);
+    }
+    array->capacity = capacity;
+    array->retired = NULL;
+    return array;
 }
 
-// New function to create worker threads
-void create_worker_threads() {
-    for (int i = 0; i < MAX_THREADS; i++) {
-        thread_args[i].thread_id = i;
-        thread_args[i].task_id = -1;
-        
-        if (pthread_create(&worker_threads[i], NULL, thread_worker, &thread_args[i]) != 0) {
-            perror("Failed to create worker thread");
-        } else {
-            thread_active[i] = 1;
-        }
+void deque_init(WorkStealingDeque* deque) {
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->array = deque_array_new(32);
+}
+
+void deque_free(WorkStealingDeque* deque) {
+    DequeArray* array = deque->array;
+    while (array != NULL) {
+        DequeArray* retired = array->retired;
+        free(array->slots);
+        free(array);
+        array = retired;
     }
+    deque->array = NULL;
+    deque->top = 0;
+    deque->bottom = 0;
 }
 
-// New function to clean up worker threads
-void cleanup_worker_threads() {
-    for (int i = 0; i < MAX_THREADS; i++) {
-        if (thread_active[i]) {
-            pthread_cancel(worker_threads[i]);
-            pthread_join(worker_threads[i], NULL);
-            thread_active[i] = 0;
+long deque_size(WorkStealingDeque* deque) {
+    long size = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) -
+                __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    return size > 0 ? size : 0;
+}
+
+// Owner only: push at the bottom
+void deque_push(WorkStealingDeque* deque, PCB* process) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    DequeArray* array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+    
+    if (bottom - top > array->capacity - 1) {
+        // Full: copy the live range into an array twice the size
+        DequeArray* grown = deque_array_new(array->capacity * 2);
+        for (long i = top; i < bottom; i++) {
+            grown->slots[i & (grown->capacity - 1)] =
+                __atomic_load_n(&array->slots[i & (array->capacity - 1)], __ATOMIC_RELAXED);
         }
+        grown->retired = array;
+        __atomic_store_n(&deque->array, grown, __ATOMIC_RELEASE);
+        array = grown;
     }
+    
+    __atomic_store_n(&array->slots[bottom & (array->capacity - 1)], process, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
 }
 
-// Replace launch_task with a version that uses exec
-void launch_task_with_exec(int task_id) {
-    // Check if the application is already running
-    if (is_application_running(available_tasks[task_id].name)) {
-        // If it's already running but minimized, we can resume it
-        for (int i = 0; i < MAX_TASKS; i++) {
-            if (process_table[i].is_active && 
-                strcmp(process_table[i].name, available_tasks[task_id].name) == 0 &&
-                process_table[i].is_minimized) {
-                printf("Resuming %s...\n", available_tasks[task_id].name);
-                resume_process(i);
-                return;
+// Owner only: pop at the bottom
+PCB* deque_pop(WorkStealingDeque* deque) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    DequeArray* array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+    
+    PCB* process = NULL;
+    if (top <= bottom) {
+        process = __atomic_load_n(&array->slots[bottom & (array->capacity - 1)], __ATOMIC_RELAXED);
+        if (top == bottom) {
+            // Last entry: race the thieves for it
+            if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                process = NULL;
             }
+            __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
         }
-        
-        // If it's active and not minimized, we can't start another instance
-        printf("ERROR: %s is already running!\n", available_tasks[task_id].name);
-        sleep(2);
-        return;
-    }
-    
-    // Check if we have available slots
-    if (process_count >= MAX_TASKS) {
-        printf("ERROR: Maximum number of processes reached!\n");
-        sleep(2);
-        return;
+    } else {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
     }
     
-    int ram_required = available_tasks[task_id].ram_required;
-    int hdd_required = available_tasks[task_id].hdd_required;
+    return process;
+}
+
+// Any thread: take the entry at the top, NULL if empty or another thief won
+PCB* deque_steal(WorkStealingDeque* deque) {
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
     
-    // Try to allocate resources
-    if (!allocate_resources(ram_required, hdd_required)) {
-        printf("ERROR: Not enough system resources to start %s!\n", 
-               available_tasks[task_id].name);
-        sleep(2);
-        return;
+    if (top >= bottom) {
+        return NULL;
     }
     
-    // Check if the task is executable
-    if (access(available_tasks[task_id].path, X_OK) != 0) {
-        printf("ERROR: %s is not executable!\n", available_tasks[task_id].name);
-        // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sleep(2);
-        return;
+    DequeArray* array = __atomic_load_n(&deque->array, __ATOMIC_ACQUIRE);
+    PCB* process = __atomic_load_n(&array->slots[top & (array->capacity - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
     }
-    
-    // Reserve a slot in the process table
-    int index = -1;
-    if (sem_wait(process_semaphore) < 0) {
-        perror("sem_wait failed");
-        // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sleep(2);
-        return;
+    return process;
+}
+
+// Lock-free push onto a core's mailbox
+static void inject_process(PCB** stack, PCB* process) {
+    PCB* head = __atomic_load_n(stack, __ATOMIC_RELAXED);
+    do {
+        process->inject_next = head;
+    } while (!__atomic_compare_exchange_n(stack, &head, process, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Take everything off a mailbox, oldest first
+static PCB* take_injected_processes(PCB** stack) {
+    if (__atomic_load_n(stack, __ATOMIC_RELAXED) == NULL) {
+        return NULL;
     }
     
-    // Find an empty slot
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (!process_table[i].is_active) {
-            index = i;
+    PCB* list = __atomic_exchange_n(stack, NULL, __ATOMIC_ACQUIRE);
+    PCB* ordered = NULL;
+    while (list != NULL) {
+        PCB* next = list->inject_next;
+        list->inject_next = ordered;
+        ordered = list;
+        list = next;
+    }
+    return ordered;
+}
+
+// Wake the parked workers, if any; the lock is only taken when someone sleeps.
+// Queued work belongs to one core, so all of them check their own queues.
+static void wake_idle_workers() {
+    if (__atomic_load_n(&idle_workers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&thread_mutex);
+        pthread_cond_broadcast(&process_ready_cond);
+        pthread_mutex_unlock(&thread_mutex);
+    }
+}
+
+// New function to enqueue a process in the multilevel queue
+// Lock-free, callable from any thread; the process goes to the least loaded core
+void enqueue_process(PCB* process) {
+    // A slot that is reused while its old entry is still queued keeps that entry
+    if (__atomic_exchange_n(&process->is_queued, 1, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    
+    process->enqueue_seq = (unsigned long)monotonic_ns();
+    process->queue_level = queue_level_for(process);
+    metric_add(METRIC_ENQUEUES, 1);
+    metric_level_move(-1, process->queue_level);
+    int core = select_core(process);
+    trace_event(TRACE_ENQUEUE, process->pid, process->queue_level, core);
+    queue_on_core(process, core);
+    
+    // Signal that a process is ready
+    wake_idle_workers();
+}
+
+// Put a preempted process back on the worker's own mailbox, so requeueing
+// does not contend with other workers
+void requeue_process(int worker_id, PCB* process) {
+    __atomic_store_n(&process->is_queued, 1, __ATOMIC_RELEASE);
+    process->enqueue_seq = (unsigned long)monotonic_ns();
+    process->queue_level = queue_level_for(process);
+    metric_add(METRIC_ENQUEUES, 1);
+    metric_level_move(-1, process->queue_level);
+    trace_event(TRACE_ENQUEUE, process->pid, process->queue_level, worker_id);
+    queue_on_core(process, worker_id);
+}
+
+// Sort the worker's mailbox into its deque
+static void refill_worker_queue(WorkerQueue* self) {
+    PCB* list = take_injected_processes(&self->mailbox);
+    if (list == NULL) {
+        return;
+    }
+    
+    RunQueue* sorter = &self->sorter;
+    sorter->ordering = current_scheduler;
+    int batch_size = 0;
+    while (list != NULL) {
+        PCB* next = list->inject_next;
+        run_queue_push(sorter, list);
+        batch_size++;
+        list = next;
+    }
+    
+    if (batch_size > self->batch_capacity) {
+        PCB** grown = realloc(self->batch, batch_size * sizeof(PCB*));
+        if (grown == NULL) {
+            perror("Failed to grow dispatch batch");
+            exit(EXIT_FAILURE);
+        }
+        self->batch = grown;
+        self->batch_capacity = batch_size;
+    }
+    
+    int sorted = 0;
+    int level;
+    PCB* process;
+    while ((process = select_next_process(sorter, &level)) != NULL) {
+        self->batch[sorted++] = process;
+    }
+    
+    // Push the worst entry first: the owner pops the best one, thieves take the worst
+    for (int i = sorted - 1; i >= 0; i--) {
+        deque_push(&self->deque, self->batch[i]);
+    }
+}
+
+static PCB* steal_process(int worker_id) {
+    WorkerQueue* self = &worker_queues[worker_id];
+    if (!work_stealing) {
+        return NULL;
+    }
+    int start = (int)(next_random(&self->random_state) % (unsigned long)num_worker_queues);
+    
+    for (int i = 0; i < num_worker_queues; i++) {
+        int victim = (start + i) % num_worker_queues;
+        if (victim == worker_id) {
+            continue;
+        }
+        PCB* process = deque_steal(&worker_queues[victim].deque);
+        if (process != NULL) {
+            self->steals++;
+            return process;
+        }
+    }
+    return NULL;
+}
+
+// New function to dequeue the next process for a worker: its own deque
+// first, then a sorted batch from its mailbox, then a steal
+PCB* dequeue_process(int worker_id) {
+    WorkerQueue* self = &worker_queues[worker_id];
+    
+    // After a scheduler change, queued work is re-sorted by the next refill
+    unsigned long epoch = __atomic_load_n(&scheduler_epoch, __ATOMIC_ACQUIRE);
+    if (self->scheduler_epoch != epoch) {
+        self->scheduler_epoch = epoch;
+        PCB* stale;
+        while ((stale = deque_pop(&self->deque)) != NULL) {
+            int old_level = stale->queue_level;
+            stale->queue_level = queue_level_for(stale);
+            metric_level_move(old_level, stale->queue_level);
+            inject_process(&self->mailbox, stale);
+        }
+    }
+    
+    PCB* process = deque_pop(&self->deque);
+    if (process == NULL) {
+        refill_worker_queue(self);
+        process = deque_pop(&self->deque);
+    }
+    if (process == NULL) {
+        process = steal_process(worker_id);
+    }
+    
+    if (process != NULL) {
+        // Stolen processes leave the victim's queue and now belong to this core
+        __atomic_sub_fetch(&worker_queues[process->core].queued, 1, __ATOMIC_RELAXED);
+        process->core = worker_id;
+        metric_add(METRIC_DEQUEUES, 1);
+        metric_level_move(process->queue_level, -1);
+        trace_event(TRACE_DEQUEUE, process->pid, process->queue_level, worker_id);
+        __atomic_store_n(&process->is_queued, 0, __ATOMIC_RELEASE);
+    }
+    return process;
+}
+
+// Level a process is queued at: its feedback level under MLFQ, otherwise
+// fixed by its priority
+int queue_level_for(PCB* process) {
+    if (current_scheduler == SCHEDULER_MLFQ) {
+        return process->mlfq_level;
+    }
+    return priority_to_level(process->priority);
+}
+
+// Map a task priority onto a multilevel queue level
+int priority_to_level(int priority) {
+    if (priority >= 3) {
+        return 0; // High priority
+    } else if (priority >= 1) {
+        return 1; // Medium priority
+    }
+    return 2; // Low priority
+}
+
+// A process can only be gated if it is a live child of ours
+int is_schedulable(PCB* process) {
+    return process->is_active && !process->is_minimized &&
+           process->pid > 0 && process->pid != getpid();
+}
+
+// Pick the next process of a run queue according to its ordering
+PCB* select_next_process(RunQueue* queue, int* level_out) {
+    int best_level = -1;
+    long long best_key = 0;
+    unsigned long best_seq = 0;
+    
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        if (queue->count[level] <= 0) {
+            continue;
+        }
+        
+        // Levels are already ordered by priority
+        if (queue->ordering == SCHEDULER_PRIORITY || queue->ordering == SCHEDULER_MLFQ) {
+            best_level = level;
+            break;
+        }
+        
+        // Otherwise compare the heads of the levels: estimated burst for SJF,
+        // arrival order for FCFS and RR
+        long long key = 0;
+        unsigned long seq;
+        if (queue_uses_heap(queue->ordering)) {
+            key = queue->heap[level].entries[0].key;
+            seq = queue->heap[level].entries[0].seq;
+        } else {
+            Fifo* fifo = &queue->fifo[level];
+            seq = ((PCB*)fifo->items[fifo->head])->enqueue_seq;
+        }
+        
+        if (best_level == -1 || key < best_key || (key == best_key && seq < best_seq)) {
+            best_level = level;
+            best_key = key;
+            best_seq = seq;
+        }
+    }
+    
+    if (best_level == -1) {
+        return NULL;
+    }
+    
+    *level_out = best_level;
+    return run_queue_pop(queue, best_level);
+}
+
+void sleep_ms(int ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+// Cosmetic pause so the user can read a message; skipped in batch mode
+void ui_delay(int ms) {
+    if (!batch_mode) {
+        sleep_ms(ms);
+    }
+}
+
+long long monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Step of the benchmark sweeps: doubles n, but always finishes with max
+int next_thread_count(int n, int max) {
+    return n < max && n * 2 > max ? max : n * 2;
+}
+
+// FCFS and SJF are non-preemptive: a process keeps the CPU until it exits
+int scheduler_is_preemptive(SchedulerType scheduler) {
+    return scheduler == SCHEDULER_RR || scheduler == SCHEDULER_PRIORITY ||
+           scheduler == SCHEDULER_MLFQ;
+}
+
+// Let a process run on a CPU slot for as long as the scheduler allows
+// Returns the number of quantum units it held the slot for
+int dispatch_process(PCB* process, int level) {
+    pid_t pid = process->pid;
+    int elapsed_units = 0;
+    
+    signal_task(pid, SIGCONT);
+    
+    while (process->is_active && !process->is_minimized && process->pid == pid &&
+           __atomic_load_n(&workers_running, __ATOMIC_ACQUIRE)) {
+        if (scheduler_is_preemptive(current_scheduler) &&
+            elapsed_units >= ml_queue.time_quantum[level]) {
+            break;
+        }
+        
+        sleep_ms(QUANTUM_UNIT_MS);
+        elapsed_units++;
+    }
+    
+    return elapsed_units;
+}
+
+// A CPU slot is needed before a worker may take a process off the queues
+static int acquire_cpu_slot() {
+    int used = __atomic_load_n(&dispatched_count, __ATOMIC_RELAXED);
+    while (used < hardware.cpu_cores) {
+        if (__atomic_compare_exchange_n(&dispatched_count, &used, used + 1, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void release_cpu_slot() {
+    __atomic_sub_fetch(&dispatched_count, 1, __ATOMIC_SEQ_CST);
+}
+
+// Work for one core: its own mailbox, or any deque it could take from
+static int work_available(int worker_id) {
+    if (__atomic_load_n(&dispatched_count, __ATOMIC_SEQ_CST) >= hardware.cpu_cores) {
+        return 0;
+    }
+    if (__atomic_load_n(&worker_queues[worker_id].mailbox, __ATOMIC_SEQ_CST) != NULL ||
+        deque_size(&worker_queues[worker_id].deque) > 0) {
+        return 1;
+    }
+    for (int w = 0; work_stealing && w < num_worker_queues; w++) {
+        if (deque_size(&worker_queues[w].deque) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int queued_processes() {
+    int queued = 0;
+    for (int w = 0; w < num_worker_queues; w++) {
+        queued += __atomic_load_n(&worker_queues[w].queued, __ATOMIC_RELAXED);
+    }
+    return queued;
+}
+
+// Sleep until a process is queued, a CPU slot is released or the pool
+// stops. Every one of those wakes the parked workers, and idle_workers is
+// raised before work is checked, so no wake-up is lost. Only the balancer
+// (while something is queued) and a worker that may retire need a timeout.
+static void park_worker(int worker_id) {
+    int timeout_ms = queued_processes() > 0 ? balance_interval_ms
+                   : worker_id >= resident_workers ? WORKER_IDLE_MS : -1;
+    
+    pthread_mutex_lock(&thread_mutex);
+    __atomic_add_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+    
+    if (__atomic_load_n(&workers_running, __ATOMIC_ACQUIRE) && !work_available(worker_id)) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&process_ready_cond, &thread_mutex);
+        } else {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += timeout_ms / 1000;
+            deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&process_ready_cond, &thread_mutex, &deadline);
+        }
+    }
+    
+    __atomic_sub_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&thread_mutex);
+}
+
+// Start the worker of a core unless it has one; callable from any thread.
+// Pairs with retire_worker: queue first, then check the worker.
+static void start_worker(int core) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int none = 0;
+    if (!__atomic_load_n(&workers_running, __ATOMIC_ACQUIRE) ||
+        __atomic_load_n(&worker_live[core], __ATOMIC_SEQ_CST) ||
+        !__atomic_compare_exchange_n(&worker_live[core], &none, 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+    
+    pthread_mutex_lock(&pool_mutex);
+    // The core's retired worker may still be on its way out
+    if (thread_active[core]) {
+        pthread_join(worker_threads[core], NULL);
+        thread_active[core] = 0;
+    }
+    int started = 0;
+    if (__atomic_load_n(&workers_running, __ATOMIC_ACQUIRE)) {
+        thread_args[core].thread_id = core;
+        thread_args[core].task_id = -1;
+        if (pthread_create(&worker_threads[core], NULL, thread_worker, &thread_args[core]) != 0) {
+            perror("Failed to create worker thread");
+        } else {
+            thread_active[core] = 1;
+            workers_started++;
+            started = 1;
+        }
+    }
+    if (!started) {
+        __atomic_store_n(&worker_live[core], 0, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+// An idle worker gives up its core. Work queued meanwhile may have seen
+// it as live; it takes that back unless another worker was started.
+// Returns 1 if the worker should exit.
+static int retire_worker(int worker_id) {
+    __atomic_store_n(&worker_live[worker_id], 0, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&worker_queues[worker_id].mailbox, __ATOMIC_SEQ_CST) == NULL &&
+        deque_size(&worker_queues[worker_id].deque) == 0) {
+        __atomic_add_fetch(&workers_retired, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    int none = 0;
+    if (__atomic_compare_exchange_n(&worker_live[worker_id], &none, 1, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return 0;
+    }
+    __atomic_add_fetch(&workers_retired, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// New function to handle worker threads
+void* thread_worker(void* arg) {
+    ThreadArgs* thread_args = (ThreadArgs*)arg;
+    int thread_id = thread_args->thread_id;
+    WorkerQueue* core = &worker_queues[thread_id];
+    char trace_name[16];
+    snprintf(trace_name, sizeof(trace_name), "core %d", thread_id);
+    trace_attach_core(thread_id, trace_name);
+    long long idle_since = monotonic_ns();
+    
+    while (__atomic_load_n(&workers_running, __ATOMIC_ACQUIRE)) {
+        if (current_scheduler == SCHEDULER_MLFQ) {
+            mlfq_boost_if_due();
+        }
+        balance_cores_if_due();
+        
+        if (!acquire_cpu_slot()) {
+            park_worker(thread_id);
+            continue;
+        }
+        
+        PCB* process = dequeue_process(thread_id);
+        if (process == NULL) {
+            release_cpu_slot();
+            if (thread_id >= resident_workers &&
+                monotonic_ns() - idle_since >= WORKER_IDLE_MS * 1000000LL && retire_worker(thread_id)) {
+                break;
+            }
+            park_worker(thread_id);
+            continue;
+        }
+        
+        // Processes that exited or were minimized while queued are dropped here
+        if (!is_schedulable(process)) {
+            release_cpu_slot();
+            continue;
+        }
+        
+        pid_t pid = process->pid;
+        int level = process->queue_level;
+        long long waited_ns = monotonic_ns() - (long long)process->enqueue_seq;
+        process->is_dispatched = 1;
+        process->dispatch_count++;
+        metric_add(METRIC_DISPATCHES, 1);
+        metric_observe(HISTOGRAM_DISPATCH_LATENCY, waited_ns);
+        long long slot_start = monotonic_ns();
+        
+        // Move the child to the host CPU behind this core
+        record_core_dispatch(thread_id, process);
+        if (process->pinned_cpu != core->host_cpu) {
+            pin_process(process, core->host_cpu);
+        }
+        
+        long cpu_before = read_process_cpu_ms(pid);
+        int elapsed_units = dispatch_process(process, level);
+        long cpu_used = read_process_cpu_ms(pid) - cpu_before;
+        
+        process->is_dispatched = 0;
+        __atomic_store_n(&core->running, 0, __ATOMIC_RELAXED);
+        metric_observe(HISTOGRAM_SLOT_TIME, monotonic_ns() - slot_start);
+        trace_span(TRACE_DISPATCH, slot_start, pid, thread_id, (int)(waited_ns / 1000));
+        update_burst_estimate(process, cpu_before < 0 ? -1 : cpu_used);
+        
+        if (current_scheduler == SCHEDULER_MLFQ) {
+            mlfq_account_slot(process, level, elapsed_units, cpu_before < 0 ? -1 : cpu_used, waited_ns);
+        }
+        
+        // Preempted: stop the process and put it back in the ready queue
+        if (is_schedulable(process) && process->pid == pid) {
+            signal_task(pid, SIGSTOP);
+            metric_add(METRIC_PREEMPTIONS, 1);
+            trace_event(TRACE_PREEMPT, pid, thread_id, 0);
+            requeue_process(thread_id, process);
+        }
+        
+        // A CPU slot was released
+        release_cpu_slot();
+        wake_idle_workers();
+        idle_since = monotonic_ns();
+    }
+    
+    return NULL;
+}
+
+// New function to create worker threads: one per simulated core, started
+// right away for as many cores as the host has CPUs and on demand beyond
+void create_worker_threads() {
+    num_worker_queues = hardware.cpu_cores < 1 ? 1
+                      : hardware.cpu_cores > MAX_WORKER_QUEUES ? MAX_WORKER_QUEUES : hardware.cpu_cores;
+    int host_cpus = assign_host_cpus();
+    resident_workers = host_cpus < 1 ? 1 : host_cpus < num_worker_queues ? host_cpus : num_worker_queues;
+    
+    __atomic_store_n(&workers_running, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < resident_workers; i++) {
+        start_worker(i);
+    }
+}
+
+// New function to clean up worker threads. Workers finish their quantum
+// unit and exit on their own; tasks still queued are terminated afterwards,
+// since without a worker they would stay stopped forever.
+void cleanup_worker_threads() {
+    if (!__atomic_exchange_n(&workers_running, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    
+    pthread_mutex_lock(&thread_mutex);
+    pthread_cond_broadcast(&process_ready_cond);
+    pthread_mutex_unlock(&thread_mutex);
+    
+    // A worker may itself be starting another one, so never join under pool_mutex
+    for (int i = 0; i < MAX_WORKER_QUEUES; i++) {
+        pthread_mutex_lock(&pool_mutex);
+        int joinable = thread_active[i];
+        pthread_t thread = worker_threads[i];
+        thread_active[i] = 0;
+        pthread_mutex_unlock(&pool_mutex);
+        
+        if (joinable) {
+            pthread_join(thread, NULL);
+        }
+        __atomic_store_n(&worker_live[i], 0, __ATOMIC_RELAXED);
+    }
+    
+    int* stranded = malloc((process_table_used + 1) * sizeof(int));
+    int count = 0;
+    for (int w = 0; w < num_worker_queues; w++) {
+        PCB* process;
+        while ((process = dequeue_process(w)) != NULL) {
+            if (stranded != NULL && is_schedulable(process)) {
+                stranded[count++] = (int)(process - process_table);
+            }
+        }
+    }
+    if (count > 0) {
+        terminate_processes(stranded, count);
+    }
+    free(stranded);
+}
+
+// ##########################################
+// CPU CORES AND LOAD BALANCING
+// ##########################################
+// Every simulated core has its own run queue and worker. New processes go
+// to the least loaded core, preempted ones stay on theirs, idle cores steal
+// from busy ones and a periodic balancer moves queued processes from the
+// busiest to the idlest core. Children are pinned to the host CPU behind
+// the core that dispatches them.
+
+// Map the simulated cores onto the host CPUs we may run on, round robin.
+// Returns the number of those CPUs.
+int assign_host_cpus() {
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE];
+    int count = 0;
+    
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus[count++] = cpu;
+            }
+        }
+    }
+    
+    for (int w = 0; w < num_worker_queues; w++) {
+        worker_queues[w].host_cpu = count > 0 ? cpus[w % count] : -1;
+    }
+    return count;
+}
+
+// Processes waiting for or holding a core
+int core_load(int core) {
+    return __atomic_load_n(&worker_queues[core].queued, __ATOMIC_RELAXED) +
+           __atomic_load_n(&worker_queues[core].running, __ATOMIC_RELAXED);
+}
+
+// Load difference between the busiest and the idlest core
+int core_imbalance(int* busiest, int* idlest) {
+    int max_load = -1;
+    int min_load = INT_MAX;
+    
+    for (int w = 0; w < num_worker_queues; w++) {
+        int load = core_load(w);
+        if (load > max_load) {
+            max_load = load;
+            *busiest = w;
+        }
+        if (load < min_load) {
+            min_load = load;
+            *idlest = w;
+        }
+    }
+    return max_load - min_load;
+}
+
+// Least loaded core; the one the process ran on last wins ties, since its
+// cache may still hold the process
+int select_core(PCB* process) {
+    int best = process->last_core >= 0 && process->last_core < num_worker_queues ? process->last_core : 0;
+    int best_load = core_load(best);
+    
+    for (int w = 0; w < num_worker_queues && best_load > 0; w++) {
+        int load = core_load(w);
+        if (load < best_load) {
+            best = w;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+// Hand a process to a core's mailbox, starting the core's worker if needed
+void queue_on_core(PCB* process, int core) {
+    process->core = core;
+    __atomic_add_fetch(&worker_queues[core].queued, 1, __ATOMIC_RELAXED);
+    inject_process(&worker_queues[core].mailbox, process);
+    start_worker(core);
+}
+
+// A core starts running a process; counts it as cache-warm if the process
+// ran on the same core last time
+void record_core_dispatch(int core, PCB* process) {
+    WorkerQueue* queue = &worker_queues[core];
+    queue->dispatches++;
+    if (process->last_core >= 0) {
+        queue->redispatches++;
+    }
+    if (process->last_core == core) {
+        queue->warm_dispatches++;
+    }
+    process->last_core = core;
+    __atomic_store_n(&queue->running, 1, __ATOMIC_RELAXED);
+}
+
+static void migrate_process(PCB* process, int from, int to) {
+    __atomic_sub_fetch(&worker_queues[from].queued, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&worker_queues[to].migrations, 1, __ATOMIC_RELAXED);
+    queue_on_core(process, to);
+}
+
+// Move half the load difference from the busiest to the idlest core.
+// The worst-ordered entries of the busiest deque go first; if that is not
+// enough the rest comes out of its mailbox. Returns the number moved.
+int balance_cores() {
+    int busiest = 0;
+    int idlest = 0;
+    int imbalance = core_imbalance(&busiest, &idlest);
+    
+    balance_stats.runs++;
+    balance_stats.imbalance = imbalance;
+    if (imbalance > balance_stats.max_imbalance) {
+        balance_stats.max_imbalance = imbalance;
+    }
+    if (imbalance < 2) {
+        return 0;
+    }
+    
+    WorkerQueue* from = &worker_queues[busiest];
+    int wanted = imbalance / 2;
+    int moved = 0;
+    
+    while (moved < wanted) {
+        PCB* process = deque_steal(&from->deque);
+        if (process == NULL) {
+            break;
+        }
+        migrate_process(process, busiest, idlest);
+        moved++;
+    }
+    
+    if (moved < wanted) {
+        PCB* list = take_injected_processes(&from->mailbox);
+        while (list != NULL) {
+            PCB* next = list->inject_next;
+            if (moved < wanted) {
+                migrate_process(list, busiest, idlest);
+                moved++;
+            } else {
+                inject_process(&from->mailbox, list);
+            }
+            list = next;
+        }
+    }
+    
+    balance_stats.migrations += moved;
+    if (moved > 0) {
+        wake_idle_workers();
+    }
+    return moved;
+}
+
+// Run the balancer from whichever worker notices it is due
+void balance_cores_if_due() {
+    if (!load_balancing || num_worker_queues < 2) {
+        return;
+    }
+    
+    long long now = monotonic_ns();
+    long long last = __atomic_load_n(&last_balance_ns, __ATOMIC_RELAXED);
+    if (now - last < (long long)balance_interval_ms * 1000000LL ||
+        !__atomic_compare_exchange_n(&last_balance_ns, &last, now, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return;
+    }
+    balance_cores();
+}
+
+// Pin a process and everything it started, e.g. the bc of Calculator.
+// Descendants are found through /proc/<pid>/task/<pid>/children.
+static int pin_process_tree(pid_t pid, const cpu_set_t* set, int depth) {
+    if (sched_setaffinity(pid, sizeof(*set), set) == -1) {
+        return -1;
+    }
+    if (depth >= 8) {
+        return 0;
+    }
+    
+    char path[64];
+    char children[512];
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", (int)pid, (int)pid);
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return 0;
+    }
+    ssize_t length = read(fd, children, sizeof(children) - 1);
+    close(fd);
+    if (length <= 0) {
+        return 0;
+    }
+    children[length] = '\0';
+    
+    char* cursor = children;
+    char* end;
+    for (long child = strtol(cursor, &end, 10); end != cursor; child = strtol(cursor, &end, 10)) {
+        pin_process_tree((pid_t)child, set, depth + 1); // It may have exited meanwhile
+        cursor = end;
+    }
+    return 0;
+}
+
+// Pin a task to one host CPU. The task is stopped here, so the processes
+// it starts later inherit the mask; the ones it already started are
+// moved along with it.
+void pin_process(PCB* process, int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pin_process_tree(process->pid, &set, 0) == 0) {
+        process->pinned_cpu = cpu;
+    }
+}
+
+// Per-core queue lengths and dispatch statistics (batch "cores" command)
+void print_core_stats() {
+    unsigned long redispatches = 0;
+    unsigned long warm = 0;
+    
+    printf("%-5s %5s %8s %7s %11s %7s %7s %9s\n", "CORE", "CPU", "RUNNING", "QUEUED",
+           "DISPATCHES", "WARM", "STOLEN", "MIGRATED");
+    for (int w = 0; w < num_worker_queues; w++) {
+        WorkerQueue* core = &worker_queues[w];
+        redispatches += core->redispatches;
+        warm += core->warm_dispatches;
+        printf("%-5d %5d %8s %7d %11lu %6.1f%% %7lu %9lu\n", w, core->host_cpu,
+               core->running ? "yes" : "no", core->queued, core->dispatches,
+               core->redispatches > 0 ? 100.0 * core->warm_dispatches / core->redispatches : 100.0,
+               core->steals, core->migrations);
+    }
+    printf("Load balancer: %lu runs, %lu migrations, imbalance %d (max %d), affinity retention %.1f%%\n",
+           balance_stats.runs, balance_stats.migrations, balance_stats.imbalance,
+           balance_stats.max_imbalance, redispatches > 0 ? 100.0 * warm / redispatches : 100.0);
+    int live = 0;
+    for (int w = 0; w < num_worker_queues; w++) {
+        live += __atomic_load_n(&worker_live[w], __ATOMIC_RELAXED);
+    }
+    printf("Worker pool: %d of %d cores have a worker (%d resident), %lu started, %lu retired\n",
+           live, num_worker_queues, resident_workers, workers_started,
+           __atomic_load_n(&workers_retired, __ATOMIC_RELAXED));
+}
+
+void launch_task(int task_id) {
+    // Check if the application is already running
+    if (is_application_running(available_tasks[task_id].name)) {
+        // If it's already running but minimized, we can resume it
+        int minimized = find_process_by_name(available_tasks[task_id].name, 1);
+        if (minimized >= 0) {
+            printf("Resuming %s...\n", available_tasks[task_id].name);
+            resume_process(minimized);
+            return;
+        }
+        
+        // If it's active and not minimized, we can't start another instance
+        printf("ERROR: %s is already running!\n", available_tasks[task_id].name);
+        ui_delay(2000);
+        return;
+    }
+    
+    // Check if we have available slots
+    if (process_count >= max_tasks) {
+        printf("ERROR: Maximum number of processes reached!\n");
+        ui_delay(2000);
+        return;
+    }
+    
+    int ram_required = available_tasks[task_id].ram_required;
+    int hdd_required = available_tasks[task_id].hdd_required;
+    
+    // Try to allocate resources
+    ResourceReservation reservation;
+    if (!reserve_resources(&reservation, ram_required, hdd_required)) {
+        metric_add(METRIC_ADMISSION_REJECTIONS, 1);
+        printf("ERROR: Not enough system resources to start %s!\n", 
+               available_tasks[task_id].name);
+        ui_delay(2000);
+        return;
+    }
+    
+    // Check if the task is executable
+    if (access(available_tasks[task_id].path, X_OK) != 0) {
+        printf("ERROR: %s is not executable!\n", available_tasks[task_id].name);
+        // Return the resources
+        release_reservation(&reservation);
+        ui_delay(2000);
+        return;
+    }
+    
+    // Reserve a slot in the process table
+    table_write_lock();
+    
+    // Take a slot from the free list
+    int index = process_table_insert(available_tasks[task_id].name);
+    
+    if (index == -1) {
+        // No empty slot found
+        printf("ERROR: No empty slot in process table!\n");
+        // Return the resources
+        release_reservation(&reservation);
+        table_write_unlock();
+        ui_delay(2000);
+        return;
+    }
+    
+    // The initial grant must pass the deadlock check like any later request
+    if (!admit_task_claim(index, task_id)) {
+        process_table_remove(index);
+        release_reservation(&reservation);
+        table_write_unlock();
+        ui_delay(2000);
+        return;
+    }
+    
+    // Set up information in the process table
+    process_table[index].is_minimized = 0;
+    process_table[index].ram_required = ram_required;
+    process_table[index].reservation = reservation;
+    process_table[index].hdd_required = hdd_required;
+    process_table[index].priority = available_tasks[task_id].priority;
+    process_table[index].start_time = time(NULL);
+    strcpy(process_table[index].task_path, available_tasks[task_id].path);
+    
+    table_write_unlock();
+    
+    // Start the task and give it the screen
+    clear_screen();
+    pid_t pid = start_task(index);
+    
+    if (pid == -1) {
+        // The task could not be started
+        table_write_lock();
+        process_table_remove(index);
+        table_write_unlock();
+        
+        // Free resources allocated to this process
+        free_resources(index);
+        
+        ui_delay(2000);
+        return;
+    }
+    
+    // The supervisor already minimized or released the process
+    int status = foreground_task(&index, pid);
+    report_foreground(index, status);
+    ui_delay(2000);
+    
+    // Clear the screen after the task finishes
+    clear_screen();
+}
+
+// ##########################################
+// TASK LAUNCHER
+// ##########################################
+// Tasks are started with posix_spawn, which glibc implements with
+// clone(CLONE_VM | CLONE_VFORK): no page tables are copied and no shell is
+// involved, unlike fork/execl or system().
+
+// Clear the terminal with ANSI escapes instead of running clear(1)
+void clear_screen() {
+    if (batch_mode) {
+        return;
+    }
+    
+    // Home the cursor, clear the screen and the scrollback
+    fputs("\033[H\033[2J\033[3J", stdout);
+    fflush(stdout);
+}
+
+// Start a task on the pseudo-terminal tty_path, or in the current terminal
+// if it is NULL; returns its PID or -1
+pid_t spawn_task(const char* path, const char* tty_path) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    sigset_t no_signals, all_signals;
+    pid_t pid;
+    
+    posix_spawn_file_actions_init(&actions);
+    if (tty_path != NULL) {
+        // The task stays in our session, so the pseudo-terminal does not
+        // become its controlling terminal
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, tty_path, O_RDWR | O_NOCTTY, 0);
+        posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDERR_FILENO);
+    } else {
+        // The task talks to the same terminal; dup2 onto itself also clears
+        // any close-on-exec flag on the standard descriptors
+        posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, STDERR_FILENO, STDERR_FILENO);
+    }
+    
+    // Start with an empty signal mask and default dispositions, whatever
+    // the launching thread had, as the leader of a new process group
+    sigemptyset(&no_signals);
+    sigfillset(&all_signals);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigmask(&attributes, &no_signals);
+    posix_spawnattr_setsigdefault(&attributes, &all_signals);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF |
+                                          POSIX_SPAWN_SETPGROUP);
+    
+    char* const argv[] = { (char*)path, NULL };
+    int error = posix_spawn(&pid, path, &actions, &attributes, argv, environ);
+    
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    
+    if (error != 0) {
+        fprintf(stderr, "posix_spawn %s failed: %s\n", path, strerror(error));
+        return -1;
+    }
+    return pid;
+}
+
+// Like spawn_task, but the child is created inside the cgroup behind
+// cgroup_fd (clone3 with CLONE_INTO_CGROUP), so it never runs outside its
+// limits. posix_spawn has no such attribute, so this does what it does
+// itself: a CLONE_VM | CLONE_VFORK child on its own small stack that only
+// sets up the terminal and signals and execs, with this thread suspended
+// until then. Nothing of our memory is copied. Returns -1 with errno set
+// if the kernel or architecture does not support it.
+#if defined(__x86_64__)
+typedef struct {
+    const char* path;
+    const char* tty_path;
+    int error;                  // Set by the child if it could not exec
+} CgroupSpawn;
+
+// Runs in the vforked child, on its own stack but in our memory: only
+// async-signal-safe calls, and nothing is freed or locked
+static int cgroup_spawn_child(void* arg) {
+    CgroupSpawn* spawn = arg;
+    char* const argv[] = { (char*)spawn->path, NULL };
+    
+    // The handlers are ours; the child has its own copy of the table
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    for (int sig = 1; sig < NSIG; sig++) {
+        sigaction(sig, &action, NULL);
+    }
+    setpgid(0, 0);
+    if (spawn->tty_path != NULL) {
+        int fd = open(spawn->tty_path, O_RDWR | O_NOCTTY);
+        if (fd == -1) {
+            spawn->error = errno;
+            _exit(127);
+        }
+        dup2(fd, STDIN_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        if (fd > STDERR_FILENO) {
+            close(fd);
+        }
+    } else {
+        for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) {
+            fcntl(fd, F_SETFD, 0);
+        }
+    }
+    sigset_t no_signals;
+    sigemptyset(&no_signals);
+    sigprocmask(SIG_SETMASK, &no_signals, NULL);
+    execve(spawn->path, argv, environ);
+    spawn->error = errno;
+    _exit(127);
+}
+
+// clone3 that runs child(arg) on args->stack in the new process. The C
+// wrapper cannot do that: the child would return into a frame on a stack
+// it does not have.
+static long clone3_child(struct clone_args* args, int (*child)(void*), void* arg) {
+    register long result __asm__("rax") = SYS_clone3;
+    register struct clone_args* args_reg __asm__("rdi") = args;
+    register long size_reg __asm__("rsi") = sizeof(*args);
+    register int (*child_reg)(void*) __asm__("r12") = child;
+    register void* arg_reg __asm__("r13") = arg;
+    __asm__ volatile("syscall\n\t"
+                     "test %%rax, %%rax\n\t"
+                     "jnz 1f\n\t"
+                     "xor %%ebp, %%ebp\n\t"
+                     "mov %%r13, %%rdi\n\t"
+                     "call *%%r12\n\t"
+                     "mov %%eax, %%edi\n\t"
+                     "mov %[exit], %%eax\n\t"
+                     "syscall\n\t"
+                     "1:"
+                     : "+r"(result)
+                     : "r"(args_reg), "r"(size_reg), "r"(child_reg), "r"(arg_reg), [exit] "i"(SYS_exit)
+                     : "rcx", "r11", "memory");
+    return result;
+}
+#endif
+
+pid_t spawn_task_in_cgroup(const char* path, const char* tty_path, int cgroup_fd) {
+#if defined(__x86_64__)
+    // This thread waits for the exec, so its stack can host the child's
+    char stack[32768] __attribute__((aligned(16)));
+    CgroupSpawn spawn = { path, tty_path, 0 };
+    struct clone_args args;
+    memset(&args, 0, sizeof(args));
+    args.flags = CLONE_VM | CLONE_VFORK | CLONE_INTO_CGROUP;
+    args.exit_signal = SIGCHLD;
+    args.stack = (uint64_t)(uintptr_t)stack;
+    args.stack_size = sizeof(stack);
+    args.cgroup = (uint64_t)cgroup_fd;
+    
+    // No handler of ours may run in the child before it resets them
+    sigset_t all_signals, saved;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &saved);
+    long result = clone3_child(&args, cgroup_spawn_child, &spawn);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    
+    if (result < 0) {
+        errno = (int)-result;
+        return -1;
+    }
+    pid_t pid = (pid_t)result;
+    if (spawn.error != 0) {
+        // The child exited without exec; nobody else waits for it
+        while (waitpid(pid, NULL, 0) == -1 && errno == EINTR);
+        fprintf(stderr, "clone3 %s failed: %s\n", path, strerror(spawn.error));
+        errno = spawn.error;
+        return -1;
+    }
+    return pid;
+#else
+    (void)path;
+    (void)tty_path;
+    (void)cgroup_fd;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Start the task of a process table slot on its own pseudo-terminal under
+// the dispatcher; a slot marked minimized stays stopped until it is resumed.
+// Returns its PID, or -1 if it could not be started.
+pid_t start_task(int index) {
+    // Without a pseudo-terminal the task shares ours
+    char tty_path[64];
+    int master_fd = open_console(tty_path, sizeof(tty_path));
+    
+    // A task with a cgroup is created inside it, already under its limits
+    long long spawn_start = monotonic_ns();
+    int cgroup_fd = open_task_cgroup(index);
+    int in_cgroup = 0;
+    pid_t pid = -1;
+    if (cgroup_fd != -1) {
+        pid = spawn_task_in_cgroup(process_table[index].task_path, master_fd != -1 ? tty_path : NULL, cgroup_fd);
+        in_cgroup = pid != -1;
+        close(cgroup_fd);
+    }
+    if (pid == -1) {
+        pid = spawn_task(process_table[index].task_path, master_fd != -1 ? tty_path : NULL);
+    }
+    metric_observe(HISTOGRAM_LAUNCH_LATENCY, monotonic_ns() - spawn_start);
+    if (pid == -1) {
+        printf("ERROR: Failed to execute %s!\n", process_table[index].name);
+        if (master_fd != -1) {
+            close(master_fd);
+        }
+        release_task_limits(index);
+        return -1;
+    }
+    set_console(index, master_fd);
+    
+    // Update the PID in the process table
+    table_write_lock();
+    process_table_set_pid(index, pid);
+    table_write_unlock();
+    
+    printf("Started %s with PID %d\n", process_table[index].name, pid);
+    metric_add(METRIC_LAUNCHES, 1);
+    
+    // Hold the task to its declared memory and core share
+    limit_task_resources(index, pid, in_cgroup);
+    
+    // The supervisor reaps the child whenever it exits
+    supervise_child(index, pid);
+    
+    // Hand the child to the dispatcher; it stays stopped until a worker
+    // gives it a CPU slot
+    signal_task(pid, SIGSTOP);
+    if (!process_table[index].is_minimized) {
+        enqueue_process(&process_table[index]);
+    }
+    return pid;
+}
+
+// ##########################################
+// TASK REGISTRY
+// ##########################################
+// The applications come from a registry file, one per line:
+//     name | path | ram_mb | hdd_gb | priority [| max_ram | max_hdd | max_cores]
+// The file is read into a buffer kept across reloads and parsed there; names
+// and paths are copied into one string pool, identical paths only once. A
+// reload that races an editor may read a torn file: invalid lines are
+// skipped and the write that tore it triggers another reload, and a file
+// with no valid line leaves the old registry in place. An inotify watch on
+// its directory reloads it when it is rewritten or replaced. Running
+// processes keep their own copies of name and path, so a reload never
+// touches them.
+
+// Multiply-xorshift over 8 bytes at a time; a byte-wise hash was most of
+// the load time of large registries. Folding sets bit 5 of every byte, which
+// maps 'A' to 'a' but also merges some punctuation; that only adds
+// collisions, which the strcasecmp behind every probe sorts out.
+static unsigned int registry_hash(const char* text, size_t length, int fold_case) {
+    const uint64_t fold = fold_case ? 0x2020202020202020ULL : 0;
+    uint64_t hash = length * 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < length; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, text + i, length - i < 8 ? length - i : 8);
+        hash = (hash ^ (word | fold)) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+    // A product only carries bits upwards; bring the high ones down to the buckets
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    return (unsigned int)(hash >> 32);
+}
+
+static const char* trim_field(const char* start, const char** end) {
+    while (start < *end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+    while (*end > start && ((*end)[-1] == ' ' || (*end)[-1] == '\t' || (*end)[-1] == '\r')) {
+        (*end)--;
+    }
+    return start;
+}
+
+static int parse_registry_int(const char* start, const char* end, int* value) {
+    long number = 0;
+    if (start == end) {
+        return 0;
+    }
+    for (const char* p = start; p < end; p++) {
+        if (*p < '0' || *p > '9' || number > 100000000L) {
+            return 0;
+        }
+        number = number * 10 + (*p - '0');
+    }
+    *value = (int)number;
+    return 1;
+}
+
+// Append a string to the pool
+static const char* pool_string(char* pool, size_t* used, const char* text, size_t length) {
+    char* copy = pool + *used;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    *used += length + 1;
+    return copy;
+}
+
+// Copy a string into the pool once; interned holds pool offset + 1 per bucket
+static const char* intern_string(char* pool, size_t* used, int* interned, unsigned int mask,
+                                 const char* text, size_t length) {
+    unsigned int bucket = registry_hash(text, length, 0) & mask;
+    while (interned[bucket] != 0) {
+        const char* candidate = pool + interned[bucket] - 1;
+        if (strncmp(candidate, text, length) == 0 && candidate[length] == '\0') {
+            return candidate;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+    
+    interned[bucket] = (int)*used + 1;
+    return pool_string(pool, used, text, length);
+}
+
+// Add a task to the name index; returns 0 if the name is already taken
+static int index_task_name(TaskRegistry* registry, int task_id) {
+    const char* name = registry->tasks[task_id].name;
+    unsigned int bucket = registry_hash(name, strlen(name), 1) & registry->index_mask;
+    while (registry->name_index[bucket] != 0) {
+        if (strcasecmp(registry->tasks[registry->name_index[bucket] - 1].name, name) == 0) {
+            return 0;
+        }
+        bucket = (bucket + 1) & registry->index_mask;
+    }
+    registry->name_index[bucket] = task_id + 1;
+    return 1;
+}
+
+static void free_task_registry(TaskRegistry* registry) {
+    if (registry->tasks != builtin_tasks) {
+        free(registry->tasks);
+    }
+    free(registry->strings);
+    free(registry->name_index);
+    memset(registry, 0, sizeof(*registry));
+}
+
+// Parse one registry line into task; returns an error message or NULL
+static const char* parse_registry_line(const char* line, const char* end, char* pool, size_t* used,
+                                       int* interned, unsigned int mask, Task* task) {
+    const char* fields[8];
+    const char* field_ends[8];
+    int count = 0;
+    
+    while (count < 8) {
+        const char* bar = memchr(line, '|', end - line);
+        const char* field_end = bar != NULL ? bar : end;
+        fields[count] = trim_field(line, &field_end);
+        field_ends[count] = field_end;
+        count++;
+        if (bar == NULL) {
+            break;
+        }
+        line = bar + 1;
+    }
+    if (count != 5 && count != 8) {
+        return "expected 5 or 8 fields separated by '|'";
+    }
+    
+    size_t name_length = field_ends[0] - fields[0];
+    size_t path_length = field_ends[1] - fields[1];
+    if (name_length == 0 || name_length >= TASK_NAME_LENGTH) {
+        return "name is empty or too long";
+    }
+    if (path_length == 0 || path_length >= MAX_PATH_LENGTH) {
+        return "path is empty or too long";
+    }
+    
+    int values[6] = { 0 };
+    for (int f = 2; f < count; f++) {
+        if (!parse_registry_int(fields[f], field_ends[f], &values[f - 2])) {
+            return "resource fields must be non-negative numbers";
+        }
+    }
+    task->ram_required = values[0];
+    task->hdd_required = values[1];
+    task->priority = values[2];
+    task->max_ram = count == 8 ? values[3] : values[0];
+    task->max_hdd = count == 8 ? values[4] : values[1];
+    task->max_cores = count == 8 ? values[5] : 1;
+    if (task->max_ram < task->ram_required || task->max_hdd < task->hdd_required || task->max_cores < 1) {
+        return "maximum claim is below the launch reservation";
+    }
+    
+    // Names are unique, so only paths are worth sharing
+    task->name = pool_string(pool, used, fields[0], name_length);
+    task->path = intern_string(pool, used, interned, mask, fields[1], path_length);
+    return NULL;
+}
+
+// Read and parse a registry file. Returns the number of tasks, or -1 if
+// the file could not be read or holds no valid task. The file is read into
+// a buffer rather than mapped: an editor rewriting it in place while it is
+// mapped would truncate the mapping under us (SIGBUS), while a read just
+// sees a torn file, and the write that tore it triggers another reload.
+// The buffer is kept for the next reload, so only the first one faults
+// its pages in.
+static int load_task_registry(const char* path, TaskRegistry* registry) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        printf("Task registry %s is empty\n", path);
+        return -1;
+    }
+    static char* buffer = NULL;
+    static size_t buffer_size = 0;
+    if ((size_t)st.st_size > buffer_size) {
+        char* grown = realloc(buffer, (size_t)st.st_size);
+        if (grown == NULL) {
+            close(fd);
+            perror("Failed to allocate task registry");
+            return -1;
+        }
+        buffer = grown;
+        buffer_size = (size_t)st.st_size;
+    }
+    char* data = buffer;
+    size_t size = 0;
+    ssize_t length;
+    while (size < (size_t)st.st_size &&
+           (length = read(fd, data + size, (size_t)st.st_size - size)) > 0) {
+        size += (size_t)length;
+    }
+    close(fd);
+    const char* data_end = data + size;
+    
+    // At most one task per line, and no more strings than the file holds
+    int lines = 1;
+    for (const char* p = data; (p = memchr(p, '\n', data_end - p)) != NULL; p++) {
+        lines++;
+    }
+    unsigned int index_size = 16;
+    while (index_size < 4u * (unsigned int)lines) {
+        index_size *= 2;
+    }
+    
+    memset(registry, 0, sizeof(*registry));
+    registry->tasks = malloc(lines * sizeof(Task));
+    registry->strings = malloc(size + 2 * (size_t)lines);
+    registry->name_index = calloc(index_size / 2, sizeof(int));
+    registry->index_mask = index_size / 2 - 1;
+    int* interned = calloc(index_size, sizeof(int));
+    if (registry->tasks == NULL || registry->strings == NULL || registry->name_index == NULL || interned == NULL) {
+        perror("Failed to allocate task registry");
+        free(interned);
+        free_task_registry(registry);
+        return -1;
+    }
+    
+    size_t used = 0;
+    int line_number = 0;
+    for (const char* line = data; line < data_end; ) {
+        const char* newline = memchr(line, '\n', data_end - line);
+        const char* line_end = newline != NULL ? newline : data_end;
+        const char* next = newline != NULL ? newline + 1 : data_end;
+        line_number++;
+        
+        const char* text = trim_field(line, &line_end);
+        line = next;
+        if (text == line_end || *text == '#') {
+            continue;
+        }
+        
+        Task* task = &registry->tasks[registry->count];
+        const char* error = parse_registry_line(text, line_end, registry->strings, &used,
+                                                interned, index_size - 1, task);
+        if (error == NULL && !index_task_name(registry, registry->count)) {
+            error = "name is already registered";
+        }
+        if (error != NULL) {
+            printf("Task registry %s:%d: %s\n", path, line_number, error);
+            continue;
+        }
+        registry->count++;
+    }
+    
+    free(interned);
+    if (registry->count == 0) {
+        printf("Task registry %s has no tasks\n", path);
+        free_task_registry(registry);
+        return -1;
+    }
+    return registry->count;
+}
+
+static void install_task_registry(TaskRegistry* registry) {
+    free_task_registry(&task_registry);
+    task_registry = *registry;
+    available_tasks = task_registry.tasks;
+    num_available_tasks = task_registry.count;
+}
+
+// Load the registry file; without one the built-in applications are used.
+// Returns -1 only if a registry given with --registry cannot be loaded.
+int init_task_registry() {
+    TaskRegistry registry;
+    if (load_task_registry(registry_path, &registry) > 0) {
+        install_task_registry(&registry);
+        return 0;
+    }
+    if (registry_path_given) {
+        if (errno == ENOENT) {
+            printf("Task registry %s does not exist\n", registry_path);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Application by case-insensitive name, -1 if it is not registered
+int find_registered_task(const char* name) {
+    if (task_registry.name_index == NULL) {
+        for (int i = 0; i < num_available_tasks; i++) {
+            if (strcasecmp(available_tasks[i].name, name) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    
+    unsigned int bucket = registry_hash(name, strlen(name), 1) & task_registry.index_mask;
+    while (task_registry.name_index[bucket] != 0) {
+        int task_id = task_registry.name_index[bucket] - 1;
+        if (strcasecmp(available_tasks[task_id].name, name) == 0) {
+            return task_id;
+        }
+        bucket = (bucket + 1) & task_registry.index_mask;
+    }
+    return -1;
+}
+
+// Watch the registry's directory, so a file replaced by rename is seen too
+void watch_task_registry() {
+    char directory[MAX_PATH_LENGTH * 3];
+    snprintf(directory, sizeof(directory), "%s", registry_path);
+    char* slash = strrchr(directory, '/');
+    if (slash == directory) {
+        slash[1] = '\0';
+    } else if (slash != NULL) {
+        *slash = '\0';
+    } else {
+        strcpy(directory, ".");
+    }
+    
+    registry_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (registry_watch_fd < 0) {
+        perror("inotify_init1");
+        return;
+    }
+    if (inotify_add_watch(registry_watch_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror(directory);
+        close(registry_watch_fd);
+        registry_watch_fd = -1;
+    }
+}
+
+// Apply a changed registry file; called by the main thread between commands
+void reload_task_registry_if_changed() {
+    if (registry_watch_fd < 0) {
+        return;
+    }
+    
+    const char* slash = strrchr(registry_path, '/');
+    const char* file_name = slash != NULL ? slash + 1 : registry_path;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t length;
+    while ((length = read(registry_watch_fd, events, sizeof(events))) > 0) {
+        for (char* p = events; p < events + length; ) {
+            struct inotify_event* event = (struct inotify_event*)p;
+            if (event->len > 0 && strcmp(event->name, file_name) == 0) {
+                changed = 1;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    
+    TaskRegistry registry;
+    if (load_task_registry(registry_path, &registry) > 0) {
+        install_task_registry(&registry);
+        printf("Task registry reloaded: %d tasks\n", num_available_tasks);
+    } else {
+        printf("Keeping the previous %d tasks\n", num_available_tasks);
+    }
+}
+
+void unwatch_task_registry() {
+    if (registry_watch_fd >= 0) {
+        close(registry_watch_fd);
+        registry_watch_fd = -1;
+    }
+}
+
+// ##########################################
+// JOB CONTROL
+// ##########################################
+// Every task leads its own process group in our session, and Ctrl+C and
+// Ctrl+Z go to the group that has the keyboard. A task that stops itself
+// with SIGTSTP is minimized but stays resident; resuming it hands the
+// keyboard back and lets the dispatcher continue it where it stopped.
+// Tasks normally have a pseudo-terminal of their own (see the terminal
+// multiplexer); without one they take turns in the foreground of ours.
+
+void init_job_control() {
+    // Only a simulator in the foreground of a terminal can hand it over
+    if (batch_mode || !isatty(STDIN_FILENO) || tcgetpgrp(STDIN_FILENO) != getpgrp() ||
+        tcgetattr(STDIN_FILENO, &terminal_modes) == -1) {
+        return;
+    }
+    terminal_fd = STDIN_FILENO;
+}
+
+// Signal a task's whole process group, so whatever the script started stops
+// and continues with it. Never signals the simulator itself.
+int signal_task(pid_t pid, int sig) {
+    if (pid <= 0 || pid == getpid()) {
+        return -1;
+    }
+    if (kill(-pid, sig) == 0) {
+        return 0;
+    }
+    return kill(pid, sig);
+}
+
+// The task gets the screen and keyboard until it exits or stops, or the
+// user detaches from its console. Returns its wait status or
+// CONSOLE_DETACHED; *index is the task that was on screen last.
+int foreground_task(int* index, pid_t pid) {
+    if (consoles[*index].master_fd != -1) {
+        return attach_console(index, pid);
+    }
+    
+    if (terminal_fd != -1) {
+        tcsetpgrp(terminal_fd, pid); // Fails harmlessly if it has exited already
+    }
+    
+    int status = wait_for_child(*index, pid);
+    
+    // SIGTTOU is ignored, so we may take the terminal back from the background
+    if (terminal_fd != -1) {
+        tcsetpgrp(terminal_fd, getpgrp());
+        tcsetattr(terminal_fd, TCSADRAIN, &terminal_modes);
+    }
+    return status;
+}
+
+// Stopped tasks and tasks that exited with code 10 (the old convention)
+// are minimized
+int task_minimized(int status) {
+    return WIFSTOPPED(status) || (WIFEXITED(status) && WEXITSTATUS(status) == 10);
+}
+
+// Tell the user what became of the task that had the screen last
+void report_foreground(int index, int status) {
+    if (status == CONSOLE_DETACHED) {
+        printf("%s keeps running in the background. Resume it from the Task Manager.\n",
+               process_table[index].name);
+    } else if (task_minimized(status)) {
+        printf("%s was minimized. You can resume it later.\n", process_table[index].name);
+    } else {
+        printf("%s was closed.\n", process_table[index].name);
+    }
+}
+
+// ##########################################
+// TERMINAL MULTIPLEXER
+// ##########################################
+// Each task runs on its own pseudo-terminal, so several can run at once.
+// One thread waits in epoll on every master side and drains it with
+// non-blocking reads into a SCROLLBACK_BYTES ring per task; a task never
+// blocks on a full terminal while it is not shown. The output of the
+// visible task is also copied to the screen. Attaching replays the ring,
+// puts our terminal into raw mode and forwards keystrokes to the task;
+// Ctrl+B d goes back to the menus, Ctrl+B n/p switch to the next/previous
+// running task and Ctrl+B Ctrl+B sends a literal Ctrl+B.
+//
+// The pseudo-terminal is not the task's controlling terminal: a task in a
+// session of its own would be an orphaned process group, and the kernel
+// discards SIGTSTP for those. So while the task's terminal generates
+// signals (ISIG), the view sends SIGINT, SIGQUIT and SIGTSTP for its
+// interrupt, quit and suspend keys to the task's group itself.
+
+#define CONSOLE_WAKE_EVENT UINT64_MAX
+
+static void write_fully(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+// Append output to a console's scrollback. Called with its lock held.
+static void console_append(TaskConsole* console, const char* data, size_t length) {
+    if (length > SCROLLBACK_BYTES) {
+        data += length - SCROLLBACK_BYTES;
+        console->head += length - SCROLLBACK_BYTES;
+        length = SCROLLBACK_BYTES;
+    }
+    size_t start = (size_t)(console->head & (SCROLLBACK_BYTES - 1));
+    size_t first = length < SCROLLBACK_BYTES - start ? length : SCROLLBACK_BYTES - start;
+    memcpy(console->ring + start, data, first);
+    memcpy(console->ring, data + first, length - first);
+    console->head += length;
+}
+
+// Stop watching a console's terminal. Called with its lock held.
+static void close_console(TaskConsole* console) {
+    if (console->master_fd == -1) {
+        return;
+    }
+    epoll_ctl(console_epoll_fd, EPOLL_CTL_DEL, console->master_fd, NULL);
+    close(console->master_fd);
+    console->master_fd = -1;
+}
+
+// One read per ready terminal and epoll round, so a chatty task cannot
+// hold the thread while others wait; epoll reports the rest again
+static void drain_console(int index, char* buffer, size_t size) {
+    TaskConsole* console = &consoles[index];
+    
+    pthread_mutex_lock(&console->lock);
+    ssize_t length = -1;
+    if (console->master_fd != -1) {
+        while ((length = read(console->master_fd, buffer, size)) == -1 && errno == EINTR);
+    }
+    if (length > 0) {
+        console_append(console, buffer, (size_t)length);
+        if (__atomic_load_n(&visible_console, __ATOMIC_ACQUIRE) == index) {
+            write_fully(STDOUT_FILENO, buffer, (size_t)length);
+        }
+    } else if (console->master_fd != -1 && !(length == -1 && errno == EAGAIN)) {
+        // EIO: nothing has the task's terminal open any more
+        close_console(console);
+    }
+    pthread_mutex_unlock(&console->lock);
+}
+
+static void* console_loop(void* arg __attribute__((unused))) {
+    struct epoll_event events[16];
+    char buffer[4096];
+    trace_name_thread("console");
+    
+    while (__atomic_load_n(&console_running, __ATOMIC_ACQUIRE)) {
+        int ready = epoll_wait(console_epoll_fd, events, 16, -1);
+        if (ready == -1) {
+            if (errno != EINTR) {
+                perror("epoll_wait failed");
+                break;
+            }
+            continue;
+        }
+        
+        for (int e = 0; e < ready; e++) {
+            if (events[e].data.u64 == CONSOLE_WAKE_EVENT) {
+                uint64_t count;
+                while (read(console_wake_fd, &count, sizeof(count)) > 0);
+            } else {
+                drain_console((int)events[e].data.u64, buffer, sizeof(buffer));
+            }
+        }
+    }
+    return NULL;
+}
+
+void start_console_multiplexer() {
+    consoles = calloc(max_tasks, sizeof(TaskConsole));
+    console_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    console_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    console_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (consoles == NULL || console_epoll_fd == -1 || console_wake_fd == -1 || console_event_fd == -1) {
+        perror("Failed to set up the terminal multiplexer");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < max_tasks; i++) {
+        pthread_mutex_init(&consoles[i].lock, NULL);
+        consoles[i].master_fd = -1;
+    }
+    
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = CONSOLE_WAKE_EVENT;
+    epoll_ctl(console_epoll_fd, EPOLL_CTL_ADD, console_wake_fd, &event);
+    
+    console_running = 1;
+    if (pthread_create(&console_thread, NULL, console_loop, NULL) != 0) {
+        perror("Failed to create console thread");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void stop_console_multiplexer() {
+    if (!__atomic_exchange_n(&console_running, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    
+    uint64_t one = 1;
+    if (write(console_wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("Failed to wake the console thread");
+    }
+    pthread_join(console_thread, NULL);
+    
+    for (int i = 0; i < max_tasks; i++) {
+        close_console(&consoles[i]);
+        free(consoles[i].ring);
+        pthread_mutex_destroy(&consoles[i].lock);
+    }
+    free(consoles);
+    consoles = NULL;
+    close(console_epoll_fd);
+    close(console_wake_fd);
+    close(console_event_fd);
+}
+
+// Open a pseudo-terminal the size of ours; returns the non-blocking master
+// side and the path of the slave side, or -1
+int open_console(char* tty_path, size_t size) {
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master_fd == -1) {
+        return -1;
+    }
+    if (grantpt(master_fd) == -1 || unlockpt(master_fd) == -1 ||
+        ptsname_r(master_fd, tty_path, size) != 0) {
+        close(master_fd);
+        return -1;
+    }
+    
+    struct winsize window;
+    if (terminal_fd != -1 && ioctl(terminal_fd, TIOCGWINSZ, &window) == 0) {
+        ioctl(master_fd, TIOCSWINSZ, &window);
+    }
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+    return master_fd;
+}
+
+// Give a slot the terminal of its freshly spawned task, with empty scrollback
+void set_console(int index, int master_fd) {
+    TaskConsole* console = &consoles[index];
+    
+    pthread_mutex_lock(&console->lock);
+    close_console(console);
+    console->head = 0;
+    if (master_fd != -1 && console->ring == NULL) {
+        console->ring = malloc(SCROLLBACK_BYTES);
+    }
+    if (master_fd != -1 && console->ring != NULL) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = (uint64_t)index;
+        if (epoll_ctl(console_epoll_fd, EPOLL_CTL_ADD, master_fd, &event) == 0) {
+            console->master_fd = master_fd;
+        }
+    }
+    if (master_fd != -1 && console->master_fd != master_fd) {
+        close(master_fd); // Output can only go nowhere now
+    }
+    pthread_mutex_unlock(&console->lock);
+}
+
+// A child exited or stopped; the attached view checks on its task
+void notify_console_view() {
+    uint64_t one = 1;
+    if (console_event_fd != -1 && write(console_event_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("Failed to wake the console view");
+    }
+}
+
+// Put a console on the screen: its scrollback, then its live output
+static void show_console(int index) {
+    TaskConsole* console = &consoles[index];
+    
+    fflush(stdout);
+    pthread_mutex_lock(&console->lock);
+    write_fully(STDOUT_FILENO, "\033[H\033[2J\033[3J", 11);
+    unsigned long long used = console->head < SCROLLBACK_BYTES ? console->head : SCROLLBACK_BYTES;
+    size_t start = (size_t)((console->head - used) & (SCROLLBACK_BYTES - 1));
+    for (unsigned long long i = 0; i < used; ) {
+        size_t offset = (start + i) & (SCROLLBACK_BYTES - 1);
+        size_t chunk = (size_t)(used - i) < SCROLLBACK_BYTES - offset ? (size_t)(used - i) : SCROLLBACK_BYTES - offset;
+        write_fully(STDOUT_FILENO, console->ring + offset, chunk);
+        i += chunk;
+    }
+    __atomic_store_n(&visible_console, index, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&console->lock);
+}
+
+static void hide_console(int index) {
+    pthread_mutex_lock(&consoles[index].lock);
+    __atomic_store_n(&visible_console, -1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&consoles[index].lock);
+}
+
+// Next (step 1) or previous (step -1) slot after index with a running task
+// on its own terminal, or index itself
+static int next_console(int index, int step) {
+    int used = __atomic_load_n(&process_table_used, __ATOMIC_ACQUIRE);
+    for (int i = 1; i < used; i++) {
+        int candidate = ((index + step * i) % used + used) % used;
+        PCB* process = &process_table[candidate];
+        if (process->is_active && !process->is_minimized && process->child_pid > 0 &&
+            consoles[candidate].master_fd != -1) {
+            return candidate;
+        }
+    }
+    return index;
+}
+
+// Show a task's console and pass the keyboard to it until it exits or
+// stops, or the user detaches. Returns the wait status of the task shown
+// last (its slot in *index), or CONSOLE_DETACHED.
+int attach_console(int* index, pid_t pid) {
+    if (terminal_fd != -1) {
+        struct termios raw = terminal_modes;
+        cfmakeraw(&raw);
+        tcsetattr(terminal_fd, TCSADRAIN, &raw);
+    }
+    show_console(*index);
+    
+    int status = CONSOLE_DETACHED;
+    int prefix = 0;
+    for (;;) {
+        // The supervisor marks exits and stops, then writes console_event_fd
+        pthread_mutex_lock(&supervisor_mutex);
+        int done = process_table[*index].child_pid != pid || process_table[*index].is_minimized;
+        if (done) {
+            status = process_table[*index].exit_status;
+        }
+        pthread_mutex_unlock(&supervisor_mutex);
+        if (done) {
+            break;
+        }
+        
+        struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { console_event_fd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            while (read(console_event_fd, &count, sizeof(count)) > 0);
+        }
+        if (!(fds[0].revents & (POLLIN | POLLHUP))) {
+            continue;
+        }
+        
+        char keys[256], forward[256];
+        ssize_t length = read(STDIN_FILENO, keys, sizeof(keys));
+        if (length <= 0) {
+            break; // No keyboard left; detach
+        }
+        
+        // Keys that raise signals, unless the task switched them off
+        struct termios task_modes;
+        int signal_keys = 0;
+        pthread_mutex_lock(&consoles[*index].lock);
+        if (consoles[*index].master_fd != -1 && tcgetattr(consoles[*index].master_fd, &task_modes) == 0) {
+            signal_keys = (task_modes.c_lflag & ISIG) != 0;
+        }
+        pthread_mutex_unlock(&consoles[*index].lock);
+        
+        int detach = 0, target = *index;
+        size_t forwarded = 0;
+        for (ssize_t k = 0; k < length; k++) {
+            if (!prefix && keys[k] == CONSOLE_PREFIX_KEY) {
+                prefix = 1;
+                continue;
+            }
+            if (!prefix && signal_keys) {
+                cc_t key = (cc_t)keys[k];
+                int sig = key == task_modes.c_cc[VINTR] ? SIGINT :
+                          key == task_modes.c_cc[VQUIT] ? SIGQUIT :
+                          key == task_modes.c_cc[VSUSP] ? SIGTSTP : 0;
+                if (sig != 0) {
+                    signal_task(pid, sig);
+                    continue;
+                }
+            }
+            if (prefix) {
+                prefix = 0;
+                if (keys[k] == 'd') {
+                    detach = 1;
+                    break;
+                } else if (keys[k] == 'n' || keys[k] == 'p') {
+                    target = next_console(*index, keys[k] == 'n' ? 1 : -1);
+                    break;
+                } else if (keys[k] != CONSOLE_PREFIX_KEY) {
+                    continue; // Unknown hotkey
+                }
+            }
+            forward[forwarded++] = keys[k];
+        }
+        
+        // The terminal takes what fits; keystrokes beyond a full input
+        // queue are dropped rather than stalling the view
+        pthread_mutex_lock(&consoles[*index].lock);
+        if (forwarded > 0 && consoles[*index].master_fd != -1 &&
+            write(consoles[*index].master_fd, forward, forwarded) == -1 && errno != EAGAIN) {
+            perror("Failed to pass keys to the task");
+        }
+        pthread_mutex_unlock(&consoles[*index].lock);
+        
+        if (detach) {
+            break;
+        }
+        if (target != *index) {
+            hide_console(*index);
+            *index = target;
+            pid = process_table[target].child_pid;
+            show_console(target);
+        }
+    }
+    
+    hide_console(*index);
+    if (terminal_fd != -1) {
+        tcsetattr(terminal_fd, TCSADRAIN, &terminal_modes);
+    }
+    printf("\n");
+    return status;
+}
+
+// ##########################################
+// CHILD SUPERVISOR
+// ##########################################
+// One thread waits in epoll for child exits. Each child gets a pidfd; the
+// signalfd for SIGCHLD is the fallback for kernels without pidfd_open and
+// triggers a sweep of all supervised children. The eventfd wakes the
+// thread for shutdown.
+
+#define SUPERVISOR_SIGNAL_EVENT UINT64_MAX
+#define SUPERVISOR_WAKE_EVENT (UINT64_MAX - 1)
+#define SUPERVISOR_TIMER_EVENT (UINT64_MAX - 2)
+
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+void start_child_supervisor() {
+    sigset_t child_signal;
+    sigemptyset(&child_signal);
+    sigaddset(&child_signal, SIGCHLD);
+    sigaddset(&child_signal, SIGUSR1);
+    
+    supervisor_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    supervisor_signal_fd = signalfd(-1, &child_signal, SFD_NONBLOCK | SFD_CLOEXEC);
+    supervisor_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    supervisor_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (supervisor_epoll_fd == -1 || supervisor_signal_fd == -1 || supervisor_wake_fd == -1 ||
+        supervisor_timer_fd == -1) {
+        perror("Failed to set up the child supervisor");
+        exit(EXIT_FAILURE);
+    }
+    
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = SUPERVISOR_SIGNAL_EVENT;
+    epoll_ctl(supervisor_epoll_fd, EPOLL_CTL_ADD, supervisor_signal_fd, &event);
+    event.data.u64 = SUPERVISOR_WAKE_EVENT;
+    epoll_ctl(supervisor_epoll_fd, EPOLL_CTL_ADD, supervisor_wake_fd, &event);
+    event.data.u64 = SUPERVISOR_TIMER_EVENT;
+    epoll_ctl(supervisor_epoll_fd, EPOLL_CTL_ADD, supervisor_timer_fd, &event);
+    
+    // Periodic usage sampling of running tasks
+    struct itimerspec interval;
+    interval.it_interval.tv_sec = USAGE_SAMPLE_MS / 1000;
+    interval.it_interval.tv_nsec = (USAGE_SAMPLE_MS % 1000) * 1000000L;
+    interval.it_value = interval.it_interval;
+    timerfd_settime(supervisor_timer_fd, 0, &interval, NULL);
+    
+    supervisor_running = 1;
+    if (pthread_create(&supervisor_thread, NULL, supervisor_loop, NULL) != 0) {
+        perror("Failed to create supervisor thread");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void stop_child_supervisor() {
+    if (!__atomic_exchange_n(&supervisor_running, 0, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    
+    uint64_t one = 1;
+    if (write(supervisor_wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("Failed to wake the supervisor");
+    }
+    pthread_join(supervisor_thread, NULL);
+    
+    close(supervisor_epoll_fd);
+    close(supervisor_signal_fd);
+    close(supervisor_wake_fd);
+    close(supervisor_timer_fd);
+}
+
+// Start watching a freshly spawned child of a process table slot
+void supervise_child(int index, pid_t pid) {
+    PCB* process = &process_table[index];
+    
+    pthread_mutex_lock(&supervisor_mutex);
+    process->child_pid = pid;
+    memset(&process->usage, 0, sizeof(process->usage));
+    process->child_pidfd = open_pidfd(pid);
+    if (process->child_pidfd != -1) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = (uint64_t)index;
+        if (epoll_ctl(supervisor_epoll_fd, EPOLL_CTL_ADD, process->child_pidfd, &event) == -1) {
+            close(process->child_pidfd);
+            process->child_pidfd = -1;
+        }
+    }
+    // Without a pidfd the SIGCHLD sweep picks the child up
+    pthread_mutex_unlock(&supervisor_mutex);
+}
+
+// Block until the supervisor has reaped this child or it has stopped itself;
+// returns its wait status
+int wait_for_child(int index, pid_t pid) {
+    pthread_mutex_lock(&supervisor_mutex);
+    while (process_table[index].child_pid == pid && !process_table[index].is_minimized) {
+        pthread_cond_wait(&child_exit_cond, &supervisor_mutex);
+    }
+    int status = process_table[index].exit_status;
+    pthread_mutex_unlock(&supervisor_mutex);
+    return status;
+}
+
+// A task stopped. SIGTSTP (Ctrl+Z or a minimize from its menu) minimizes it
+// and it stays resident; SIGSTOP comes from the dispatcher or the Task
+// Manager. A task that read the terminal before it was handed over is
+// continued if it holds a CPU slot. Called with supervisor_mutex held.
+static void child_stopped(int index, int status) {
+    PCB* process = &process_table[index];
+    int sig = WSTOPSIG(status);
+    
+    if (sig == SIGTTIN || sig == SIGTTOU) {
+        if (process->is_dispatched && !process->is_minimized) {
+            signal_task(process->child_pid, SIGCONT);
+        }
+        return;
+    }
+    if (sig != SIGTSTP) {
+        return;
+    }
+    
+    table_write_lock();
+    if (process->is_active && !process->terminating && !process->is_minimized) {
+        process->is_minimized = 1;
+        metric_add(METRIC_MINIMIZES, 1);
+        trace_event(TRACE_MINIMIZE, process->child_pid, 0, 0);
+    }
+    table_write_unlock();
+    
+    process->exit_status = status;
+    pthread_cond_broadcast(&child_exit_cond);
+    notify_console_view();
+}
+
+// Reap the child of a slot if it has exited. Exit code 10 means the task
+// asked to be minimized and keeps its resources; anything else releases
+// the slot. Called with supervisor_mutex held.
+static void reap_child(int index) {
+    PCB* process = &process_table[index];
+    int status;
+    
+    if (process->child_pid <= 0) {
+        return;
+    }
+    struct rusage rusage;
+    pid_t result = wait4(process->child_pid, &status, WNOHANG | WUNTRACED, &rusage);
+    if (result == 0 || (result == -1 && errno == EINTR)) {
+        return; // Still running
+    }
+    if (result > 0 && WIFSTOPPED(status)) {
+        child_stopped(index, status);
+        return;
+    }
+    if (result == -1) {
+        status = 0; // Already reaped elsewhere
+    } else {
+        record_exit_usage(process, &rusage);
+    }
+    
+    if (process->child_pidfd != -1) {
+        epoll_ctl(supervisor_epoll_fd, EPOLL_CTL_DEL, process->child_pidfd, NULL);
+        close(process->child_pidfd);
+        process->child_pidfd = -1;
+    }
+    release_task_limits(index);
+    
+    table_write_lock();
+    // The Task Manager may have terminated the process already
+    if (process->is_active) {
+        if (!process->terminating && WIFEXITED(status) && WEXITSTATUS(status) == 10) {
+            process->is_minimized = 1;
+            metric_add(METRIC_MINIMIZES, 1);
+            trace_event(TRACE_MINIMIZE, process->child_pid, 0, 0);
+        } else {
+            if (!process->terminating) {
+                metric_add(METRIC_EXITS, 1);
+                trace_event(TRACE_EXIT, process->child_pid, 0,
+                            WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+            }
+            process_table_remove(index);
+            free_resources(index);
+        }
+    }
+    table_write_unlock();
+    
+    process->exit_status = status;
+    process->child_pid = -1;
+    pthread_cond_broadcast(&child_exit_cond);
+    notify_console_view();
+}
+
+void* supervisor_loop(void* arg __attribute__((unused))) {
+    struct epoll_event events[16];
+    trace_name_thread("supervisor");
+    
+    while (__atomic_load_n(&supervisor_running, __ATOMIC_ACQUIRE)) {
+        int ready = epoll_wait(supervisor_epoll_fd, events, 16, -1);
+        if (ready == -1) {
+            if (errno != EINTR) {
+                perror("epoll_wait failed");
+                break;
+            }
+            continue;
+        }
+        
+        pthread_mutex_lock(&supervisor_mutex);
+        for (int e = 0; e < ready; e++) {
+            uint64_t tag = events[e].data.u64;
+            
+            if (tag == SUPERVISOR_WAKE_EVENT) {
+                uint64_t count;
+                while (read(supervisor_wake_fd, &count, sizeof(count)) > 0);
+            } else if (tag == SUPERVISOR_TIMER_EVENT) {
+                uint64_t expirations;
+                while (read(supervisor_timer_fd, &expirations, sizeof(expirations)) > 0);
+                int used = __atomic_load_n(&process_table_used, __ATOMIC_ACQUIRE);
+                for (int i = 0; i < used; i++) {
+                    if (process_table[i].child_pid > 0) {
+                        sample_task_usage(i);
+                    }
+                }
+            } else if (tag == SUPERVISOR_SIGNAL_EVENT) {
+                // SIGCHLDs coalesce, so check every supervised child
+                struct signalfd_siginfo info;
+                int child_exited = 0, dump_trace = 0;
+                while (read(supervisor_signal_fd, &info, sizeof(info)) > 0) {
+                    if (info.ssi_signo == SIGUSR1) {
+                        dump_trace = 1;
+                    } else {
+                        child_exited = 1;
+                    }
+                }
+                if (dump_trace && tracing_enabled && export_trace_file(trace_file_path) != 0) {
+                    perror(trace_file_path);
+                }
+                int used = child_exited ? __atomic_load_n(&process_table_used, __ATOMIC_ACQUIRE) : 0;
+                for (int i = 0; i < used; i++) {
+                    reap_child(i);
+                }
+            } else {
+                reap_child((int)tag);
+            }
+        }
+        pthread_mutex_unlock(&supervisor_mutex);
+    }
+    
+    return NULL;
+}
+
+// ##########################################
+// PROCESS TERMINATION
+// ##########################################
+// Tasks are signalled through their pidfd (by PID without one), and their
+// whole process group when they lead one. SIGTERM comes first, with SIGCONT
+// for tasks the dispatcher holds stopped; whatever has not been reaped after
+// the grace period gets SIGKILL. The supervisor reaps, so we only wait for it.
+
+static int pidfd_signal(int pidfd, int sig) {
+#ifdef SYS_pidfd_send_signal
+    return (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+#else
+    (void)pidfd;
+    (void)sig;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// Signal the live child of a slot. Called with supervisor_mutex held, so the
+// child cannot be reaped and its PID reused meanwhile.
+static void signal_child(PCB* process, int sig) {
+    pid_t pid = process->child_pid;
+    if (pid <= 0) {
+        return;
+    }
+    
+    // Signal 0 through the pidfd checks that the PID is still our child
+    // before it is used for a group kill
+    int pidfd = process->child_pidfd;
+    if (pidfd != -1 && pidfd_signal(pidfd, 0) == -1 && errno == ESRCH) {
+        return;
+    }
+    
+    // Helpers the task started (bc, sleep) share its group if it leads one;
+    // the group kill reaches the task too, so it is signalled exactly once
+    if (getpgid(pid) == pid && kill(-pid, sig) == 0) {
+        return;
+    }
+    if (pidfd == -1 || pidfd_signal(pidfd, sig) == -1) {
+        kill(pid, sig);
+    }
+}
+
+// Wait until every listed child is reaped or the deadline passes; returns how
+// many are still alive. Called with supervisor_mutex held.
+static int wait_for_reaps(const int* indexes, int count, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    
+    // Count once more after a timeout, a reap may have raced with it
+    int timed_out = 0;
+    while (1) {
+        int alive = 0;
+        for (int i = 0; i < count; i++) {
+            alive += process_table[indexes[i]].child_pid > 0;
+        }
+        if (alive == 0 || timed_out) {
+            return alive;
+        }
+        timed_out = pthread_cond_timedwait(&child_exit_cond, &supervisor_mutex, &deadline) == ETIMEDOUT;
+    }
+}
+
+// Stop the tasks of the listed slots: SIGTERM, then SIGKILL after timeout_ms.
+// Returns how many needed SIGKILL.
+int stop_children(const int* indexes, int count, int timeout_ms) {
+    pthread_mutex_lock(&supervisor_mutex);
+    for (int i = 0; i < count; i++) {
+        PCB* process = &process_table[indexes[i]];
+        process->terminating = 1;
+        signal_child(process, SIGTERM);
+        signal_child(process, SIGCONT);
+    }
+    
+    int killed = wait_for_reaps(indexes, count, timeout_ms);
+    if (killed > 0) {
+        for (int i = 0; i < count; i++) {
+            signal_child(&process_table[indexes[i]], SIGKILL);
+        }
+        int alive = wait_for_reaps(indexes, count, KILL_TIMEOUT_MS);
+        if (alive > 0) {
+            printf("WARNING: %d process(es) were not reaped after SIGKILL\n", alive);
+        }
+    }
+    pthread_mutex_unlock(&supervisor_mutex);
+    return killed;
+}
+
+// ##########################################
+// TASK RESOURCE LIMITS
+// ##########################################
+// Each spawned task gets its own cgroup v2 under <our cgroup>/nexos-<pid>,
+// created before the task and holding it from its first instruction.
+// Controllers can only be enabled in a cgroup without processes of its
+// own, so NexOS itself moves into the leaf nexos-<pid>/supervisor and the
+// tasks sit in sibling task-<n> leaves. That still needs the cgroup we were
+// started in to be ours alone (a delegated one, e.g. from systemd-run
+// --scope -p Delegate=yes) unless it already hands memory and cpu down. Its
+// memory.max and cpu.max follow the task's current grant: the declared RAM
+// and one core (its CPU slot), plus whatever it was granted on request.
+// Without a usable cgroup v2 hierarchy the task gets RLIMIT_DATA via prlimit
+// instead, which bounds memory but not CPU. The supervisor samples the real
+// usage and charges memory above the declared size to the resource pool.
+
+// Returns -1 with errno set on failure
+static int write_cgroup_file(const char* directory, const char* file, const char* value) {
+    char path[MAX_PATH_LENGTH * 3];
+    snprintf(path, sizeof(path), "%s/%s", directory, file);
+    
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t written = write(fd, value, strlen(value));
+    int error = errno;
+    close(fd);
+    errno = error;
+    return written == (ssize_t)strlen(value) ? 0 : -1;
+}
+
+// Whether a cgroup's controller list (cgroup.controllers or
+// cgroup.subtree_control) holds both memory and cpu
+static int cgroup_has_controllers(const char* directory, const char* file) {
+    char path[MAX_PATH_LENGTH * 3];
+    char list[256] = " ";
+    snprintf(path, sizeof(path), "%s/%s", directory, file);
+    FILE* stream = fopen(path, "r");
+    if (stream == NULL) {
+        return 0;
+    }
+    if (fgets(list + 1, sizeof(list) - 2, stream) != NULL) {
+        list[strcspn(list, "\n")] = '\0';
+        strcat(list, " ");
+    }
+    fclose(stream);
+    return strstr(list, " memory ") != NULL && strstr(list, " cpu ") != NULL;
+}
+
+// Move NexOS itself into the cgroup directory
+static int join_cgroup(const char* directory) {
+    char pid[32];
+    snprintf(pid, sizeof(pid), "%d", (int)getpid());
+    return write_cgroup_file(directory, "cgroup.procs", pid);
+}
+
+// Read a single number from a file; -1 on failure
+static long long read_number_file(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    long long value = -1;
+    if (fscanf(file, "%lld", &value) != 1) {
+        value = -1;
+    }
+    fclose(file);
+    return value;
+}
+
+// Go back to the cgroup we were started in. A cgroup that hands controllers
+// down may not hold processes, so what we enabled there is switched off
+// first; if it already had them, it is the root cgroup, which is exempt.
+static void leave_task_cgroups() {
+    if (cgroup_parent_enabled) {
+        write_cgroup_file(cgroup_base, "cgroup.subtree_control", "-memory -cpu");
+        write_cgroup_file(cgroup_parent, "cgroup.subtree_control", "-memory -cpu");
+        cgroup_parent_enabled = 0;
+    }
+    join_cgroup(cgroup_parent);
+}
+
+// Directory of the cgroup v2 we run in; returns 0 without a cgroup v2 mount
+int find_own_cgroup(char* directory, size_t size) {
+    const char* mounts[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+    const char* mount = NULL;
+    char path[MAX_PATH_LENGTH * 3];
+    
+    for (size_t i = 0; i < sizeof(mounts) / sizeof(mounts[0]) && mount == NULL; i++) {
+        snprintf(path, sizeof(path), "%s/cgroup.controllers", mounts[i]);
+        if (access(path, R_OK) == 0) {
+            mount = mounts[i];
+        }
+    }
+    if (mount == NULL) {
+        return 0;
+    }
+    
+    // Our own cgroup is the "0::<path>" line
+    char own_cgroup[MAX_PATH_LENGTH] = "";
+    FILE* file = fopen("/proc/self/cgroup", "r");
+    if (file != NULL) {
+        char line[MAX_PATH_LENGTH + 16];
+        while (fgets(line, sizeof(line), file) != NULL) {
+            if (strncmp(line, "0::", 3) == 0) {
+                line[strcspn(line, "\n")] = '\0';
+                if (strcmp(line + 3, "/") != 0 && strlen(line + 3) < sizeof(own_cgroup)) {
+                    strcpy(own_cgroup, line + 3);
+                }
+            }
+        }
+        fclose(file);
+    }
+    return snprintf(directory, size, "%s%s", mount, own_cgroup) < (int)size;
+}
+
+void init_task_limits() {
+    const char* failure = "cgroup v2 is not available";
+    int error = 0;
+    int mount = find_own_cgroup(cgroup_parent, sizeof(cgroup_parent));
+    if (mount &&
+        snprintf(cgroup_base, sizeof(cgroup_base), "%s/nexos-%d", cgroup_parent, (int)getpid()) <
+            (int)sizeof(cgroup_base)) {
+        char supervisor[MAX_PATH_LENGTH * 3];
+        snprintf(supervisor, sizeof(supervisor), "%s/supervisor", cgroup_base);
+        // NexOS leaves its cgroup first: no cgroup with processes of its
+        // own may enable controllers for its children
+        int joined = 0;
+        if (!cgroup_has_controllers(cgroup_parent, "cgroup.controllers")) {
+            failure = "the memory and cpu controllers are not available to cgroup v2";
+        } else if ((mkdir(cgroup_base, 0755) == -1 && errno != EEXIST) ||
+                   (mkdir(supervisor, 0755) == -1 && errno != EEXIST)) {
+            failure = "cannot create the NexOS cgroup";
+            error = errno;
+        } else if (!(joined = join_cgroup(supervisor) == 0)) {
+            failure = "cannot move NexOS into its cgroup";
+            error = errno;
+        } else if (!cgroup_has_controllers(cgroup_parent, "cgroup.subtree_control") &&
+                   !(cgroup_parent_enabled = write_cgroup_file(cgroup_parent, "cgroup.subtree_control",
+                                                               "+memory +cpu") == 0)) {
+            failure = errno == EBUSY ? "the cgroup NexOS started in is shared with other processes"
+                                     : "cannot enable memory and cpu for the NexOS cgroup";
+            error = errno;
+        } else if (write_cgroup_file(cgroup_base, "cgroup.subtree_control", "+memory +cpu") == -1) {
+            failure = "cannot enable memory and cpu for the task cgroups";
+            error = errno;
+        } else {
+            failure = NULL;
+        }
+        
+        if (failure != NULL) {
+            if (joined) {
+                leave_task_cgroups();
+            }
+            rmdir(supervisor);
+            rmdir(cgroup_base);
+        }
+    }
+    
+    if (failure == NULL) {
+        printf("Task limits: cgroup v2 (memory.max, cpu.max) under %s\n", cgroup_base);
+        return;
+    }
+    if (error != 0) {
+        printf("Task limits: %s (%s)\n", failure, strerror(error));
+    } else if (mount) {
+        printf("Task limits: %s\n", failure);
+    }
+    printf("Task limits: setrlimit (RLIMIT_DATA), cgroup v2 is not available\n");
+    cgroup_base[0] = '\0';
+}
+
+void destroy_task_limits() {
+    if (cgroup_base[0] != '\0') {
+        char supervisor[MAX_PATH_LENGTH * 3];
+        snprintf(supervisor, sizeof(supervisor), "%s/supervisor", cgroup_base);
+        leave_task_cgroups();
+        rmdir(supervisor);
+        rmdir(cgroup_base);
+    }
+}
+
+static void task_cgroup_directory(char* directory, size_t size, int cgroup_id) {
+    snprintf(directory, size, "%s/task-%d", cgroup_base, cgroup_id);
+}
+
+static long long task_memory_bytes(const PCB* process) {
+    return (long long)(process->ram_required + process->granted.ram_mb) * 1024 * 1024;
+}
+
+// Fallback: bound the heap and anonymous mappings of the task
+static void limit_task_data(pid_t pid, long long memory_bytes) {
+    struct rlimit limit;
+    limit.rlim_cur = memory_bytes;
+    limit.rlim_max = memory_bytes;
+    if (prlimit(pid, RLIMIT_DATA, &limit, NULL) == -1) {
+        perror("prlimit failed");
+    }
+}
+
+// Write the limits of the task's current grant. Called at launch and, with
+// claim_mutex held, whenever a request or release changes the grant.
+// Returns -1 if the cgroup files could not be written.
+int write_task_limits(int index) {
+    PCB* process = &process_table[index];
+    char value[64];
+    
+    if (process->cgroup_id > 0) {
+        char directory[MAX_PATH_LENGTH * 3];
+        task_cgroup_directory(directory, sizeof(directory), process->cgroup_id);
+        snprintf(value, sizeof(value), "%lld", task_memory_bytes(process));
+        int failed = write_cgroup_file(directory, "memory.max", value);
+        
+        // One core for its CPU slot, plus the cores it was granted
+        snprintf(value, sizeof(value), "%d %d", (1 + process->granted.cores) * CPU_PERIOD_US, CPU_PERIOD_US);
+        failed |= write_cgroup_file(directory, "cpu.max", value);
+        return failed;
+    }
+    
+    if (process->child_pid > 0) {
+        limit_task_data(process->child_pid, task_memory_bytes(process));
+    }
+    return 0;
+}
+
+// Create the cgroup of a task that is about to be spawned and write its
+// limits. Returns a directory fd for CLONE_INTO_CGROUP, or -1 without one.
+int open_task_cgroup(int index) {
+    PCB* process = &process_table[index];
+    process->cgroup_id = 0;
+    if (cgroup_base[0] == '\0') {
+        return -1;
+    }
+    
+    int cgroup_id = __atomic_add_fetch(&next_cgroup_id, 1, __ATOMIC_RELAXED);
+    char directory[MAX_PATH_LENGTH * 3];
+    task_cgroup_directory(directory, sizeof(directory), cgroup_id);
+    if (mkdir(directory, 0755) == -1) {
+        return -1;
+    }
+    process->cgroup_id = cgroup_id;
+    
+    // Keep the task from swapping its way past the limit
+    write_cgroup_file(directory, "memory.swap.max", "0");
+    int fd = write_task_limits(index) == 0 ? open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (fd == -1) {
+        rmdir(directory);
+        process->cgroup_id = 0;
+    }
+    return fd;
+}
+
+// Put a freshly spawned task under its memory and CPU limits. in_cgroup
+// says it was created inside its cgroup; otherwise (no clone3) it is moved
+// there now, or falls back to RLIMIT_DATA.
+void limit_task_resources(int index, pid_t pid, int in_cgroup) {
+    PCB* process = &process_table[index];
+    if (process->cgroup_id > 0 && !in_cgroup) {
+        char directory[MAX_PATH_LENGTH * 3];
+        char value[32];
+        task_cgroup_directory(directory, sizeof(directory), process->cgroup_id);
+        snprintf(value, sizeof(value), "%d", (int)pid);
+        if (write_cgroup_file(directory, "cgroup.procs", value) != 0) {
+            rmdir(directory);
+            process->cgroup_id = 0;
+        }
+    }
+    
+    if (process->cgroup_id == 0) {
+        limit_task_data(pid, task_memory_bytes(process));
+    }
+}
+
+// Remove the cgroup of a reaped task
+void release_task_limits(int index) {
+    if (process_table[index].cgroup_id == 0) {
+        return;
+    }
+    
+    char directory[MAX_PATH_LENGTH * 3];
+    task_cgroup_directory(directory, sizeof(directory), process_table[index].cgroup_id);
+    rmdir(directory); // Fails while helpers of the task are still alive
+    process_table[index].cgroup_id = 0;
+}
+
+// Sample RSS, CPU time and the rest of the accounting of a running task
+// into its PCB. Called by the supervisor with supervisor_mutex held.
+void sample_task_usage(int index) {
+    PCB* process = &process_table[index];
+    pid_t pid = process->child_pid;
+    long rss_kb = -1;
+    
+    if (process->cgroup_id > 0) {
+        // Includes helpers the task started, e.g. bc
+        char path[MAX_PATH_LENGTH * 3];
+        snprintf(path, sizeof(path), "%s/task-%d/memory.current", cgroup_base, process->cgroup_id);
+        long long bytes = read_number_file(path);
+        rss_kb = bytes >= 0 ? (long)(bytes / 1024) : -1;
+    }
+    
+    long proc_rss_kb;
+    if (!read_task_usage(pid, &process->usage, &proc_rss_kb)) {
+        return;
+    }
+    process->cpu_ms = process->usage.user_ms + process->usage.system_ms;
+    if (rss_kb < 0) {
+        rss_kb = proc_rss_kb;
+    }
+    process->rss_kb = rss_kb;
+    if (rss_kb > process->peak_rss_kb) {
+        process->peak_rss_kb = rss_kb;
+    }
+    
+    // Memory beyond the declared size is taken from the pool, so admission
+    // sees what tasks really use
+    int used_mb = (int)((process->peak_rss_kb + 1023) / 1024);
+    charge_reservation(&process->reservation, used_mb);
+}
+
+// ##########################################
+// PROCESS ACCOUNTING
+// ##########################################
+// The supervisor samples every running task each USAGE_SAMPLE_MS from
+// /proc/<pid>/stat, status and io, one read() each and no stdio, and takes
+// the final numbers from the wait4 rusage when the task exits. The Task
+// Manager only shows these cached values, so redrawing it costs no syscalls
+// per process.
+
+// Read a small /proc file of a process in one go; its length or -1
+static ssize_t read_proc_file(pid_t pid, const char* name, char* buffer, size_t size) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int)pid, name);
+    
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if (length <= 0) {
+        return -1;
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+// Number after a "key:" of /proc/<pid>/status or io, -1 if missing
+static long long proc_field(const char* text, const char* key) {
+    const char* found = strstr(text, key);
+    return found != NULL ? strtoll(found + strlen(key), NULL, 10) : -1;
+}
+
+// Take a fresh sample of a running process; returns 0 if it is gone
+int read_task_usage(pid_t pid, TaskUsage* usage, long* rss_kb) {
+    static long ticks_per_second = 0;
+    static long page_kb = 0;
+    if (ticks_per_second <= 0) {
+        ticks_per_second = sysconf(_SC_CLK_TCK);
+        page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    }
+    
+    char buffer[4096];
+    if (read_proc_file(pid, "stat", buffer, sizeof(buffer)) < 0) {
+        return 0;
+    }
+    
+    // The command name may contain spaces; fields restart after its ')'
+    char* fields = strrchr(buffer, ')');
+    unsigned long minflt, cminflt, majflt, cmajflt, utime, stime;
+    long cutime, cstime, rss;
+    if (fields == NULL ||
+        sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %lu %lu %lu %lu %lu %lu %ld %ld "
+               "%*d %*d %*d %*d %*u %*u %ld", &minflt, &cminflt, &majflt, &cmajflt,
+               &utime, &stime, &cutime, &cstime, &rss) != 9) {
+        return 0;
+    }
+    
+    // Helpers the task already reaped count as its own, as in wait4
+    usage->user_ms = (long)((utime + cutime) * 1000 / ticks_per_second);
+    usage->system_ms = (long)((stime + cstime) * 1000 / ticks_per_second);
+    usage->minor_faults = (long)(minflt + cminflt);
+    usage->major_faults = (long)(majflt + cmajflt);
+    *rss_kb = rss * page_kb;
+    
+    usage->voluntary_switches = -1;
+    usage->involuntary_switches = -1;
+    usage->max_rss_kb = *rss_kb;
+    if (read_proc_file(pid, "status", buffer, sizeof(buffer)) > 0) {
+        usage->voluntary_switches = (long)proc_field(buffer, "\nvoluntary_ctxt_switches:");
+        usage->involuntary_switches = (long)proc_field(buffer, "\nnonvoluntary_ctxt_switches:");
+        long long peak_kb = proc_field(buffer, "\nVmHWM:");
+        if (peak_kb >= 0) {
+            usage->max_rss_kb = (long)peak_kb;
+        }
+    }
+    
+    // rchar/wchar: bytes through read and write calls, including the terminal
+    usage->read_bytes = -1;
+    usage->write_bytes = -1;
+    if (read_proc_file(pid, "io", buffer, sizeof(buffer)) > 0) {
+        usage->read_bytes = proc_field(buffer, "rchar:");
+        usage->write_bytes = proc_field(buffer, "\nwchar:");
+    }
+    
+    usage->from_exit = 0;
+    usage->sampled_ns = monotonic_ns();
+    return 1;
+}
+
+// Final numbers of a reaped child; wait4 has no byte counts, so the I/O of
+// the last sample stays
+void record_exit_usage(PCB* process, const struct rusage* rusage) {
+    TaskUsage* usage = &process->usage;
+    usage->user_ms = rusage->ru_utime.tv_sec * 1000L + rusage->ru_utime.tv_usec / 1000;
+    usage->system_ms = rusage->ru_stime.tv_sec * 1000L + rusage->ru_stime.tv_usec / 1000;
+    usage->voluntary_switches = rusage->ru_nvcsw;
+    usage->involuntary_switches = rusage->ru_nivcsw;
+    usage->max_rss_kb = rusage->ru_maxrss;
+    usage->minor_faults = rusage->ru_minflt;
+    usage->major_faults = rusage->ru_majflt;
+    usage->from_exit = 1;
+    usage->sampled_ns = monotonic_ns();
+    process->cpu_ms = usage->user_ms + usage->system_ms;
+}
+
+static const char* usage_number(char* buffer, size_t size, long long value, long long divisor) {
+    if (value < 0) {
+        snprintf(buffer, size, "-");
+    } else {
+        snprintf(buffer, size, "%lld", value / divisor);
+    }
+    return buffer;
+}
+
+// Cached accounting of every process (Task Manager live view, batch "usage")
+void print_usage_table() {
+    char vcsw[24], icsw[24], max_rss[24], minflt[24], majflt[24], read_kb[24], write_kb[24], age[24];
+    long long now = monotonic_ns();
+    
+    printf("%-7s %-20s %8s %8s %8s %8s %9s %8s %7s %9s %9s %7s\n", "PID", "NAME", "USER s", "SYS s",
+           "VCSW", "ICSW", "MAXRSS MB", "MINFLT", "MAJFLT", "READ KB", "WRITE KB", "AGE");
+    
+    pthread_mutex_lock(&supervisor_mutex);
+    for (int i = 0; i < process_table_used; i++) {
+        if (!process_table[i].is_active) {
+            continue;
+        }
+        TaskUsage usage = process_table[i].usage;
+        if (usage.sampled_ns == 0) {
+            printf("%-7d %-20.20s %8s %8s %8s %8s %9s %8s %7s %9s %9s %7s\n", process_table[i].pid,
+                   process_table[i].name, "-", "-", "-", "-", "-", "-", "-", "-", "-", "-");
+            continue;
+        }
+        if (usage.from_exit) {
+            snprintf(age, sizeof(age), "exited");
+        } else {
+            snprintf(age, sizeof(age), "%.1fs", (now - usage.sampled_ns) / 1e9);
+        }
+        printf("%-7d %-20.20s %8.2f %8.2f %8s %8s %9s %8s %7s %9s %9s %7s\n", process_table[i].pid,
+               process_table[i].name, usage.user_ms / 1000.0, usage.system_ms / 1000.0,
+               usage_number(vcsw, sizeof(vcsw), usage.voluntary_switches, 1),
+               usage_number(icsw, sizeof(icsw), usage.involuntary_switches, 1),
+               usage_number(max_rss, sizeof(max_rss), usage.max_rss_kb, 1024),
+               usage_number(minflt, sizeof(minflt), usage.minor_faults, 1),
+               usage_number(majflt, sizeof(majflt), usage.major_faults, 1),
+               usage_number(read_kb, sizeof(read_kb), usage.read_bytes, 1024),
+               usage_number(write_kb, sizeof(write_kb), usage.write_bytes, 1024), age);
+    }
+    pthread_mutex_unlock(&supervisor_mutex);
+}
+
+// Redraw the usage table every second until Enter is pressed
+void display_live_usage() {
+    while (1) {
+        clear_screen();
+        printf("\n");
+        printf("╔═══════════════════════════════════════════════════════╗\n");
+        printf("║               LIVE RESOURCE USAGE                     ║\n");
+        printf("╚═══════════════════════════════════════════════════════╝\n\n");
+        print_usage_table();
+        printf("\nSampled every %d ms, times and faults include reaped helpers.\n", USAGE_SAMPLE_MS);
+        printf("Press Enter to return...");
+        fflush(stdout);
+        
+        struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+        int ready = poll(&input, 1, 1000);
+        if (ready > 0) {
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF);
+            break;
+        }
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+    }
+}
+
+// ##########################################
+// METRICS
+// ##########################################
+// Counters and histograms live in per-thread shards: recording is one
+// relaxed atomic add on a cache line no other thread writes, so the hot
+// paths take no lock. The exporter sums the shards and writes Prometheus
+// text format, atomically replacing --metrics-file (for the node exporter's
+// textfile collector) every --metrics-interval milliseconds.
+
+static const char* const metric_counter_names[NUM_METRIC_COUNTERS][2] = {
+    { "nexos_launches_total", "Task processes started, including resumed tasks." },
+    { "nexos_admission_rejections_total", "Launches refused for lack of resources or a possible deadlock." },
+    { "nexos_terminations_total", "Processes terminated from the Task Manager or at shutdown." },
+    { "nexos_exits_total", "Task processes that exited on their own." },
+    { "nexos_minimizes_total", "Tasks minimized: stopped with SIGTSTP, or exited with the old minimize code 10." },
+    { "nexos_enqueues_total", "Processes put on a ready queue, including requeues after preemption." },
+    { "nexos_dequeues_total", "Processes taken off a ready queue by a core." },
+    { "nexos_dispatches_total", "Processes given a core." },
+    { "nexos_preemptions_total", "Processes stopped at the end of their quantum." }
+};
+
+static const char* const metric_histogram_names[NUM_METRIC_HISTOGRAMS][2] = {
+    { "nexos_dispatch_latency_seconds", "Time from entering a ready queue to getting a core." },
+    { "nexos_slot_seconds", "Time a process held a core per dispatch." },
+    { "nexos_launch_latency_seconds", "Time to spawn a task process." }
+};
+
+static __thread MetricShard* thread_shard = NULL;
+
+static MetricShard* metric_shard() {
+    if (thread_shard == NULL) {
+        int index = __atomic_fetch_add(&metric_shard_count, 1, __ATOMIC_RELAXED);
+        thread_shard = &metric_shards[index % MAX_METRIC_SHARDS];
+    }
+    return thread_shard;
+}
+
+void metric_add(MetricCounter counter, unsigned long long amount) {
+    __atomic_fetch_add(&metric_shard()->counters[counter], amount, __ATOMIC_RELAXED);
+}
+
+void metric_observe(MetricHistogram histogram, long long ns) {
+    MetricShard* shard = metric_shard();
+    int bucket = 0;
+    if (ns >= 1024) {
+        bucket = 63 - __builtin_clzll((unsigned long long)ns) - 9;
+        if (bucket >= HISTOGRAM_BUCKETS) {
+            bucket = HISTOGRAM_BUCKETS - 1;
+        }
+    }
+    __atomic_fetch_add(&shard->buckets[histogram][bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->sums_ns[histogram], ns > 0 ? (unsigned long long)ns : 0, __ATOMIC_RELAXED);
+}
+
+// A process entered level to_level and/or left from_level; -1 for neither
+void metric_level_move(int from_level, int to_level) {
+    MetricShard* shard = metric_shard();
+    if (from_level >= 0) {
+        __atomic_fetch_add(&shard->level_dequeues[from_level], 1, __ATOMIC_RELAXED);
+    }
+    if (to_level >= 0) {
+        __atomic_fetch_add(&shard->level_enqueues[to_level], 1, __ATOMIC_RELAXED);
+    }
+}
+
+static unsigned long long sum_shards(size_t offset) {
+    unsigned long long total = 0;
+    for (int i = 0; i < MAX_METRIC_SHARDS; i++) {
+        total += __atomic_load_n((unsigned long long*)((char*)&metric_shards[i] + offset), __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+static void write_metric_header(FILE* out, const char* name, const char* help, const char* type) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Prometheus text exposition of all metrics
+void write_metrics(FILE* out) {
+    for (int c = 0; c < NUM_METRIC_COUNTERS; c++) {
+        write_metric_header(out, metric_counter_names[c][0], metric_counter_names[c][1], "counter");
+        fprintf(out, "%s %llu\n", metric_counter_names[c][0],
+                sum_shards(offsetof(MetricShard, counters) + c * sizeof(unsigned long long)));
+    }
+    
+    write_metric_header(out, "nexos_queue_depth", "Processes waiting in the ready queues, per level.", "gauge");
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        long long depth = (long long)sum_shards(offsetof(MetricShard, level_enqueues) + level * sizeof(unsigned long long)) -
+                          (long long)sum_shards(offsetof(MetricShard, level_dequeues) + level * sizeof(unsigned long long));
+        fprintf(out, "nexos_queue_depth{level=\"%d\"} %lld\n", level, depth > 0 ? depth : 0);
+    }
+    
+    write_metric_header(out, "nexos_core_queue_depth", "Processes waiting for each simulated core.", "gauge");
+    for (int w = 0; w < num_worker_queues; w++) {
+        fprintf(out, "nexos_core_queue_depth{core=\"%d\"} %d\n", w,
+                __atomic_load_n(&worker_queues[w].queued, __ATOMIC_RELAXED));
+    }
+    write_metric_header(out, "nexos_core_migrations_total", "Processes moved between cores by the load balancer.", "counter");
+    fprintf(out, "nexos_core_migrations_total %lu\n", balance_stats.migrations);
+    
+    // Resource utilisation
+    ResourceCounts available = available_resources();
+    int capacity[NUM_RESOURCE_TYPES] = { hardware.ram_gb * 1024, hardware.hdd_gb, hardware.cpu_cores };
+    int free_amount[NUM_RESOURCE_TYPES] = { available.ram_mb, available.hdd_gb, available.cores };
+    const char* resources[NUM_RESOURCE_TYPES] = { "ram_mb", "hdd_gb", "cores" };
+    write_metric_header(out, "nexos_resource_capacity", "Resources of the simulated machine.", "gauge");
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        fprintf(out, "nexos_resource_capacity{resource=\"%s\"} %d\n", resources[r], capacity[r]);
+    }
+    write_metric_header(out, "nexos_resource_used", "Resources held by running tasks.", "gauge");
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        fprintf(out, "nexos_resource_used{resource=\"%s\"} %d\n", resources[r], capacity[r] - free_amount[r]);
+    }
+    write_metric_header(out, "nexos_processes", "Active process table slots.", "gauge");
+    fprintf(out, "nexos_processes %d\n", process_count);
+    
+    // Histograms with cumulative buckets in seconds
+    for (int h = 0; h < NUM_METRIC_HISTOGRAMS; h++) {
+        const char* name = metric_histogram_names[h][0];
+        write_metric_header(out, name, metric_histogram_names[h][1], "histogram");
+        unsigned long long cumulative = 0;
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            cumulative += sum_shards(offsetof(MetricShard, buckets) +
+                                     (h * HISTOGRAM_BUCKETS + b) * sizeof(unsigned long long));
+            if (b < HISTOGRAM_BUCKETS - 1) {
+                fprintf(out, "%s_bucket{le=\"%.9g\"} %llu\n", name, (double)(1ULL << (b + 10)) / 1e9, cumulative);
+            }
+        }
+        fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, cumulative);
+        fprintf(out, "%s_sum %.9f\n", name,
+                sum_shards(offsetof(MetricShard, sums_ns) + h * sizeof(unsigned long long)) / 1e9);
+        fprintf(out, "%s_count %llu\n", name, cumulative);
+    }
+}
+
+// Write the metrics next to --metrics-file and rename them over it, so a
+// scraper never sees a half-written file
+int export_metrics_file() {
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", metrics_path);
+    
+    FILE* out = fopen(temporary, "w");
+    if (out == NULL) {
+        return -1;
+    }
+    write_metrics(out);
+    if (fclose(out) != 0 || rename(temporary, metrics_path) != 0) {
+        unlink(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+static void* metrics_loop(void* arg __attribute__((unused))) {
+    pthread_mutex_lock(&metrics_mutex);
+    while (metrics_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += metrics_interval_ms / 1000;
+        deadline.tv_nsec += (long)(metrics_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&metrics_cond, &metrics_mutex, &deadline);
+        
+        pthread_mutex_unlock(&metrics_mutex);
+        export_metrics_file();
+        pthread_mutex_lock(&metrics_mutex);
+    }
+    pthread_mutex_unlock(&metrics_mutex);
+    return NULL;
+}
+
+void start_metrics_exporter() {
+    if (metrics_path == NULL) {
+        return;
+    }
+    if (export_metrics_file() != 0) {
+        perror(metrics_path);
+    }
+    
+    metrics_running = 1;
+    if (pthread_create(&metrics_thread, NULL, metrics_loop, NULL) != 0) {
+        perror("Failed to create metrics thread");
+        metrics_running = 0;
+    }
+}
+
+// Stop the exporter; the file keeps the final values
+void stop_metrics_exporter() {
+    pthread_mutex_lock(&metrics_mutex);
+    int running = metrics_running;
+    metrics_running = 0;
+    pthread_cond_signal(&metrics_cond);
+    pthread_mutex_unlock(&metrics_mutex);
+    
+    if (running) {
+        pthread_join(metrics_thread, NULL);
+        export_metrics_file();
+    }
+}
+
+// ##########################################
+// TRACING
+// ##########################################
+// With --trace-file every thread records scheduler and lifecycle events in
+// its own ring buffer: a timestamp and a plain store, no lock and no shared
+// cache line. The newest TRACE_RING_EVENTS events per thread are written as
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev) at shutdown, on
+// SIGUSR1 and by the batch 'trace' command. A core's ring outlives its
+// worker: a worker started again after retiring records into the ring of
+// the previous one, so the MAX_TRACE_RINGS rings are not used up by worker
+// churn. A thread that finds no ring left records nothing. On x86 events are stamped with
+// the TSC, which is cheaper to read than clock_gettime; a dump converts the
+// ticks to nanoseconds by comparing both clocks since tracing started.
+
+static const struct {
+    const char* name;
+    const char* category;
+    const char* args[2];
+} trace_event_info[NUM_TRACE_EVENTS] = {
+    { "enqueue", "sched", { "level", "core" } },
+    { "dequeue", "sched", { "level", "core" } },
+    { "dispatch", "sched", { "core", "waited_us" } },
+    { "preempt", "sched", { "core", NULL } },
+    { "minimize", "process", { NULL, NULL } },
+    { "resume", "process", { NULL, NULL } },
+    { "exit", "process", { "status", NULL } },
+    { "terminate", "process", { NULL, NULL } },
+    { "alloc", "resources", { "ram_mb", "hdd_gb" } },
+    { "free", "resources", { "ram_mb", "hdd_gb" } }
+};
+
+static __thread TraceRing* thread_ring = NULL;
+static __thread const char* thread_trace_name = NULL;
+static __thread int thread_trace_core = -1;        // Core whose worker this thread is, or -1
+
+// Marks a thread that got no ring, so it does not ask again for every event
+static TraceRing no_trace_ring;
+
+// The ring each core's workers record into, created by the first of them
+static TraceRing* core_trace_rings[MAX_WORKER_QUEUES];
+
+static inline long long trace_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (long long)__builtin_ia32_rdtsc();
+#else
+    return monotonic_ns();
+#endif
+}
+
+void start_tracing() {
+    if (trace_file_path == NULL) {
+        return;
+    }
+    trace_start_ns = monotonic_ns();
+    trace_start_ticks = trace_clock();
+    __atomic_store_n(&tracing_enabled, 1, __ATOMIC_RELEASE);
+    trace_name_thread("main");
+}
+
+// Label the calling thread in the trace; the string must stay valid
+void trace_name_thread(const char* name) {
+    thread_trace_name = name;
+    if (thread_ring != NULL && thread_ring != &no_trace_ring) {
+        snprintf(thread_ring->name, sizeof(thread_ring->name), "%s", name);
+    }
+}
+
+// The calling thread is the worker of core; it records into the core's ring
+void trace_attach_core(int core, const char* name) {
+    thread_trace_core = core;
+    trace_name_thread(name);
+}
+
+// Take the next unused ring; the count never passes MAX_TRACE_RINGS
+static TraceRing* claim_trace_ring() {
+    int index = __atomic_load_n(&trace_ring_count, __ATOMIC_RELAXED);
+    do {
+        if (index >= MAX_TRACE_RINGS) {
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&trace_ring_count, &index, index + 1, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    TraceEvent* events = calloc(TRACE_RING_EVENTS, sizeof(TraceEvent));
+    __atomic_store_n(&trace_rings[index].events, events, __ATOMIC_RELEASE);
+    return events != NULL ? &trace_rings[index] : NULL;
+}
+
+static TraceRing* trace_ring() {
+    if (thread_ring == NULL) {
+        TraceRing* ring = NULL;
+        if (thread_trace_core >= 0) {
+            ring = __atomic_load_n(&core_trace_rings[thread_trace_core], __ATOMIC_ACQUIRE);
+        }
+        if (ring == NULL) {
+            ring = claim_trace_ring();
+            if (ring != NULL && thread_trace_core >= 0) {
+                __atomic_store_n(&core_trace_rings[thread_trace_core], ring, __ATOMIC_RELEASE);
+            }
+        }
+        if (ring == NULL) {
+            thread_ring = &no_trace_ring;
+            return NULL;
+        }
+        ring->tid = (int)syscall(SYS_gettid);
+        snprintf(ring->name, sizeof(ring->name), "%s",
+                 thread_trace_name != NULL ? thread_trace_name : "thread");
+        thread_ring = ring;
+    }
+    return thread_ring != &no_trace_ring ? thread_ring : NULL;
+}
+
+static void trace_record(TraceEventType type, long long dur_ns, int pid, int arg0, int arg1) {
+    TraceRing* ring = trace_ring();
+    if (ring == NULL) {
+        return;
+    }
+    unsigned long long head = ring->head;
+    TraceEvent* event = &ring->events[head & (TRACE_RING_EVENTS - 1)];
+    event->ticks = trace_clock();
+    event->dur_ns = dur_ns;
+    event->type = type;
+    event->pid = pid;
+    event->args[0] = arg0;
+    event->args[1] = arg1;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void trace_event(TraceEventType type, int pid, int arg0, int arg1) {
+    if (!__atomic_load_n(&tracing_enabled, __ATOMIC_RELAXED)) {
+        return;
+    }
+    trace_record(type, 0, pid, arg0, arg1);
+}
+
+// A complete event that started at start_ns and ends now
+void trace_span(TraceEventType type, long long start_ns, int pid, int arg0, int arg1) {
+    if (!__atomic_load_n(&tracing_enabled, __ATOMIC_RELAXED)) {
+        return;
+    }
+    trace_record(type, monotonic_ns() - start_ns, pid, arg0, arg1);
+}
+
+// Every event follows its thread's metadata event, so it always needs a comma
+static void write_trace_event(FILE* out, const TraceRing* ring, const TraceEvent* event,
+                              double ns_per_tick) {
+    int type = event->type < 0 || event->type >= NUM_TRACE_EVENTS ? TRACE_ENQUEUE : event->type;
+    
+    fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"%s\",",
+            trace_event_info[type].name, trace_event_info[type].category);
+    if (type == TRACE_DISPATCH) {
+        fprintf(out, "\"ph\":\"X\",\"dur\":%.3f,", event->dur_ns / 1000.0);
+    } else {
+        fprintf(out, "\"ph\":\"i\",\"s\":\"t\",");
+    }
+    double ts_ns = (event->ticks - trace_start_ticks) * ns_per_tick - event->dur_ns;
+    fprintf(out, "\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{",
+            ts_ns / 1000.0, (int)getpid(), ring->tid);
+    
+    int comma = 0;
+    if (type != TRACE_ALLOC && type != TRACE_FREE) {
+        fprintf(out, "\"pid\":%d", event->pid);
+        comma = 1;
+    }
+    for (int a = 0; a < 2; a++) {
+        if (trace_event_info[type].args[a] != NULL) {
+            fprintf(out, "%s\"%s\":%d", comma ? "," : "", trace_event_info[type].args[a], event->args[a]);
+            comma = 1;
+        }
+    }
+    fprintf(out, "}}");
+}
+
+// Dump every ring as Chrome trace JSON; recording goes on meanwhile
+void write_trace(FILE* out) {
+    int first = 1;
+    int rings = __atomic_load_n(&trace_ring_count, __ATOMIC_ACQUIRE);
+    long long elapsed_ticks = trace_clock() - trace_start_ticks;
+    long long elapsed_ns = monotonic_ns() - trace_start_ns;
+    double ns_per_tick = elapsed_ticks > 0 && elapsed_ns > 0 ? (double)elapsed_ns / elapsed_ticks : 1.0;
+    
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (int r = 0; r < rings; r++) {
+        TraceRing* ring = &trace_rings[r];
+        // Claimed rings get their events right after the count moved
+        if (__atomic_load_n(&ring->events, __ATOMIC_ACQUIRE) == NULL) {
+            continue;
+        }
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}", first ? "" : ",", (int)getpid(), ring->tid, ring->name);
+        first = 0;
+        
+        unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long long tail = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (unsigned long long i = tail; i < head; i++) {
+            TraceEvent event = ring->events[i & (TRACE_RING_EVENTS - 1)];
+            // The owner may have lapped us while we copied this slot
+            if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= i + TRACE_RING_EVENTS) {
+                continue;
+            }
+            write_trace_event(out, ring, &event, ns_per_tick);
+        }
+    }
+    fprintf(out, "\n]}\n");
+}
+
+// Write the trace to path through a temporary file, like the metrics
+int export_trace_file(const char* path) {
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    
+    pthread_mutex_lock(&trace_mutex);
+    FILE* out = fopen(temporary, "w");
+    if (out == NULL) {
+        pthread_mutex_unlock(&trace_mutex);
+        return -1;
+    }
+    write_trace(out);
+    int result = 0;
+    if (fclose(out) != 0 || rename(temporary, path) != 0) {
+        unlink(temporary);
+        result = -1;
+    }
+    pthread_mutex_unlock(&trace_mutex);
+    return result;
+}
+
+// Final dump at shutdown, after the workers and the supervisor stopped
+void stop_tracing() {
+    if (!tracing_enabled) {
+        return;
+    }
+    __atomic_store_n(&tracing_enabled, 0, __ATOMIC_RELEASE);
+    if (export_trace_file(trace_file_path) != 0) {
+        perror(trace_file_path);
+    }
+    
+    for (int r = 0; r < trace_ring_count; r++) {
+        free(trace_rings[r].events);
+        trace_rings[r].events = NULL;
+    }
+}
+
+// ##########################################
+// RESOURCE ACCOUNTING
+// ##########################################
+// Free RAM, HDD and cores live in one 64-bit word that is updated with CAS,
+// so admission never takes a lock and a launch gets all three or nothing.
+// Layout: RAM MB in bits 0-31 (signed, measured usage may overdraw it),
+// HDD GB in bits 32-51, cores in bits 52-63.
+
+#define POOL_HDD_SHIFT 32
+#define POOL_CORES_SHIFT 52
+#define POOL_HDD_MAX ((1 << 20) - 1)
+#define POOL_CORES_MAX ((1 << 12) - 1)
+
+static uint64_t pack_resources(ResourceCounts counts) {
+    return (uint64_t)(uint32_t)counts.ram_mb |
+           ((uint64_t)counts.hdd_gb << POOL_HDD_SHIFT) |
+           ((uint64_t)counts.cores << POOL_CORES_SHIFT);
+}
+
+static ResourceCounts unpack_resources(uint64_t word) {
+    ResourceCounts counts;
+    counts.ram_mb = (int32_t)(uint32_t)word;
+    counts.hdd_gb = (int)((word >> POOL_HDD_SHIFT) & POOL_HDD_MAX);
+    counts.cores = (int)(word >> POOL_CORES_SHIFT);
+    return counts;
+}
+
+void init_resource_pool(int ram_mb, int hdd_gb, int cores) {
+    if (hdd_gb > POOL_HDD_MAX || cores > POOL_CORES_MAX) {
+        printf("WARNING: At most %d GB HDD and %d cores are supported.\n", POOL_HDD_MAX, POOL_CORES_MAX);
+        hdd_gb = hdd_gb > POOL_HDD_MAX ? POOL_HDD_MAX : hdd_gb;
+        cores = cores > POOL_CORES_MAX ? POOL_CORES_MAX : cores;
+    }
+    ResourceCounts counts = { ram_mb, hdd_gb, cores };
+    __atomic_store_n(&hardware.available, pack_resources(counts), __ATOMIC_RELEASE);
+}
+
+ResourceCounts available_resources() {
+    return unpack_resources(__atomic_load_n(&hardware.available, __ATOMIC_ACQUIRE));
+}
+
+// Take all three amounts from the pool or nothing; returns 0 if any is short
+int take_resources(int ram_mb, int hdd_gb, int cores) {
+    uint64_t word = __atomic_load_n(&hardware.available, __ATOMIC_ACQUIRE);
+    for (;;) {
+        ResourceCounts counts = unpack_resources(word);
+        if (counts.ram_mb < ram_mb || counts.hdd_gb < hdd_gb || counts.cores < cores) {
+            return 0;
+        }
+        counts.ram_mb -= ram_mb;
+        counts.hdd_gb -= hdd_gb;
+        counts.cores -= cores;
+        // On failure word is reloaded and the check is repeated
+        if (__atomic_compare_exchange_n(&hardware.available, &word, pack_resources(counts), 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return 1;
+        }
+    }
+}
+
+// Add to the pool unconditionally; a negative RAM delta charges measured usage
+void adjust_resources(int ram_mb, int hdd_gb, int cores) {
+    uint64_t word = __atomic_load_n(&hardware.available, __ATOMIC_ACQUIRE);
+    for (;;) {
+        ResourceCounts counts = unpack_resources(word);
+        counts.ram_mb += ram_mb;
+        counts.hdd_gb += hdd_gb;
+        counts.cores += cores;
+        if (__atomic_compare_exchange_n(&hardware.available, &word, pack_resources(counts), 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+    }
+}
+
+// Reserve RAM and HDD for one task; on failure nothing is held. No core is
+// reserved: the dispatcher's CPU slots ration CPU time between tasks, and
+// the pool's cores are only handed out by explicit requests.
+int reserve_resources(ResourceReservation* reservation, int ram_required, int hdd_required) {
+    reservation->state = 0;
+    reservation->ram_base = -1;
+    reservation->ram_mb = ram_required;
+    reservation->hdd_gb = hdd_required;
+    
+    if (!take_resources(ram_required, hdd_required, 0)) {
+        return 0; // Not enough resources
+    }
+    
+    // Enough RAM in total is not enough: the task needs one contiguous block
+    pthread_mutex_lock(&ram_allocator_mutex);
+    int base = ram_alloc(&ram_allocator, ram_required);
+    RamStats stats;
+    if (base < 0) {
+        ram_allocator_stats(&ram_allocator, &stats);
+    }
+    pthread_mutex_unlock(&ram_allocator_mutex);
+    
+    if (base < 0) {
+        adjust_resources(ram_required, hdd_required, 0);
+        printf("ERROR: No contiguous %d MB block of RAM (largest free block: %d MB)\n",
+               ram_required, stats.largest_free_mb);
+        return 0;
+    }
+    
+    reservation->ram_base = base;
+    __atomic_store_n(&reservation->state, RESERVATION_HELD | ram_required, __ATOMIC_RELEASE);
+    trace_event(TRACE_ALLOC, 0, ram_required, hdd_required);
+    return 1; // Resources allocated successfully
+}
+
+// Give a reservation back; only the first call for a reservation returns anything
+int release_reservation(ResourceReservation* reservation) {
+    int state = __atomic_exchange_n(&reservation->state, 0, __ATOMIC_ACQ_REL);
+    if ((state & RESERVATION_HELD) == 0) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&ram_allocator_mutex);
+    ram_free(&ram_allocator, reservation->ram_base, reservation->ram_mb);
+    pthread_mutex_unlock(&ram_allocator_mutex);
+    reservation->ram_base = -1;
+    
+    adjust_resources(state & ~RESERVATION_HELD, reservation->hdd_gb, 0);
+    trace_event(TRACE_FREE, 0, state & ~RESERVATION_HELD, reservation->hdd_gb);
+    return 1;
+}
+
+// Raise the RAM charged to a held reservation to used_mb
+void charge_reservation(ResourceReservation* reservation, int used_mb) {
+    int state = __atomic_load_n(&reservation->state, __ATOMIC_ACQUIRE);
+    while ((state & RESERVATION_HELD) && used_mb > (state & ~RESERVATION_HELD)) {
+        // The charge and a concurrent release cannot both see the old amount
+        if (__atomic_compare_exchange_n(&reservation->state, &state, RESERVATION_HELD | used_mb, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            adjust_resources(-(used_mb - (state & ~RESERVATION_HELD)), 0, 0);
+            return;
+        }
+    }
+}
+
+// MB of RAM a reservation holds: the declared size or the measured peak
+int reservation_charged_mb(const ResourceReservation* reservation) {
+    return __atomic_load_n(&reservation->state, __ATOMIC_ACQUIRE) & ~RESERVATION_HELD;
+}
+
+void free_resources(int index) {
+    if (release_reservation(&process_table[index].reservation)) {
+        finish_task_claim(index);
+    }
+}
+
+// ##########################################
+// DEADLOCK AVOIDANCE
+// ##########################################
+// Every task declares a maximum claim of RAM, HDD and cores and acquires it
+// piecewise. In avoidance mode a request is granted only if the Banker's
+// safety check still finds an order in which every process can finish.
+//
+// The check is incremental. The table keeps the safe sequence it found last;
+// registering appends to it, and releases and exits never invalidate it. A
+// grant to P only lowers what the processes ahead of P in the sequence can
+// count on, so only they are checked:
+//   - P's remaining need fits the free resources: P can run first, it moves
+//     to the front and nothing else is checked
+//   - every process ahead of P still fits: the sequence stands
+//   - otherwise a full check sorts the needs per resource, walks each order
+//     once and builds a new sequence, O(n log n) instead of O(n^2)
+//
+// Detection mode grants whatever fits and finds deadlocks on demand in the
+// wait-for graph, collapsed through the three resource nodes so it has
+// O(processes x resource types) edges.
+
+#define CLAIM_UNUSED 0
+#define CLAIM_ACTIVE 1
+#define CLAIM_WAITING 2
+
+#define CLAIM_AT(table, field, id, r) ((table)->field[(id) * NUM_RESOURCE_TYPES + (r)])
+
+static int claim_need(const ClaimTable* table, int id, int r) {
+    return CLAIM_AT(table, max, id, r) - CLAIM_AT(table, alloc, id, r);
+}
+
+static void sequence_unlink(ClaimTable* table, int id) {
+    int prev = table->seq_prev[id], next = table->seq_next[id];
+    if (prev != -1) {
+        table->seq_next[prev] = next;
+    } else {
+        table->seq_head = next;
+    }
+    if (next != -1) {
+        table->seq_prev[next] = prev;
+    } else {
+        table->seq_tail = prev;
+    }
+}
+
+static void sequence_push(ClaimTable* table, int id, int at_front) {
+    if (at_front) {
+        table->seq_prev[id] = -1;
+        table->seq_next[id] = table->seq_head;
+        if (table->seq_head != -1) {
+            table->seq_prev[table->seq_head] = id;
+        } else {
+            table->seq_tail = id;
+        }
+        table->seq_head = id;
+    } else {
+        table->seq_next[id] = -1;
+        table->seq_prev[id] = table->seq_tail;
+        if (table->seq_tail != -1) {
+            table->seq_next[table->seq_tail] = id;
+        } else {
+            table->seq_head = id;
+        }
+        table->seq_tail = id;
+    }
+}
+
+static int compare_sort_keys(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+void claim_table_init(ClaimTable* table, int capacity, const int total[], DeadlockMode mode) {
+    memset(table, 0, sizeof(*table));
+    table->mode = mode;
+    table->capacity = capacity;
+    table->seq_head = -1;
+    table->seq_tail = -1;
+    memcpy(table->total, total, sizeof(table->total));
+    memcpy(table->available, total, sizeof(table->available));
+    
+    size_t cells = (size_t)capacity * NUM_RESOURCE_TYPES;
+    table->max = calloc(cells, sizeof(int));
+    table->alloc = calloc(cells, sizeof(int));
+    table->pending = calloc(cells, sizeof(int));
+    table->status = calloc(capacity, 1);
+    table->seq_next = malloc(capacity * sizeof(int));
+    table->seq_prev = malloc(capacity * sizeof(int));
+    table->counts = calloc(capacity, sizeof(int));
+    table->stack = malloc((capacity + NUM_RESOURCE_TYPES) * sizeof(int));
+    table->sequence = malloc(capacity * sizeof(int));
+    table->sort_keys = malloc(capacity * sizeof(uint64_t));
+    int failed = table->max == NULL || table->alloc == NULL || table->pending == NULL ||
+                 table->status == NULL || table->seq_next == NULL || table->seq_prev == NULL ||
+                 table->counts == NULL || table->stack == NULL || table->sequence == NULL ||
+                 table->sort_keys == NULL;
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        table->order[r] = malloc(capacity * sizeof(int));
+        table->blocked[r] = malloc(capacity * sizeof(int));
+        failed |= table->order[r] == NULL || table->blocked[r] == NULL;
+    }
+    if (failed) {
+        perror("Failed to allocate the claim table");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void claim_table_destroy(ClaimTable* table) {
+    free(table->max);
+    free(table->alloc);
+    free(table->pending);
+    free(table->status);
+    free(table->seq_next);
+    free(table->seq_prev);
+    free(table->counts);
+    free(table->stack);
+    free(table->sequence);
+    free(table->sort_keys);
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        free(table->order[r]);
+        free(table->blocked[r]);
+    }
+    memset(table, 0, sizeof(*table));
+}
+
+// Declare the maximum claim of a process; claims beyond the machine are capped.
+// A new process holds nothing, so it can always finish last.
+void claim_register(ClaimTable* table, int id, const int max[]) {
+    if (table->status[id] != CLAIM_UNUSED) {
+        claim_finish(table, id);
+    }
+    
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        CLAIM_AT(table, max, id, r) = max[r] < table->total[r] ? max[r] : table->total[r];
+        CLAIM_AT(table, alloc, id, r) = 0;
+        CLAIM_AT(table, pending, id, r) = 0;
+    }
+    table->status[id] = CLAIM_ACTIVE;
+    table->active_count++;
+    sequence_push(table, id, 0);
+}
+
+// Full Banker's safety check; on success the table keeps the sequence it found
+int claim_is_safe(ClaimTable* table) {
+    int count = table->active_count;
+    int work[NUM_RESOURCE_TYPES];
+    int next[NUM_RESOURCE_TYPES] = { 0 };
+    int ready = 0, finished = 0;
+    
+    memcpy(work, table->available, sizeof(work));
+    
+    // Order the processes by need, per resource
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        int i = 0;
+        for (int id = table->seq_head; id != -1; id = table->seq_next[id]) {
+            table->sort_keys[i++] = ((uint64_t)claim_need(table, id, r) << 32) | (uint32_t)id;
+        }
+        qsort(table->sort_keys, count, sizeof(uint64_t), compare_sort_keys);
+        for (i = 0; i < count; i++) {
+            table->order[r][i] = (int)(uint32_t)table->sort_keys[i];
+        }
+    }
+    for (int id = table->seq_head; id != -1; id = table->seq_next[id]) {
+        table->counts[id] = 0;
+    }
+    
+    // A process can finish once its need fits work in every resource; each
+    // order is walked once because work only grows
+    while (finished < count) {
+        // Once work covers the largest need of every resource, all can finish
+        int covered = 1;
+        for (int r = 0; r < NUM_RESOURCE_TYPES && covered; r++) {
+            covered = claim_need(table, table->order[r][count - 1], r) <= work[r];
+        }
+        if (covered) {
+            for (int id = table->seq_head; id != -1; id = table->seq_next[id]) {
+                if (table->counts[id] >= 0) {
+                    table->sequence[finished++] = id;
+                }
+            }
+            break;
+        }
+        
+        for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+            const int* order = table->order[r];
+            while (next[r] < count && claim_need(table, order[next[r]], r) <= work[r]) {
+                int id = order[next[r]++];
+                if (++table->counts[id] == NUM_RESOURCE_TYPES) {
+                    table->stack[ready++] = id;
+                }
+            }
+        }
+        if (ready == 0) {
+            return 0;
+        }
+        int id = table->stack[--ready];
+        for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+            work[r] += CLAIM_AT(table, alloc, id, r);
+        }
+        table->counts[id] = -1; // Finished
+        table->sequence[finished++] = id;
+    }
+    
+    table->seq_head = table->seq_tail = -1;
+    for (int i = 0; i < count; i++) {
+        sequence_push(table, table->sequence[i], 0);
+    }
+    return 1;
+}
+
+// After a grant to id: can everything ahead of id in the sequence still finish?
+static int claim_prefix_is_safe(const ClaimTable* table, int id) {
+    int work[NUM_RESOURCE_TYPES];
+    memcpy(work, table->available, sizeof(work));
+    
+    for (int ahead = table->seq_head; ahead != id; ahead = table->seq_next[ahead]) {
+        for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+            if (claim_need(table, ahead, r) > work[r]) {
+                return 0;
+            }
+        }
+        for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+            work[r] += CLAIM_AT(table, alloc, ahead, r);
+        }
+    }
+    return 1;
+}
+
+static void claim_apply(ClaimTable* table, int id, const int amount[], int sign) {
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        CLAIM_AT(table, alloc, id, r) += sign * amount[r];
+        table->available[r] -= sign * amount[r];
+    }
+}
+
+// Ask for more of the claim; CLAIM_WAIT leaves the request pending
+ClaimResult claim_request(ClaimTable* table, int id, const int request[]) {
+    table->requests++;
+    
+    int fits = 1;
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        if (request[r] < 0 || request[r] > claim_need(table, id, r)) {
+            return CLAIM_INVALID;
+        }
+        fits &= request[r] <= table->available[r];
+    }
+    
+    int granted = fits;
+    if (fits) {
+        claim_apply(table, id, request, 1);
+        
+        if (table->mode == DEADLOCK_AVOID) {
+            int fast = 1;
+            for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+                fast &= claim_need(table, id, r) <= table->available[r];
+            }
+            if (fast) {
+                sequence_unlink(table, id);
+                sequence_push(table, id, 1);
+                table->fast_paths++;
+            } else {
+                long long start = monotonic_ns();
+                granted = claim_prefix_is_safe(table, id);
+                if (granted) {
+                    table->prefix_checks++;
+                } else {
+                    granted = claim_is_safe(table);
+                    table->full_checks++;
+                }
+                table->check_ns += monotonic_ns() - start;
+                if (!granted) {
+                    claim_apply(table, id, request, -1);
+                }
+            }
+        }
+    }
+    
+    if (!granted) {
+        memcpy(&CLAIM_AT(table, pending, id, 0), request, sizeof(int) * NUM_RESOURCE_TYPES);
+        table->status[id] = CLAIM_WAITING;
+        table->waits++;
+        return CLAIM_WAIT;
+    }
+    
+    memset(&CLAIM_AT(table, pending, id, 0), 0, sizeof(int) * NUM_RESOURCE_TYPES);
+    table->status[id] = CLAIM_ACTIVE;
+    table->grants++;
+    return CLAIM_GRANTED;
+}
+
+// Give back part of an allocation; amounts are capped at what is held
+void claim_release(ClaimTable* table, int id, const int amount[]) {
+    int capped[NUM_RESOURCE_TYPES];
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        int held = CLAIM_AT(table, alloc, id, r);
+        capped[r] = amount[r] < 0 ? 0 : (amount[r] > held ? held : amount[r]);
+    }
+    claim_apply(table, id, capped, -1);
+}
+
+// The process is gone: return everything and drop its claim
+void claim_finish(ClaimTable* table, int id) {
+    if (table->status[id] == CLAIM_UNUSED) {
+        return;
+    }
+    
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        table->available[r] += CLAIM_AT(table, alloc, id, r);
+        CLAIM_AT(table, alloc, id, r) = 0;
+        CLAIM_AT(table, pending, id, r) = 0;
+    }
+    sequence_unlink(table, id);
+    table->status[id] = CLAIM_UNUSED;
+    table->active_count--;
+}
+
+// Waiting processes that can never be granted; flags them in deadlocked if given.
+// Nodes are the waiters and one node per resource type. A waiter points to
+// the resources its pending request does not fit, a resource to the waiters
+// holding some of it. Peeling off nodes without out-edges leaves exactly the
+// waiters on or behind a cycle. With several units per resource a cycle is
+// necessary but not sufficient, so a flagged waiter may still get through
+// when a running process releases enough.
+int detect_deadlock(ClaimTable* table, unsigned char* deadlocked) {
+    int* out_degree = table->counts;
+    int blocked_count[NUM_RESOURCE_TYPES] = { 0 };
+    int resource_degree[NUM_RESOURCE_TYPES] = { 0 };
+    int queued = 0, waiters = 0, released = 0;
+    
+    for (int id = table->seq_head; id != -1; id = table->seq_next[id]) {
+        out_degree[id] = 0;
+        if (table->status[id] != CLAIM_WAITING) {
+            continue;
+        }
+        waiters++;
+        for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+            if (CLAIM_AT(table, pending, id, r) > table->available[r]) {
+                table->blocked[r][blocked_count[r]++] = id;
+                out_degree[id]++;
+            }
+            if (CLAIM_AT(table, alloc, id, r) > 0) {
+                resource_degree[r]++;
+            }
+        }
+        if (out_degree[id] == 0) {
+            table->stack[queued++] = id; // Fits already, only needs a retry
+        }
+    }
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        if (resource_degree[r] == 0) {
+            table->stack[queued++] = -1 - r;
+        }
+    }
+    
+    while (queued > 0) {
+        int node = table->stack[--queued];
+        if (node < 0) {
+            // Nobody waiting holds this resource: its waiters are unblocked
+            int r = -1 - node;
+            for (int i = 0; i < blocked_count[r]; i++) {
+                if (--out_degree[table->blocked[r][i]] == 0) {
+                    table->stack[queued++] = table->blocked[r][i];
+                }
+            }
+        } else {
+            released++;
+            for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+                if (CLAIM_AT(table, alloc, node, r) > 0 && --resource_degree[r] == 0) {
+                    table->stack[queued++] = -1 - r;
+                }
+            }
+        }
+    }
+    
+    if (deadlocked != NULL) {
+        for (int id = table->seq_head; id != -1; id = table->seq_next[id]) {
+            deadlocked[id] = table->status[id] == CLAIM_WAITING && out_degree[id] > 0;
+        }
+    }
+    return waiters - released;
+}
+
+const char* deadlock_mode_name(DeadlockMode mode) {
+    return mode == DEADLOCK_AVOID ? "Banker's avoidance" : "Wait-for graph detection";
+}
+
+static void counts_to_vector(ResourceCounts counts, int vector[]) {
+    vector[RESOURCE_RAM] = counts.ram_mb;
+    vector[RESOURCE_HDD] = counts.hdd_gb;
+    vector[RESOURCE_CORES] = counts.cores;
+}
+
+// Register a task's claim and grant what its reservation already took.
+// Returns 0 if the Banker's check refuses the launch.
+int admit_task_claim(int index, int task_id) {
+    const Task* task = &available_tasks[task_id];
+    int max[NUM_RESOURCE_TYPES] = { task->max_ram, task->max_hdd, task->max_cores };
+    int initial[NUM_RESOURCE_TYPES] = { task->ram_required, task->hdd_required, 0 };
+    
+    pthread_mutex_lock(&claim_mutex);
+    for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+        if (max[r] < initial[r]) {
+            max[r] = initial[r];
+        }
+    }
+    claim_register(&claim_table, index, max);
+    ClaimResult result = claim_request(&claim_table, index, initial);
+    if (result != CLAIM_GRANTED) {
+        claim_finish(&claim_table, index);
+    }
+    memset(&process_table[index].granted, 0, sizeof(ResourceCounts));
+    pthread_mutex_unlock(&claim_mutex);
+    
+    if (result != CLAIM_GRANTED) {
+        metric_add(METRIC_ADMISSION_REJECTIONS, 1);
+        if (claim_table.mode == DEADLOCK_AVOID) {
+            printf("ERROR: Starting %s now could deadlock the system!\n", task->name);
+        } else {
+            printf("ERROR: Not enough system resources to start %s!\n", task->name);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+// Grant a pending or new request: the claim engine decides, the pool pays.
+// Called with claim_mutex held.
+static ClaimResult grant_claim(int index, const int request[]) {
+    ClaimResult result = claim_request(&claim_table, index, request);
+    if (result != CLAIM_GRANTED) {
+        return result;
+    }
+    
+    // Measured memory use may have overdrawn the pool behind the engine's back
+    if (!take_resources(request[RESOURCE_RAM], request[RESOURCE_HDD], request[RESOURCE_CORES])) {
+        claim_release(&claim_table, index, request);
+        memcpy(&CLAIM_AT(&claim_table, pending, index, 0), request, sizeof(int) * NUM_RESOURCE_TYPES);
+        claim_table.status[index] = CLAIM_WAITING;
+        return CLAIM_WAIT;
+    }
+    
+    process_table[index].granted.ram_mb += request[RESOURCE_RAM];
+    process_table[index].granted.hdd_gb += request[RESOURCE_HDD];
+    process_table[index].granted.cores += request[RESOURCE_CORES];
+    write_task_limits(index);
+    return CLAIM_GRANTED;
+}
+
+// Retry every pending request after resources came back
+void grant_waiting_requests() {
+    pthread_mutex_lock(&claim_mutex);
+    // Granting reorders the need lists, so walk the slots instead
+    for (int id = 0; id < process_table_used; id++) {
+        if (claim_table.status[id] == CLAIM_WAITING) {
+            int request[NUM_RESOURCE_TYPES];
+            memcpy(request, &CLAIM_AT(&claim_table, pending, id, 0), sizeof(request));
+            grant_claim(id, request);
+        }
+    }
+    pthread_mutex_unlock(&claim_mutex);
+}
+
+// Ask for more resources on behalf of a running task
+ClaimResult request_task_resources(int index, ResourceCounts amount) {
+    int request[NUM_RESOURCE_TYPES];
+    counts_to_vector(amount, request);
+    
+    pthread_mutex_lock(&claim_mutex);
+    ClaimResult result = grant_claim(index, request);
+    pthread_mutex_unlock(&claim_mutex);
+    return result;
+}
+
+// Give back resources a task got from request_task_resources
+void release_task_resources(int index, ResourceCounts amount) {
+    int release[NUM_RESOURCE_TYPES];
+    ResourceCounts* granted = &process_table[index].granted;
+    
+    pthread_mutex_lock(&claim_mutex);
+    amount.ram_mb = amount.ram_mb < granted->ram_mb ? amount.ram_mb : granted->ram_mb;
+    amount.hdd_gb = amount.hdd_gb < granted->hdd_gb ? amount.hdd_gb : granted->hdd_gb;
+    amount.cores = amount.cores < granted->cores ? amount.cores : granted->cores;
+    granted->ram_mb -= amount.ram_mb;
+    granted->hdd_gb -= amount.hdd_gb;
+    granted->cores -= amount.cores;
+    write_task_limits(index);
+    counts_to_vector(amount, release);
+    claim_release(&claim_table, index, release);
+    adjust_resources(amount.ram_mb, amount.hdd_gb, amount.cores);
+    pthread_mutex_unlock(&claim_mutex);
+    
+    grant_waiting_requests();
+}
+
+// The task is gone: return its granted extras and drop its claim
+void finish_task_claim(int index) {
+    pthread_mutex_lock(&claim_mutex);
+    ResourceCounts* granted = &process_table[index].granted;
+    adjust_resources(granted->ram_mb, granted->hdd_gb, granted->cores);
+    memset(granted, 0, sizeof(*granted));
+    claim_finish(&claim_table, index);
+    pthread_mutex_unlock(&claim_mutex);
+    
+    grant_waiting_requests();
+}
+
+// ##########################################
+// RAM PLACEMENT
+// ##########################################
+// Tasks get a contiguous range of the simulated RAM. The fit algorithms keep
+// an address-ordered list of free extents and coalesce on free; the buddy
+// allocator rounds requests up to powers of two and merges free buddies.
+
+const char* ram_allocator_name(RamAllocatorType type) {
+    switch (type) {
+        case RAM_FIRST_FIT: return "First fit";
+        case RAM_BEST_FIT: return "Best fit";
+        case RAM_WORST_FIT: return "Worst fit";
+        case RAM_NEXT_FIT: return "Next fit";
+        case RAM_BUDDY: return "Buddy";
+    }
+    return "Unknown";
+}
+
+static int parse_ram_allocator(const char* name, RamAllocatorType* type) {
+    if (strcmp(name, "first") == 0) {
+        *type = RAM_FIRST_FIT;
+    } else if (strcmp(name, "best") == 0) {
+        *type = RAM_BEST_FIT;
+    } else if (strcmp(name, "worst") == 0) {
+        *type = RAM_WORST_FIT;
+    } else if (strcmp(name, "next") == 0) {
+        *type = RAM_NEXT_FIT;
+    } else if (strcmp(name, "buddy") == 0) {
+        *type = RAM_BUDDY;
+    } else {
+        fprintf(stderr, "Unknown RAM allocator: %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+static int ceil_order(int size) {
+    int order = 0;
+    while ((1 << order) < size) {
+        order++;
+    }
+    return order;
+}
+
+static void buddy_push(RamAllocator* ram, int start, int order) {
+    ram->free_order[start] = (signed char)order;
+    ram->buddy_prev[start] = -1;
+    ram->buddy_next[start] = ram->free_head[order];
+    if (ram->free_head[order] != -1) {
+        ram->buddy_prev[ram->free_head[order]] = start;
+    }
+    ram->free_head[order] = start;
+}
+
+static void buddy_unlink(RamAllocator* ram, int start) {
+    int order = ram->free_order[start];
+    int prev = ram->buddy_prev[start], next = ram->buddy_next[start];
+    if (prev != -1) {
+        ram->buddy_next[prev] = next;
+    } else {
+        ram->free_head[order] = next;
+    }
+    if (next != -1) {
+        ram->buddy_prev[next] = prev;
+    }
+    ram->free_order[start] = -1;
+}
+
+void ram_allocator_init(RamAllocator* ram, RamAllocatorType type, int total_mb) {
+    memset(ram, 0, sizeof(*ram));
+    ram->type = type;
+    ram->total_mb = total_mb;
+    ram->free_mb = total_mb;
+    ram->head = -1;
+    ram->rover = -1;
+    
+    if (type != RAM_BUDDY) {
+        // Free and allocated ranges alternate, so there are never more than
+        // total/2 + 1 holes
+        int nodes = total_mb / 2 + 2;
+        ram->extents = malloc(nodes * sizeof(FreeExtent));
+        ram->spare_nodes = malloc(nodes * sizeof(int));
+        if (ram->extents == NULL || ram->spare_nodes == NULL) {
+            perror("Failed to allocate RAM allocator");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = nodes - 1; i >= 0; i--) {
+            ram->spare_nodes[ram->spare_count++] = i;
+        }
+        if (total_mb > 0) {
+            int node = ram->spare_nodes[--ram->spare_count];
+            ram->extents[node] = (FreeExtent){ 0, total_mb, -1, -1 };
+            ram->head = node;
+        }
+        return;
+    }
+    
+    ram->max_order = ceil_order(total_mb > 0 ? total_mb : 1);
+    int units = 1 << ram->max_order;
+    ram->buddy_next = malloc(units * sizeof(int));
+    ram->buddy_prev = malloc(units * sizeof(int));
+    ram->free_order = malloc(units);
+    ram->alloc_order = malloc(units);
+    if (ram->buddy_next == NULL || ram->buddy_prev == NULL ||
+        ram->free_order == NULL || ram->alloc_order == NULL) {
+        perror("Failed to allocate RAM allocator");
+        exit(EXIT_FAILURE);
+    }
+    memset(ram->free_order, -1, units);
+    memset(ram->alloc_order, -1, units);
+    for (int order = 0; order < BUDDY_MAX_ORDERS; order++) {
+        ram->free_head[order] = -1;
+    }
+    
+    // RAM that is not a power of two is covered by the largest aligned
+    // blocks that fit; their buddies past the end never become free
+    for (int start = 0; start < total_mb; ) {
+        int order = ram->max_order;
+        while ((start & ((1 << order) - 1)) != 0 || start + (1 << order) > total_mb) {
+            order--;
+        }
+        buddy_push(ram, start, order);
+        start += 1 << order;
+    }
+}
+
+void ram_allocator_destroy(RamAllocator* ram) {
+    free(ram->extents);
+    free(ram->spare_nodes);
+    free(ram->buddy_next);
+    free(ram->buddy_prev);
+    free(ram->free_order);
+    free(ram->alloc_order);
+    memset(ram, 0, sizeof(*ram));
+}
+
+static void extent_remove(RamAllocator* ram, int node) {
+    FreeExtent* extent = &ram->extents[node];
+    if (extent->prev != -1) {
+        ram->extents[extent->prev].next = extent->next;
+    } else {
+        ram->head = extent->next;
+    }
+    if (extent->next != -1) {
+        ram->extents[extent->next].prev = extent->prev;
+    }
+    if (ram->rover == node) {
+        ram->rover = extent->next;
+    }
+    ram->spare_nodes[ram->spare_count++] = node;
+}
+
+// Place size_mb contiguous MB; returns the start or -1 if no hole fits
+int ram_alloc(RamAllocator* ram, int size_mb) {
+    long long start_ns = monotonic_ns();
+    int base = -1;
+    
+    if (size_mb <= 0) {
+        size_mb = 1;
+    }
+    
+    if (ram->type == RAM_BUDDY) {
+        int order = ceil_order(size_mb);
+        int found = order;
+        while (found <= ram->max_order && ram->free_head[found] == -1) {
+            found++;
+        }
+        if (found <= ram->max_order) {
+            base = ram->free_head[found];
+            buddy_unlink(ram, base);
+            // Split, returning the upper halves to the free lists
+            while (found > order) {
+                found--;
+                buddy_push(ram, base + (1 << found), found);
+            }
+            ram->alloc_order[base] = (signed char)order;
+            ram->allocated_mb += 1 << order;
+            ram->free_mb -= 1 << order;
+        }
+    } else {
+        int chosen = -1;
+        
+        if (ram->type == RAM_NEXT_FIT) {
+            int node = ram->rover != -1 ? ram->rover : ram->head;
+            for (int visited = 0; node != -1 || visited == 0; ) {
+                if (node == -1) {
+                    node = ram->head; // Wrap around once
+                    visited = 1;
+                    if (node == -1) {
+                        break;
+                    }
+                }
+                if (ram->extents[node].size >= size_mb) {
+                    chosen = node;
+                    break;
+                }
+                node = ram->extents[node].next;
+                if (node == ram->rover) {
+                    break;
+                }
+            }
+        } else {
+            for (int node = ram->head; node != -1; node = ram->extents[node].next) {
+                int size = ram->extents[node].size;
+                if (size < size_mb) {
+                    continue;
+                }
+                if (ram->type == RAM_FIRST_FIT) {
+                    chosen = node;
+                    break;
+                }
+                if (chosen == -1 ||
+                    (ram->type == RAM_BEST_FIT && size < ram->extents[chosen].size) ||
+                    (ram->type == RAM_WORST_FIT && size > ram->extents[chosen].size)) {
+                    chosen = node;
+                    if (ram->type == RAM_BEST_FIT && size == size_mb) {
+                        break; // Exact fit
+                    }
+                }
+            }
+        }
+        
+        if (chosen != -1) {
+            FreeExtent* extent = &ram->extents[chosen];
+            base = extent->start;
+            extent->start += size_mb;
+            extent->size -= size_mb;
+            ram->rover = chosen;
+            if (extent->size == 0) {
+                extent_remove(ram, chosen);
+            }
+            ram->allocated_mb += size_mb;
+            ram->free_mb -= size_mb;
+        }
+    }
+    
+    if (base >= 0) {
+        ram->allocations++;
+        ram->requested_mb += size_mb;
+    } else {
+        ram->failures++;
+    }
+    ram->alloc_ns += monotonic_ns() - start_ns;
+    return base;
+}
+
+// Return a range placed by ram_alloc
+void ram_free(RamAllocator* ram, int base, int size_mb) {
+    if (base < 0) {
+        return;
+    }
+    if (size_mb <= 0) {
+        size_mb = 1;
+    }
+    ram->requested_mb -= size_mb;
+    
+    if (ram->type == RAM_BUDDY) {
+        int order = ram->alloc_order[base];
+        if (order < 0) {
+            return;
+        }
+        ram->alloc_order[base] = -1;
+        ram->allocated_mb -= 1 << order;
+        ram->free_mb += 1 << order;
+        
+        // Merge with the buddy for as long as it is free and whole
+        while (order < ram->max_order) {
+            int buddy = base ^ (1 << order);
+            if (buddy >= ram->total_mb || ram->free_order[buddy] != order) {
+                break;
+            }
+            buddy_unlink(ram, buddy);
+            base = base < buddy ? base : buddy;
+            order++;
+        }
+        buddy_push(ram, base, order);
+        return;
+    }
+    
+    ram->allocated_mb -= size_mb;
+    ram->free_mb += size_mb;
+    
+    // Find the neighbours in address order
+    int prev = -1, next = ram->head;
+    while (next != -1 && ram->extents[next].start < base) {
+        prev = next;
+        next = ram->extents[next].next;
+    }
+    
+    if (prev != -1 && ram->extents[prev].start + ram->extents[prev].size == base) {
+        ram->extents[prev].size += size_mb;
+        if (next != -1 && base + size_mb == ram->extents[next].start) {
+            ram->extents[prev].size += ram->extents[next].size;
+            extent_remove(ram, next);
+        }
+        return;
+    }
+    if (next != -1 && base + size_mb == ram->extents[next].start) {
+        ram->extents[next].start = base;
+        ram->extents[next].size += size_mb;
+        return;
+    }
+    
+    int node = ram->spare_nodes[--ram->spare_count];
+    ram->extents[node] = (FreeExtent){ base, size_mb, prev, next };
+    if (prev != -1) {
+        ram->extents[prev].next = node;
+    } else {
+        ram->head = node;
+    }
+    if (next != -1) {
+        ram->extents[next].prev = node;
+    }
+}
+
+void ram_allocator_stats(const RamAllocator* ram, RamStats* stats) {
+    stats->free_mb = ram->free_mb;
+    stats->largest_free_mb = 0;
+    stats->holes = 0;
+    
+    if (ram->type == RAM_BUDDY) {
+        for (int order = 0; order <= ram->max_order; order++) {
+            for (int block = ram->free_head[order]; block != -1; block = ram->buddy_next[block]) {
+                stats->holes++;
+                stats->largest_free_mb = 1 << order;
+            }
+        }
+    } else {
+        for (int node = ram->head; node != -1; node = ram->extents[node].next) {
+            stats->holes++;
+            if (ram->extents[node].size > stats->largest_free_mb) {
+                stats->largest_free_mb = ram->extents[node].size;
+            }
+        }
+    }
+    
+    stats->external = ram->free_mb > 0 ? 1.0 - (double)stats->largest_free_mb / ram->free_mb : 0.0;
+    stats->internal = ram->allocated_mb > 0
+                    ? (double)(ram->allocated_mb - ram->requested_mb) / ram->allocated_mb : 0.0;
+}
+
+// ##########################################
+// RUN QUEUE DATA STRUCTURES
+// ##########################################
+void heap_init(MinHeap* heap) {
+    heap->entries = NULL;
+    heap->size = 0;
+    heap->capacity = 0;
+}
+
+static int heap_less(const HeapEntry* a, const HeapEntry* b) {
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+    return a->seq < b->seq;
+}
+
+void heap_push(MinHeap* heap, long long key, unsigned long seq, void* item) {
+    if (heap->size == heap->capacity) {
+        int new_capacity = heap->capacity ? heap->capacity * 2 : 64;
+        HeapEntry* grown = realloc(heap->entries, new_capacity * sizeof(HeapEntry));
+        if (grown == NULL) {
+            perror("Failed to grow heap");
+            exit(EXIT_FAILURE);
+        }
+        heap->entries = grown;
+        heap->capacity = new_capacity;
+    }
+    
+    // Sift the new entry up from the bottom
+    HeapEntry entry = { key, seq, item };
+    int pos = heap->size++;
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!heap_less(&entry, &heap->entries[parent])) {
+            break;
+        }
+        heap->entries[pos] = heap->entries[parent];
+        pos = parent;
+    }
+    heap->entries[pos] = entry;
+}
+
+void* heap_pop(MinHeap* heap) {
+    if (heap->size == 0) {
+        return NULL;
+    }
+    
+    void* item = heap->entries[0].item;
+    HeapEntry last = heap->entries[--heap->size];
+    
+    // Sift the last entry down from the root
+    int pos = 0;
+    while (1) {
+        int child = pos * 2 + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size && heap_less(&heap->entries[child + 1], &heap->entries[child])) {
+            child++;
+        }
+        if (!heap_less(&heap->entries[child], &last)) {
+            break;
+        }
+        heap->entries[pos] = heap->entries[child];
+        pos = child;
+    }
+    if (heap->size > 0) {
+        heap->entries[pos] = last;
+    }
+    
+    return item;
+}
+
+void heap_free(MinHeap* heap) {
+    free(heap->entries);
+    heap_init(heap);
+}
+
+void fifo_init(Fifo* fifo) {
+    fifo->items = NULL;
+    fifo->head = 0;
+    fifo->count = 0;
+    fifo->capacity = 0;
+}
+
+void fifo_push(Fifo* fifo, void* item) {
+    if (fifo->count == fifo->capacity) {
+        int new_capacity = fifo->capacity ? fifo->capacity * 2 : 64;
+        void** grown = malloc(new_capacity * sizeof(void*));
+        if (grown == NULL) {
+            perror("Failed to grow queue");
+            exit(EXIT_FAILURE);
+        }
+        // Unwrap the ring into the new buffer
+        for (int i = 0; i < fifo->count; i++) {
+            grown[i] = fifo->items[(fifo->head + i) % fifo->capacity];
+        }
+        free(fifo->items);
+        fifo->items = grown;
+        fifo->head = 0;
+        fifo->capacity = new_capacity;
+    }
+    
+    fifo->items[(fifo->head + fifo->count) % fifo->capacity] = item;
+    fifo->count++;
+}
+
+void* fifo_pop(Fifo* fifo) {
+    if (fifo->count == 0) {
+        return NULL;
+    }
+    
+    void* item = fifo->items[fifo->head];
+    fifo->head = (fifo->head + 1) % fifo->capacity;
+    fifo->count--;
+    return item;
+}
+
+void fifo_free(Fifo* fifo) {
+    free(fifo->items);
+    fifo_init(fifo);
+}
+
+// ##########################################
+// HEADLESS SCHEDULING SIMULATOR
+// ##########################################
+// Jobs are replayed in virtual time: the clock jumps straight to the next
+// arrival or core event, so nothing here ever sleeps.
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n\n", program);
+    printf("Without options the interactive %s simulator is started.\n\n", OS_NAME);
+    printf("Headless modes:\n");
+    printf("  --simulate <trace|->     Replay a job trace through the CPU schedulers\n");
+    printf("  --gen-trace <jobs>       Write a synthetic job trace to stdout\n");
+    printf("  --bench-queue <pcbs>     Time run queue enqueue/dequeue up to <pcbs> entries\n");
+    printf("  --bench-dispatch <n>     Compare dispatch throughput for 1..n workers\n");
+    printf("  --bench-balance <n>      Spread <n> processes over --cores with and without balancing\n");
+    printf("  --bench-table <n>        Time process table lookups up to <n> entries\n");
+    printf("  --bench-table-lock <n>   Stress the process table lock from 1..n threads\n");
+    printf("  --bench-launch <n>       Compare task launch latency over <n> launches\n");
+    printf("  --check-shares <ms>      Run two CPU-bound tasks on one CPU slot under FCFS and RR\n");
+    printf("  --bench-usage <n>        Time one accounting pass over <n> live processes\n");
+    printf("  --bench-trace <n>        Time recording <n> trace events per thread\n");
+    printf("  --bench-console <n>      Time keystroke echo next to 0..n chatty tasks on ptys\n");
+    printf("  --bench-registry <n>     Time loading a task registry of <n> applications\n");
+    printf("  --bench-alloc <ops>      Churn <ops> allocations through every RAM allocator\n");
+    printf("  --bench-resources <n>    Time resource reservations for 1..n launcher threads (max 64)\n");
+    printf("  --bench-deadlock <n>     Time deadlock avoidance and detection up to <n> processes\n");
+    printf("  --vm-refs <n>            Page <n> synthetic references through the memory manager\n");
+    printf("  --vm-trace <file|->      Page a recorded reference string instead\n");
+    printf("  --vm-gen <n>             Write a synthetic reference string to stdout\n\n");
+    printf("Interactive OS:\n");
+    printf("  --batch <file|->         Run OS commands from a file or stdin, without delays\n");
+    printf("  --ram/--hdd/--cores      Hardware of the OS; skips the hardware prompts\n");
+    printf("  --max-tasks <n>          Process table slots (default: %d)\n", MAX_TASKS);
+    printf("  --registry <file>        Application registry, reloaded on change (default: %s)\n", TASK_REGISTRY_PATH);
+    printf("  --ram-allocator <name>   first, best, worst, next or buddy (default: first)\n");
+    printf("  --deadlock <mode>        avoid (Banker's) or detect (wait-for graph) (default: avoid)\n");
+    printf("  --metrics-file <path>    Export Prometheus metrics to <path> while the OS runs\n");
+    printf("  --metrics-interval <ms>  Metrics export interval (default: %d)\n", METRICS_INTERVAL_MS);
+    printf("  --trace-file <path>      Record scheduler events, written as Chrome trace JSON\n");
+    printf("  --term-timeout <ms>      Grace period between SIGTERM and SIGKILL (default: %d)\n\n",
+           TERM_TIMEOUT_MS);
+    printf("Options:\n");
+    printf("  --policy <name>          fcfs, sjf, priority, rr, mlfq or all (default: all)\n");
+    printf("  --cores <n>              CPU cores of the simulated machine (default: 1)\n");
+    printf("  --ram <gb>               RAM of the simulated machine (default: 8)\n");
+    printf("  --hdd <gb>               Disk of the simulated machine (default: 256)\n");
+    printf("  --quantum <units>        Fixed quantum for every level (default: per level)\n");
+    printf("  --quanta <q0,q1,q2>      Per-level quanta (default: 2,4,6)\n");
+    printf("  --mlfq-boost <units>     MLFQ priority boost interval, 0 disables (default: 100)\n");
+    printf("  --vm-policy <name>       fifo, lru, clock, second-chance or all (default: all)\n");
+    printf("  --vm-procs <n>           Processes in a synthetic reference string (default: 8)\n");
+    printf("  --vm-space <gb>          Virtual address space per process (default: 4)\n");
+    printf("  --page-kb <kb>           Page size (default: 4)\n");
+    printf("  --tlb <entries>          TLB entries, 4-way set associative (default: 64)\n");
+    printf("  --seed <n>               Seed for --gen-trace and --vm-gen (default: 1)\n\n");
+    printf("Trace format: one job per line, '#' starts a comment\n");
+    printf("  <arrival> <burst> [priority] [ram_mb] [hdd_gb]\n\n");
+    printf("Reference string format: one reference per line, '#' starts a comment\n");
+    printf("  [process] <address>\n\n");
+    printf("Batch commands: one per line, '#' starts a comment\n");
+    printf("  launch <app|number>, terminate <pid|app>, list, status, usage, memory, claims,\n");
+    printf("  cores, request <pid|app> <ram_mb> <hdd_gb> <cores>, release <pid|app> <ram_mb> <hdd_gb> <cores>,\n");
+    printf("  mode <kernel|user>, scheduler <fcfs|sjf|priority|rr|mlfq>, sleep <ms>, quit\n");
+}
+
+static int parse_int_argument(const char* option, const char* value, long* out) {
+    char* end;
+    errno = 0;
+    long parsed = strtol(value, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed < 0) {
+        fprintf(stderr, "Invalid value for %s: %s\n", option, value);
+        return 0;
+    }
+    *out = parsed;
+    return 1;
+}
+
+// Returns -1 when no headless mode was requested, otherwise the exit status
+int run_headless_mode(int argc, char* argv[]) {
+    if (argc <= 1) {
+        init_task_registry();
+        return -1;
+    }
+    
+    const char* trace_path = NULL;
+    const char* policy_name = "all";
+    long generate_jobs = -1;
+    long bench_queue_pcbs = -1;
+    long bench_dispatch_threads = -1;
+    long bench_balance_processes = -1;
+    long seed = 1;
+    SimConfig config = { 1, 8 * 1024, 256, 0, 100 };
+    int quanta[MAX_LEVELS] = { 0 };
+    long bench_table_entries = -1;
+    long bench_lock_threads = -1;
+    long bench_launches = -1;
+    long bench_usage_tasks = -1;
+    long bench_trace_events = -1;
+    long bench_console_tasks = -1;
+    long bench_registry_tasks = -1;
+    long check_share_ms = -1;
+    long bench_alloc_ops = -1;
+    long bench_resource_threads = -1;
+    long bench_deadlock_processes = -1;
+    const char* vm_trace_path = NULL;
+    const char* vm_policy_name = "all";
+    long vm_refs = -1;
+    long vm_generate = -1;
+    VmConfig vm_config = { 0, 4 * 1024, 4, 64, 8 };
+    int hardware_given = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        long number;
+        
+        if (strcmp(option, "--help") == 0 || strcmp(option, "-h") == 0) {
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", option);
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        
+        if (strcmp(option, "--simulate") == 0) {
+            trace_path = value;
+        } else if (strcmp(option, "--policy") == 0) {
+            policy_name = value;
+        } else if (strcmp(option, "--gen-trace") == 0) {
+            if (!parse_int_argument(option, value, &generate_jobs)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-queue") == 0) {
+            if (!parse_int_argument(option, value, &bench_queue_pcbs)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-dispatch") == 0) {
+            if (!parse_int_argument(option, value, &bench_dispatch_threads)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-balance") == 0) {
+            if (!parse_int_argument(option, value, &bench_balance_processes)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--seed") == 0) {
+            if (!parse_int_argument(option, value, &seed)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--cores") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 1) return EXIT_FAILURE;
+            config.cores = (int)number;
+            hardware_given = 1;
+        } else if (strcmp(option, "--ram") == 0) {
+            if (!parse_int_argument(option, value, &number)) return EXIT_FAILURE;
+            config.ram_mb = (int)number * 1024;
+            hardware_given = 1;
+        } else if (strcmp(option, "--hdd") == 0) {
+            if (!parse_int_argument(option, value, &number)) return EXIT_FAILURE;
+            config.hdd_gb = (int)number;
+            hardware_given = 1;
+        } else if (strcmp(option, "--vm-refs") == 0) {
+            if (!parse_int_argument(option, value, &vm_refs)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--vm-trace") == 0) {
+            vm_trace_path = value;
+        } else if (strcmp(option, "--vm-gen") == 0) {
+            if (!parse_int_argument(option, value, &vm_generate)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--vm-policy") == 0) {
+            vm_policy_name = value;
+        } else if (strcmp(option, "--vm-procs") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 1 || number > 65535) return EXIT_FAILURE;
+            vm_config.procs = (int)number;
+        } else if (strcmp(option, "--vm-space") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 1) return EXIT_FAILURE;
+            vm_config.space_mb = number * 1024;
+        } else if (strcmp(option, "--page-kb") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 1) return EXIT_FAILURE;
+            vm_config.page_kb = (int)number;
+        } else if (strcmp(option, "--tlb") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 1) return EXIT_FAILURE;
+            vm_config.tlb_entries = (int)number;
+        } else if (strcmp(option, "--batch") == 0) {
+            batch_path = value;
+            batch_mode = 1;
+        } else if (strcmp(option, "--term-timeout") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 0) return EXIT_FAILURE;
+            term_timeout_ms = (int)number;
+        } else if (strcmp(option, "--trace-file") == 0) {
+            trace_file_path = value;
+        } else if (strcmp(option, "--metrics-file") == 0) {
+            metrics_path = value;
+        } else if (strcmp(option, "--metrics-interval") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 1) return EXIT_FAILURE;
+            metrics_interval_ms = (int)number;
+        } else if (strcmp(option, "--quanta") == 0) {
+            if (sscanf(value, "%d,%d,%d", &quanta[0], &quanta[1], &quanta[2]) != MAX_LEVELS ||
+                quanta[0] <= 0 || quanta[1] <= 0 || quanta[2] <= 0) {
+                fprintf(stderr, "Invalid value for %s: %s\n", option, value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(option, "--mlfq-boost") == 0) {
+            if (!parse_int_argument(option, value, &number)) return EXIT_FAILURE;
+            config.mlfq_boost = (int)number;
+        } else if (strcmp(option, "--bench-launch") == 0) {
+            if (!parse_int_argument(option, value, &bench_launches)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-usage") == 0) {
+            if (!parse_int_argument(option, value, &bench_usage_tasks)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-trace") == 0) {
+            if (!parse_int_argument(option, value, &bench_trace_events)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-console") == 0) {
+            if (!parse_int_argument(option, value, &bench_console_tasks)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--check-shares") == 0) {
+            if (!parse_int_argument(option, value, &check_share_ms) || check_share_ms < 1) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-registry") == 0) {
+            if (!parse_int_argument(option, value, &bench_registry_tasks)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--registry") == 0) {
+            registry_path = value;
+            registry_path_given = 1;
+        } else if (strcmp(option, "--bench-alloc") == 0) {
+            if (!parse_int_argument(option, value, &bench_alloc_ops)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-resources") == 0) {
+            if (!parse_int_argument(option, value, &bench_resource_threads)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-deadlock") == 0) {
+            if (!parse_int_argument(option, value, &bench_deadlock_processes)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--deadlock") == 0) {
+            if (strcmp(value, "avoid") == 0) {
+                deadlock_mode = DEADLOCK_AVOID;
+            } else if (strcmp(value, "detect") == 0) {
+                deadlock_mode = DEADLOCK_DETECT;
+            } else {
+                fprintf(stderr, "Unknown deadlock mode: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(option, "--ram-allocator") == 0) {
+            if (!parse_ram_allocator(value, &ram_allocator_type)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-table") == 0) {
+            if (!parse_int_argument(option, value, &bench_table_entries)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--bench-table-lock") == 0) {
+            if (!parse_int_argument(option, value, &bench_lock_threads)) return EXIT_FAILURE;
+        } else if (strcmp(option, "--max-tasks") == 0) {
+            if (!parse_int_argument(option, value, &number) || number < 1 || number > 1000000) {
+                fprintf(stderr, "--max-tasks must be between 1 and 1000000\n");
+                return EXIT_FAILURE;
+            }
+            max_tasks = (int)number;
+        } else if (strcmp(option, "--quantum") == 0) {
+            if (!parse_int_argument(option, value, &number)) return EXIT_FAILURE;
+            config.quantum = (int)number;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", option);
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+    
+    // The benchmarks launch registered applications as well
+    if (init_task_registry() != 0) {
+        return EXIT_FAILURE;
+    }
+    if (bench_registry_tasks >= 1) {
+        return run_registry_benchmark(bench_registry_tasks);
+    }
+    if (bench_queue_pcbs >= 0) {
+        run_queue_benchmark(bench_queue_pcbs);
+        return EXIT_SUCCESS;
+    }
+    if (bench_dispatch_threads >= 1) {
+        run_dispatch_benchmark((int)bench_dispatch_threads);
+        return EXIT_SUCCESS;
+    }
+    if (bench_balance_processes >= 1) {
+        run_balance_benchmark(bench_balance_processes, config.cores);
+        return EXIT_SUCCESS;
+    }
+    vm_config.ram_mb = config.ram_mb;
+    if (vm_generate >= 0) {
+        generate_vm_trace(vm_generate, &vm_config, (unsigned long)seed);
+        return EXIT_SUCCESS;
+    }
+    if (vm_trace_path != NULL || vm_refs >= 0) {
+        run_vm_simulator(vm_trace_path, vm_refs, vm_policy_name, &vm_config, (unsigned long)seed);
+        return EXIT_SUCCESS;
+    }
+    if (bench_launches >= 1) {
+        run_launch_benchmark(bench_launches);
+        return EXIT_SUCCESS;
+    }
+    if (check_share_ms >= 1) {
+        return run_share_check((int)check_share_ms);
+    }
+    if (bench_trace_events >= 1) {
+        run_trace_benchmark(bench_trace_events);
+        return EXIT_SUCCESS;
+    }
+    if (bench_console_tasks >= 0) {
+        run_console_benchmark((int)(bench_console_tasks < 1024 ? bench_console_tasks : 1024));
+        return EXIT_SUCCESS;
+    }
+    if (bench_usage_tasks >= 1) {
+        run_usage_benchmark(bench_usage_tasks);
+        return EXIT_SUCCESS;
+    }
+    if (bench_deadlock_processes >= 1) {
+        run_deadlock_benchmark(bench_deadlock_processes);
+        return EXIT_SUCCESS;
+    }
+    if (bench_resource_threads >= 1) {
+        run_resource_benchmark((int)bench_resource_threads);
+        return EXIT_SUCCESS;
+    }
+    if (bench_alloc_ops >= 1) {
+        run_alloc_benchmark(bench_alloc_ops, config.ram_mb, (unsigned long)seed);
+        return EXIT_SUCCESS;
+    }
+    if (bench_lock_threads >= 1) {
+        run_table_lock_benchmark((int)bench_lock_threads);
+        return EXIT_SUCCESS;
+    }
+    if (bench_table_entries >= 1) {
+        run_table_benchmark(bench_table_entries);
+        return EXIT_SUCCESS;
+    }
+    if (generate_jobs >= 0) {
+        generate_sim_trace(generate_jobs, config.cores, (unsigned long)seed);
+        return EXIT_SUCCESS;
+    }
+    if (trace_path != NULL) {
+        init_multilevel_queue();
+        if (quanta[0] > 0) {
+            memcpy(ml_queue.time_quantum, quanta, sizeof(quanta));
+        }
+        run_simulator(trace_path, policy_name, &config);
+        return EXIT_SUCCESS;
+    }
+    
+    // Only interactive settings were given, start the OS
+    if (hardware_given || batch_mode) {
+        hardware.ram_gb = config.ram_mb / 1024;
+        hardware.hdd_gb = config.hdd_gb;
+        hardware.cpu_cores = config.cores;
+        hardware_preset = 1;
+    }
+    return -1;
+}
+
+// Read a whole file (or stdin for "-") into a NUL-terminated buffer
+static char* read_whole_file(const char* path, size_t* length_out) {
+    FILE* file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+    
+    size_t capacity = 1 << 20;
+    size_t length = 0;
+    char* buffer = malloc(capacity + 1);
+    
+    while (buffer != NULL) {
+        size_t got = fread(buffer + length, 1, capacity - length, file);
+        length += got;
+        if (length < capacity) {
+            break;
+        }
+        capacity *= 2;
+        char* grown = realloc(buffer, capacity + 1);
+        if (grown == NULL) {
+            free(buffer);
+            buffer = NULL;
+        } else {
+            buffer = grown;
+        }
+    }
+    
+    if (file != stdin) {
+        fclose(file);
+    }
+    if (buffer == NULL) {
+        fprintf(stderr, "Out of memory reading %s\n", path);
+        return NULL;
+    }
+    
+    buffer[length] = '\0';
+    *length_out = length;
+    return buffer;
+}
+
+static int compare_sim_jobs(const void* a, const void* b) {
+    const SimJob* x = a;
+    const SimJob* y = b;
+    if (x->arrival != y->arrival) {
+        return x->arrival < y->arrival ? -1 : 1;
+    }
+    return x->id < y->id ? -1 : (x->id > y->id);
+}
+
+// Parse a trace into an array of jobs sorted by arrival time
+int load_sim_trace(const char* path, SimJob** jobs_out, long* count_out) {
+    size_t length;
+    char* buffer = read_whole_file(path, &length);
+    if (buffer == NULL) {
+        return 0;
+    }
+    
+    long capacity = 1024;
+    long count = 0;
+    SimJob* jobs = malloc(capacity * sizeof(SimJob));
+    int sorted = 1;
+    long line_number = 0;
+    char* cursor = buffer;
+    
+    while (*cursor != '\0' && jobs != NULL) {
+        char* line = cursor;
+        char* line_end = strchr(line, '\n');
+        if (line_end != NULL) {
+            *line_end = '\0';
+            cursor = line_end + 1;
+        } else {
+            cursor = line + strlen(line);
+        }
+        line_number++;
+        
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        
+        // arrival burst [priority] [ram_mb] [hdd_gb]
+        long long fields[5] = { 0, 0, 1, 64, 1 };
+        int parsed = 0;
+        char* p = line;
+        while (parsed < 5) {
+            char* end;
+            long long value = strtoll(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            fields[parsed++] = value;
+            p = end;
+        }
+        while (*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+        }
+        
+        if (parsed == 0 && *p == '\0') {
+            continue; // Blank or comment line
+        }
+        if (parsed < 2 || *p != '\0' || fields[0] < 0 || fields[1] <= 0) {
+            fprintf(stderr, "%s:%ld: invalid job line\n", path, line_number);
+            free(jobs);
+            free(buffer);
+            return 0;
+        }
+        
+        if (count == capacity) {
+            capacity *= 2;
+            SimJob* grown = realloc(jobs, capacity * sizeof(SimJob));
+            if (grown == NULL) {
+                free(jobs);
+                jobs = NULL;
+                break;
+            }
+            jobs = grown;
+        }
+        
+        SimJob* job = &jobs[count];
+        job->arrival = fields[0];
+        job->burst = fields[1];
+        job->priority = (int)fields[2];
+        job->ram_required = (int)fields[3];
+        job->hdd_required = (int)fields[4];
+        job->id = count;
+        if (count > 0 && job->arrival < jobs[count - 1].arrival) {
+            sorted = 0;
+        }
+        count++;
+    }
+    
+    free(buffer);
+    if (jobs == NULL) {
+        fprintf(stderr, "Out of memory loading %s\n", path);
+        return 0;
+    }
+    
+    if (!sorted) {
+        qsort(jobs, count, sizeof(SimJob), compare_sim_jobs);
+    }
+    
+    *jobs_out = jobs;
+    *count_out = count;
+    return 1;
+}
+
+// Small xorshift generator so traces are reproducible across libcs
+unsigned long next_random(unsigned long* state) {
+    unsigned long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Synthetic workload built from the application registry: mostly short
+// interactive bursts with some long CPU-bound jobs, loading the machine to ~90%
+void generate_sim_trace(long count, int cores, unsigned long seed) {
+    unsigned long state = seed * 2654435761UL + 1;
+    const double mean_burst = 0.8 * 4.5 + 0.2 * 35.0;
+    long max_gap = (long)(2.0 * mean_burst / (0.9 * cores) + 0.5);
+    if (max_gap < 1) {
+        max_gap = 1;
+    }
+    
+    static char out_buffer[1 << 16];
+    setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+    
+    printf("# arrival burst priority ram_mb hdd_gb\n");
+    long long arrival = 0;
+    for (long i = 0; i < count; i++) {
+        arrival += (long long)(next_random(&state) % (unsigned long)(max_gap + 1));
+        long long burst = (next_random(&state) % 5 == 0)
+                        ? 10 + (long long)(next_random(&state) % 51)
+                        : 1 + (long long)(next_random(&state) % 8);
+        const Task* task = &available_tasks[next_random(&state) % (unsigned long)num_available_tasks];
+        printf("%lld %lld %d %d %d\n", arrival, burst, task->priority,
+               task->ram_required, task->hdd_required);
+    }
+    fflush(stdout);
+}
+
+
+static void sim_make_ready(SimJob* job, SchedulerType policy, Fifo* fifo,
+                           MinHeap* heap, unsigned long* seq) {
+    switch (policy) {
+        case SCHEDULER_SJF:
+            heap_push(heap, job->remaining, (*seq)++, job);
+            break;
+        case SCHEDULER_PRIORITY:
+            // Higher priority values run first
+            heap_push(heap, -(long long)job->priority, (*seq)++, job);
+            break;
+        case SCHEDULER_MLFQ:
+            // Highest level first, round robin within a level
+            heap_push(heap, job->level, (*seq)++, job);
+            break;
+        case SCHEDULER_FCFS:
+        case SCHEDULER_RR:
+        default:
+            fifo_push(fifo, job);
+            break;
+    }
+}
+
+// Quantum of an MLFQ level, or the fixed quantum if one was given
+static long long sim_quantum(int level, const SimConfig* config) {
+    return config->quantum > 0 ? config->quantum : ml_queue.time_quantum[level];
+}
+
+// MLFQ boost: every waiting and running job goes back to level 0
+static void sim_boost_jobs(MinHeap* ready_heap, SimJob** core_job, int cores) {
+    int waiting = ready_heap->size;
+    HeapEntry* entries = malloc((waiting > 0 ? waiting : 1) * sizeof(HeapEntry));
+    if (entries == NULL) {
+        perror("Failed to boost jobs");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(entries, ready_heap->entries, waiting * sizeof(HeapEntry));
+    
+    // Keep the old queueing order among the boosted jobs
+    ready_heap->size = 0;
+    for (int i = 0; i < waiting; i++) {
+        ((SimJob*)entries[i].item)->level = 0;
+        heap_push(ready_heap, 0, entries[i].seq, entries[i].item);
+    }
+    free(entries);
+    
+    for (int c = 0; c < cores; c++) {
+        if (core_job[c] != NULL) {
+            core_job[c]->level = 0;
+        }
+    }
+}
+
+void simulate_policy(SimJob* jobs, long count, SchedulerType policy,
+                     const SimConfig* config, SimResult* result) {
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    
+    memset(result, 0, sizeof(*result));
+    for (long i = 0; i < count; i++) {
+        jobs[i].remaining = jobs[i].burst;
+        jobs[i].first_run = -1;
+        jobs[i].completion = -1;
+        jobs[i].level = 0;
+    }
+    
+    Fifo ready_fifo, waiting_memory;
+    MinHeap ready_heap, core_events;
+    fifo_init(&ready_fifo);
+    fifo_init(&waiting_memory);
+    heap_init(&ready_heap);
+    heap_init(&core_events);
+    
+    SimJob** core_job = calloc(config->cores, sizeof(SimJob*));
+    long long* slice_start = calloc(config->cores, sizeof(long long));
+    int* slice_level = calloc(config->cores, sizeof(int));
+    int* idle_cores = malloc(config->cores * sizeof(int));
+    if (core_job == NULL || slice_start == NULL || slice_level == NULL || idle_cores == NULL) {
+        perror("Failed to allocate simulator cores");
+        exit(EXIT_FAILURE);
+    }
+    int idle_count = config->cores;
+    for (int c = 0; c < config->cores; c++) {
+        idle_cores[c] = config->cores - 1 - c;
+    }
+    
+    int free_ram = config->ram_mb;
+    int free_hdd = config->hdd_gb;
+    unsigned long seq = 0;
+    long next_arrival = 0;
+    long finished = 0;
+    long long now = 0;
+    long long busy_time = 0;
+    double total_waiting = 0, total_turnaround = 0, total_response = 0;
+    int use_boost = policy == SCHEDULER_MLFQ && config->mlfq_boost > 0;
+    long long next_boost = config->mlfq_boost;
+    
+    while (finished + result->rejected < count) {
+        long long next_arrival_time = next_arrival < count ? jobs[next_arrival].arrival : LLONG_MAX;
+        long long next_core_time = core_events.size > 0 ? core_events.entries[0].key : LLONG_MAX;
+        now = next_arrival_time < next_core_time ? next_arrival_time : next_core_time;
+        
+        // MLFQ priority boost: only worth an event while jobs are waiting
+        if (use_boost && ready_heap.size > 0 && next_boost < now) {
+            now = next_boost;
+        }
+        if (use_boost && now >= next_boost) {
+            if (ready_heap.size > 0 || idle_count < config->cores) {
+                sim_boost_jobs(&ready_heap, core_job, config->cores);
+                result->mlfq_boosts++;
+            }
+            next_boost = now + config->mlfq_boost;
+        }
+        
+        // Arrivals: admit into the ready queue if the job fits in memory
+        while (next_arrival < count && jobs[next_arrival].arrival <= now) {
+            SimJob* job = &jobs[next_arrival++];
+            if (job->ram_required > config->ram_mb || job->hdd_required > config->hdd_gb) {
+                result->rejected++;
+            } else if (waiting_memory.count == 0 &&
+                       job->ram_required <= free_ram && job->hdd_required <= free_hdd) {
+                free_ram -= job->ram_required;
+                free_hdd -= job->hdd_required;
+                sim_make_ready(job, policy, &ready_fifo, &ready_heap, &seq);
+            } else {
+                fifo_push(&waiting_memory, job);
+            }
+        }
+        
+        // Core events: a job either finished or used up its quantum
+        while (core_events.size > 0 && core_events.entries[0].key <= now) {
+            int core = (int)(intptr_t)heap_pop(&core_events);
+            SimJob* job = core_job[core];
+            long long ran = now - slice_start[core];
+            
+            job->remaining -= ran;
+            busy_time += ran;
+            core_job[core] = NULL;
+            idle_cores[idle_count++] = core;
+            result->level_run_time[slice_level[core]] += ran;
+            
+            // MLFQ: a job that used its whole quantum drops a level
+            if (policy == SCHEDULER_MLFQ && job->remaining > 0 &&
+                ran >= sim_quantum(slice_level[core], config) &&
+                job->level == slice_level[core] && job->level < MAX_LEVELS - 1) {
+                result->level_demotions[job->level]++;
+                job->level++;
+            }
+            
+            if (job->remaining > 0) {
+                sim_make_ready(job, policy, &ready_fifo, &ready_heap, &seq);
+                continue;
+            }
+            
+            job->completion = now;
+            finished++;
+            result->level_completions[slice_level[core]]++;
+            long long turnaround = job->completion - job->arrival;
+            total_turnaround += (double)turnaround;
+            total_waiting += (double)(turnaround - job->burst);
+            total_response += (double)(job->first_run - job->arrival);
+            
+            free_ram += job->ram_required;
+            free_hdd += job->hdd_required;
+            
+            // Jobs blocked on memory are admitted in arrival order
+            while (waiting_memory.count > 0) {
+                SimJob* head = waiting_memory.items[waiting_memory.head];
+                if (head->ram_required > free_ram || head->hdd_required > free_hdd) {
+                    break;
+                }
+                fifo_pop(&waiting_memory);
+                free_ram -= head->ram_required;
+                free_hdd -= head->hdd_required;
+                sim_make_ready(head, policy, &ready_fifo, &ready_heap, &seq);
+            }
+        }
+        
+        // Dispatch ready jobs onto idle cores
+        while (idle_count > 0 && (ready_fifo.count > 0 || ready_heap.size > 0)) {
+            SimJob* job = ready_fifo.count > 0 ? fifo_pop(&ready_fifo) : heap_pop(&ready_heap);
+            int core = idle_cores[--idle_count];
+            
+            int level = policy == SCHEDULER_MLFQ ? job->level : priority_to_level(job->priority);
+            long long slice = job->remaining;
+            if (scheduler_is_preemptive(policy)) {
+                long long quantum = sim_quantum(level, config);
+                if (quantum < slice) {
+                    slice = quantum;
+                }
+            }
+            
+            if (job->first_run < 0) {
+                job->first_run = now;
+            }
+            core_job[core] = job;
+            slice_start[core] = now;
+            slice_level[core] = level;
+            result->level_dispatches[level]++;
+            heap_push(&core_events, now + slice, seq++, (void*)(intptr_t)core);
+            result->dispatches++;
+        }
+    }
+    
+    if (finished > 0) {
+        long long first_arrival = jobs[0].arrival;
+        result->makespan = now - first_arrival;
+        result->avg_waiting = total_waiting / finished;
+        result->avg_turnaround = total_turnaround / finished;
+        result->avg_response = total_response / finished;
+        if (result->makespan > 0) {
+            result->throughput = 1000.0 * finished / (double)result->makespan;
+            result->cpu_utilisation = (double)busy_time / ((double)result->makespan * config->cores);
+        }
+    }
+    result->completed = finished;
+    
+    fifo_free(&ready_fifo);
+    fifo_free(&waiting_memory);
+    heap_free(&ready_heap);
+    heap_free(&core_events);
+    free(core_job);
+    free(slice_start);
+    free(slice_level);
+    free(idle_cores);
+    
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    result->wall_seconds = (double)(wall_end.tv_sec - wall_start.tv_sec) +
+                           (double)(wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+}
+
+static int parse_policy_name(const char* name, SchedulerType* policy) {
+    if (strcmp(name, "fcfs") == 0) {
+        *policy = SCHEDULER_FCFS;
+    } else if (strcmp(name, "sjf") == 0) {
+        *policy = SCHEDULER_SJF;
+    } else if (strcmp(name, "priority") == 0) {
+        *policy = SCHEDULER_PRIORITY;
+    } else if (strcmp(name, "rr") == 0) {
+        *policy = SCHEDULER_RR;
+    } else if (strcmp(name, "mlfq") == 0) {
+        *policy = SCHEDULER_MLFQ;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+void run_simulator(const char* trace_path, const char* policy_name, const SimConfig* config) {
+    SchedulerType policies[] = { SCHEDULER_FCFS, SCHEDULER_SJF, SCHEDULER_PRIORITY,
+                                 SCHEDULER_RR, SCHEDULER_MLFQ };
+    int num_policies = sizeof(policies) / sizeof(policies[0]);
+    
+    if (strcmp(policy_name, "all") != 0) {
+        if (!parse_policy_name(policy_name, &policies[0])) {
+            fprintf(stderr, "Unknown policy: %s\n", policy_name);
+            return;
+        }
+        num_policies = 1;
+    }
+    
+    SimJob* jobs;
+    long count;
+    if (!load_sim_trace(trace_path, &jobs, &count)) {
+        return;
+    }
+    
+    printf("%s Scheduling Simulator\n", OS_NAME);
+    printf("Trace: %s (%ld jobs), %d cores, %d MB RAM, %d GB HDD, quantum: ",
+           trace_path, count, config->cores, config->ram_mb, config->hdd_gb);
+    if (config->quantum > 0) {
+        printf("%d\n\n", config->quantum);
+    } else {
+        printf("%d/%d/%d by level\n\n", ml_queue.time_quantum[0],
+               ml_queue.time_quantum[1], ml_queue.time_quantum[2]);
+    }
+    
+    SimResult mlfq_result;
+    int have_mlfq = 0;
+    
+    printf("%-24s %10s %10s %12s %10s %12s %9s %9s\n", "Policy", "Completed",
+           "Avg wait", "Avg turnard", "Avg resp", "Jobs/1k u", "CPU util", "Sim time");
+    printf("--------------------------------------------------------------------------------------------------\n");
+    
+    for (int i = 0; i < num_policies; i++) {
+        SimResult result;
+        simulate_policy(jobs, count, policies[i], config, &result);
+        printf("%-24s %10ld %10.2f %12.2f %10.2f %12.3f %8.1f%% %8.3fs\n",
+               get_scheduler_name(policies[i]), result.completed, result.avg_waiting,
+               result.avg_turnaround, result.avg_response, result.throughput,
+               100.0 * result.cpu_utilisation, result.wall_seconds);
+        if (result.rejected > 0) {
+            printf("%-24s %ld jobs rejected: they exceed the machine's RAM/HDD\n", "",
+                   result.rejected);
+        }
+        if (policies[i] == SCHEDULER_MLFQ) {
+            mlfq_result = result;
+            have_mlfq = 1;
+        }
+    }
+    
+    // Residency per level shows where MLFQ kept the jobs
+    if (have_mlfq) {
+        printf("\nMLFQ level residency (%ld boosts, every %d units)\n",
+               mlfq_result.mlfq_boosts, config->mlfq_boost);
+        printf("%-6s %10s %14s %12s %14s %12s\n", "Level", "Quantum", "Dispatches",
+               "CPU share", "Completions", "Demotions");
+        long long total_run = 0;
+        for (int level = 0; level < MAX_LEVELS; level++) {
+            total_run += mlfq_result.level_run_time[level];
+        }
+        for (int level = 0; level < MAX_LEVELS; level++) {
+            printf("%-6d %10d %14lld %11.1f%% %14ld %12lld\n", level,
+                   config->quantum > 0 ? config->quantum : ml_queue.time_quantum[level],
+                   mlfq_result.level_dispatches[level],
+                   total_run > 0 ? 100.0 * mlfq_result.level_run_time[level] / total_run : 0.0,
+                   mlfq_result.level_completions[level], mlfq_result.level_demotions[level]);
+        }
+    }
+    
+    free(jobs);
+}
+
+// ##########################################
+// RUN QUEUE MICROBENCHMARK
+// ##########################################
+// Fills the multilevel queue with n PCBs and drains it through the
+// scheduler's selection path, for growing n, to show per-operation cost
+void run_queue_benchmark(long max_pcbs) {
+    SchedulerType policies[] = { SCHEDULER_FCFS, SCHEDULER_SJF, SCHEDULER_PRIORITY, SCHEDULER_RR };
+    int num_policies = sizeof(policies) / sizeof(policies[0]);
+    
+    printf("%s Run Queue Benchmark\n\n", OS_NAME);
+    printf("%-24s %10s %16s %16s\n", "Policy", "PCBs", "Enqueue ns/op", "Dequeue ns/op");
+    printf("--------------------------------------------------------------------\n");
+    
+    for (long n = 1000; n <= max_pcbs; n *= 10) {
+        PCB* pcbs = calloc(n, sizeof(PCB));
+        if (pcbs == NULL) {
+            perror("Failed to allocate PCBs");
+            return;
+        }
+        
+        unsigned long state = 42;
+        for (long i = 0; i < n; i++) {
+            pcbs[i].priority = (int)(next_random(&state) % 4);
+            pcbs[i].burst_estimate_ms = 1 + (long)(next_random(&state) % 1000);
+            pcbs[i].queue_level = priority_to_level(pcbs[i].priority);
+        }
+        
+        for (int p = 0; p < num_policies; p++) {
+            RunQueue queue;
+            run_queue_init(&queue, policies[p]);
+            
+            long long start = monotonic_ns();
+            for (long i = 0; i < n; i++) {
+                pcbs[i].enqueue_seq = (unsigned long)i;
+                run_queue_push(&queue, &pcbs[i]);
+            }
+            long long enqueued = monotonic_ns();
+            
+            long drained = 0;
+            int level;
+            while (select_next_process(&queue, &level) != NULL) {
+                drained++;
+            }
+            long long end = monotonic_ns();
+            
+            if (drained != n) {
+                printf("ERROR: %s drained %ld of %ld PCBs\n", get_scheduler_name(policies[p]), drained, n);
+            }
+            printf("%-24s %10ld %16.1f %16.1f\n", get_scheduler_name(policies[p]), n,
+                   (double)(enqueued - start) / n, (double)(end - enqueued) / n);
+            
+            run_queue_free(&queue);
+        }
+        
+        free(pcbs);
+    }
+}
+
+// ##########################################
+// DISPATCH SCALING BENCHMARK
+// ##########################################
+// Workers repeatedly take a process and requeue it, as the dispatcher does
+// after every quantum, once through a single mutex-protected run queue (the
+// old design) and once through the work-stealing queues
+
+typedef struct {
+    int worker_id;
+    int use_global_lock;
+    long long deadline_ns;
+    long operations;
+} DispatchBenchArgs;
+
+static pthread_mutex_t bench_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static RunQueue bench_shared_queue;
+static unsigned long bench_shared_seq = 0;
+
+static void* dispatch_bench_thread(void* arg) {
+    DispatchBenchArgs* args = (DispatchBenchArgs*)arg;
+    long operations = 0;
+    
+    while (monotonic_ns() < args->deadline_ns) {
+        for (int i = 0; i < 256; i++) {
+            PCB* process;
+            if (args->use_global_lock) {
+                int level;
+                pthread_mutex_lock(&bench_queue_mutex);
+                process = select_next_process(&bench_shared_queue, &level);
+                pthread_mutex_unlock(&bench_queue_mutex);
+                if (process != NULL) {
+                    pthread_mutex_lock(&bench_queue_mutex);
+                    process->enqueue_seq = bench_shared_seq++;
+                    run_queue_push(&bench_shared_queue, process);
+                    pthread_mutex_unlock(&bench_queue_mutex);
+                }
+            } else {
+                process = dequeue_process(args->worker_id);
+                if (process != NULL) {
+                    requeue_process(args->worker_id, process);
+                }
+            }
+            if (process != NULL) {
+                operations++;
+            }
+        }
+    }
+    
+    args->operations = operations;
+    return NULL;
+}
+
+static double run_dispatch_round(int threads, int use_global_lock, PCB* pcbs, int num_pcbs,
+                                 unsigned long* steals) {
+    DispatchBenchArgs args[MAX_WORKER_QUEUES];
+    pthread_t tids[MAX_WORKER_QUEUES];
+    const long long duration_ns = 200000000LL;
+    
+    num_worker_queues = threads;
+    init_multilevel_queue();
+    run_queue_init(&bench_shared_queue, current_scheduler);
+    for (int i = 0; i < num_pcbs; i++) {
+        pcbs[i].is_queued = 0;
+        if (use_global_lock) {
+            pcbs[i].enqueue_seq = bench_shared_seq++;
+            run_queue_push(&bench_shared_queue, &pcbs[i]);
+        } else {
+            enqueue_process(&pcbs[i]);
+        }
+    }
+    
+    long long deadline = monotonic_ns() + duration_ns;
+    for (int t = 0; t < threads; t++) {
+        args[t].worker_id = t;
+        args[t].use_global_lock = use_global_lock;
+        args[t].deadline_ns = deadline;
+        args[t].operations = 0;
+        pthread_create(&tids[t], NULL, dispatch_bench_thread, &args[t]);
+    }
+    
+    long total = 0;
+    *steals = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        total += args[t].operations;
+        *steals += worker_queues[t].steals;
+    }
+    
+    run_queue_free(&bench_shared_queue);
+    destroy_multilevel_queue();
+    return (double)total * 1e9 / (double)duration_ns;
+}
+
+void run_dispatch_benchmark(int max_threads) {
+    if (max_threads > MAX_WORKER_QUEUES) {
+        max_threads = MAX_WORKER_QUEUES;
+    }
+    
+    int num_pcbs = 64 * max_threads;
+    PCB* pcbs = calloc(num_pcbs, sizeof(PCB));
+    if (pcbs == NULL) {
+        perror("Failed to allocate PCBs");
+        return;
+    }
+    unsigned long state = 7;
+    for (int i = 0; i < num_pcbs; i++) {
+        pcbs[i].priority = (int)(next_random(&state) % 4);
+        pcbs[i].burst_estimate_ms = 1 + (long)(next_random(&state) % 1000);
+        pcbs[i].queue_level = priority_to_level(pcbs[i].priority);
+    }
+    
+    int saved_queues = num_worker_queues;
+    printf("%s Dispatch Scaling Benchmark (%s, %d queued processes)\n\n",
+           OS_NAME, get_scheduler_name(current_scheduler), num_pcbs);
+    printf("%8s %20s %20s %12s\n", "Workers", "Global lock ops/s", "Work stealing ops/s", "Steals");
+    printf("----------------------------------------------------------------\n");
+    
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        unsigned long steals;
+        double locked = run_dispatch_round(threads, 1, pcbs, num_pcbs, &steals);
+        double stealing = run_dispatch_round(threads, 0, pcbs, num_pcbs, &steals);
+        printf("%8d %20.0f %20.0f %12lu\n", threads, locked, stealing, steals);
+    }
+    
+    num_worker_queues = saved_queues;
+    free(pcbs);
+}
+
+// ##########################################
+// LOAD BALANCING BENCHMARK
+// ##########################################
+// All processes arrive on core 0, as after a burst of launches from one
+// shell. Every core worker then runs quanta of the processes it gets, each
+// quantum a pass over the process's own working set, until all of them are
+// done. Compared: cores that keep their placement, idle cores stealing, and
+// stealing plus the periodic balancer.
+
+#define BALANCE_BENCH_QUANTA 100          // Quanta each process needs
+#define BALANCE_BENCH_WORKING_SET (64 * 1024)
+
+typedef struct {
+    int core;
+    PCB* pcbs;
+    unsigned char* memory;      // BALANCE_BENCH_WORKING_SET bytes per process
+} BalanceBenchArgs;
+
+static int balance_bench_remaining = 0;
+
+static void* balance_bench_thread(void* arg) {
+    BalanceBenchArgs* args = (BalanceBenchArgs*)arg;
+    WorkerQueue* core = &worker_queues[args->core];
+    
+    // The worker itself runs on the host CPU behind its core
+    if (core->host_cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core->host_cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    
+    while (__atomic_load_n(&balance_bench_remaining, __ATOMIC_ACQUIRE) > 0) {
+        balance_cores_if_due();
+        
+        PCB* process = dequeue_process(args->core);
+        if (process == NULL) {
+            sched_yield();
+            continue;
+        }
+        
+        record_core_dispatch(args->core, process);
+        unsigned char* memory = args->memory + (size_t)(process - args->pcbs) * BALANCE_BENCH_WORKING_SET;
+        for (int pass = 0; pass < 4; pass++) {
+            for (int i = 0; i < BALANCE_BENCH_WORKING_SET; i += 64) {
+                memory[i]++;
+            }
+        }
+        __atomic_store_n(&core->running, 0, __ATOMIC_RELAXED);
+        
+        if (++process->dispatch_count < BALANCE_BENCH_QUANTA) {
+            requeue_process(args->core, process);
+        } else {
+            __atomic_sub_fetch(&balance_bench_remaining, 1, __ATOMIC_RELEASE);
+        }
+    }
+    return NULL;
+}
+
+static void run_balance_round(const char* label, int stealing, int balancing, PCB* pcbs,
+                              long processes, unsigned char* memory, int cores) {
+    BalanceBenchArgs args[MAX_WORKER_QUEUES];
+    pthread_t tids[MAX_WORKER_QUEUES];
+    
+    num_worker_queues = cores;
+    init_multilevel_queue();
+    assign_host_cpus();
+    work_stealing = stealing;
+    load_balancing = balancing;
+    last_balance_ns = 0;
+    
+    for (long i = 0; i < processes; i++) {
+        pcbs[i].dispatch_count = 0;
+        pcbs[i].last_core = -1;
+        pcbs[i].enqueue_seq = (unsigned long)i;
+        pcbs[i].queue_level = priority_to_level(pcbs[i].priority);
+        pcbs[i].is_queued = 1;
+        queue_on_core(&pcbs[i], 0);
+    }
+    __atomic_store_n(&balance_bench_remaining, (int)processes, __ATOMIC_RELEASE);
+    
+    long long start = monotonic_ns();
+    for (int c = 0; c < cores; c++) {
+        args[c].core = c;
+        args[c].pcbs = pcbs;
+        args[c].memory = memory;
+        pthread_create(&tids[c], NULL, balance_bench_thread, &args[c]);
+    }
+    
+    // Sample the spread of the load while the cores work
+    long long imbalance_sum = 0;
+    long samples = 0;
+    while (__atomic_load_n(&balance_bench_remaining, __ATOMIC_ACQUIRE) > 0) {
+        int busiest, idlest;
+        imbalance_sum += core_imbalance(&busiest, &idlest);
+        samples++;
+        sleep_ms(1);
+    }
+    for (int c = 0; c < cores; c++) {
+        pthread_join(tids[c], NULL);
+    }
+    double elapsed_ms = (monotonic_ns() - start) / 1e6;
+    
+    unsigned long dispatches = 0, redispatches = 0, warm = 0, steals = 0, migrations = 0;
+    for (int c = 0; c < cores; c++) {
+        dispatches += worker_queues[c].dispatches;
+        redispatches += worker_queues[c].redispatches;
+        warm += worker_queues[c].warm_dispatches;
+        steals += worker_queues[c].steals;
+        migrations += worker_queues[c].migrations;
+    }
+    printf("%-22s %12.1f %12.0f %14.1f %9lu %11lu %6.1f%%\n", label, elapsed_ms,
+           dispatches * 1000.0 / elapsed_ms, samples > 0 ? (double)imbalance_sum / samples : 0.0,
+           steals, migrations, redispatches > 0 ? 100.0 * warm / redispatches : 100.0);
+    
+    destroy_multilevel_queue();
+}
+
+void run_balance_benchmark(long processes, int cores) {
+    if (cores > MAX_WORKER_QUEUES) {
+        cores = MAX_WORKER_QUEUES;
+    }
+    
+    PCB* pcbs = calloc(processes, sizeof(PCB));
+    unsigned char* memory = calloc(processes, BALANCE_BENCH_WORKING_SET);
+    if (pcbs == NULL || memory == NULL) {
+        perror("Failed to allocate benchmark processes");
+        free(pcbs);
+        free(memory);
+        return;
+    }
+    unsigned long state = 11;
+    for (long i = 0; i < processes; i++) {
+        pcbs[i].priority = (int)(next_random(&state) % 4);
+        pcbs[i].burst_estimate_ms = 1 + (long)(next_random(&state) % 1000);
+    }
+    
+    int saved_queues = num_worker_queues;
+    int saved_interval = balance_interval_ms;
+    balance_interval_ms = 5;
+    
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    printf("%s Load Balancing Benchmark (%ld processes arrive on core 0 of %d, %d quanta each, %d host CPUs)\n\n",
+           OS_NAME, processes, cores, BALANCE_BENCH_QUANTA, CPU_COUNT(&allowed));
+    printf("%-22s %12s %12s %14s %9s %11s %7s\n", "Mode", "Makespan ms", "Quanta/s",
+           "Avg imbalance", "Steals", "Migrations", "Warm");
+    printf("-----------------------------------------------------------------------------------------------\n");
+    run_balance_round("Fixed placement", 0, 0, pcbs, processes, memory, cores);
+    run_balance_round("Work stealing", 1, 0, pcbs, processes, memory, cores);
+    run_balance_round("Stealing + balancer", 1, 1, pcbs, processes, memory, cores);
+    
+    num_worker_queues = saved_queues;
+    balance_interval_ms = saved_interval;
+    work_stealing = 1;
+    load_balancing = 1;
+    free(pcbs);
+    free(memory);
+}
+
+// ##########################################
+// MULTILEVEL FEEDBACK QUEUE
+// ##########################################
+// Processes start at level 0. A process that keeps the CPU busy for its whole
+// quantum drops one level; one that blocks (mostly I/O, waiting for input)
+// keeps its level. A periodic boost moves everything back to level 0 so
+// CPU-bound processes at the bottom cannot starve.
+
+// CPU time (user + system) a process has consumed, -1 if it is gone
+long read_process_cpu_ms(pid_t pid) {
+    char path[64];
+    char buffer[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (length <= 0) {
+        return -1;
+    }
+    buffer[length] = '\0';
+    
+    // The command name may contain spaces; fields restart after its ')'
+    char* fields = strrchr(buffer, ')');
+    if (fields == NULL) {
+        return -1;
+    }
+    
+    unsigned long utime = 0, stime = 0;
+    if (sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+               &utime, &stime) != 2) {
+        return -1;
+    }
+    
+    static long ticks_per_second = 0;
+    if (ticks_per_second <= 0) {
+        ticks_per_second = sysconf(_SC_CLK_TCK);
+    }
+    return (long)((utime + stime) * 1000 / (unsigned long)ticks_per_second);
+}
+
+// Periodic priority boost; only the worker that wins the CAS runs the pass
+void mlfq_boost_if_due() {
+    if (mlfq_config.boost_interval_ms <= 0) {
+        return;
+    }
+    
+    long long now = monotonic_ns();
+    long long last = __atomic_load_n(&last_boost_ns, __ATOMIC_RELAXED);
+    if (now - last < (long long)mlfq_config.boost_interval_ms * 1000000LL ||
+        !__atomic_compare_exchange_n(&last_boost_ns, &last, now, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return;
+    }
+    
+    // A level change is a table write, so seqlock readers retry across it
+    table_write_lock();
+    for (int i = 0; i < process_table_used; i++) {
+        if (process_table[i].is_active) {
+            process_table[i].mlfq_level = 0;
+        }
+    }
+    table_write_unlock();
+    __atomic_add_fetch(&mlfq_stats.boosts, 1, __ATOMIC_RELAXED);
+    
+    // Queued processes pick up their new level when workers re-sort
+    __atomic_add_fetch(&scheduler_epoch, 1, __ATOMIC_RELEASE);
+}
+
+// Record a finished slot and apply the feedback rules
+void mlfq_account_slot(PCB* process, int level, int elapsed_units, long cpu_ms, long long waited_ns) {
+    __atomic_add_fetch(&mlfq_stats.dispatches[level], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mlfq_stats.run_ms[level],
+                       (unsigned long long)elapsed_units * QUANTUM_UNIT_MS, __ATOMIC_RELAXED);
+    if (waited_ns > 0) {
+        __atomic_add_fetch(&mlfq_stats.wait_ms[level],
+                           (unsigned long long)(waited_ns / 1000000LL), __ATOMIC_RELAXED);
+    }
+    
+    // Only a full quantum can demote; exits and minimizes end the slot early
+    if (elapsed_units < ml_queue.time_quantum[level] || level >= MAX_LEVELS - 1) {
+        return;
+    }
+    
+    // Without CPU accounting every full quantum counts as CPU-bound
+    long slot_ms = (long)elapsed_units * QUANTUM_UNIT_MS;
+    int cpu_bound = cpu_ms < 0 || cpu_ms * 100 >= slot_ms * mlfq_config.cpu_bound_pct;
+    if (cpu_bound) {
+        table_write_lock();
+        int demoted = process->mlfq_level == level;
+        if (demoted) {
+            process->mlfq_level = level + 1;
+        }
+        table_write_unlock();
+        if (demoted) {
+            __atomic_add_fetch(&mlfq_stats.demotions[level], 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void print_mlfq_statistics() {
+    printf("\nMLFQ Level Statistics (boosts so far: %lu)\n", mlfq_stats.boosts);
+    printf("%-6s %-10s %-12s %-12s %-12s %-12s\n",
+           "Level", "Quantum", "Dispatches", "CPU (ms)", "Wait (ms)", "Demotions");
+    printf("---------------------------------------------------------------------\n");
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        printf("%-6d %-10d %-12lu %-12llu %-12llu %-12lu\n", level,
+               ml_queue.time_quantum[level] * QUANTUM_UNIT_MS,
+               mlfq_stats.dispatches[level], mlfq_stats.run_ms[level],
+               mlfq_stats.wait_ms[level], mlfq_stats.demotions[level]);
+    }
+}
+
+// Interactive tuning of the MLFQ policy
+void configure_mlfq() {
+    clear_screen();
+    printf("\n%s - Multilevel Feedback Queue\n", OS_NAME);
+    print_mlfq_statistics();
+    
+    printf("\nCurrent settings: boost every %d ms, CPU-bound above %d%% of a quantum\n\n",
+           mlfq_config.boost_interval_ms, mlfq_config.cpu_bound_pct);
+    
+    int value;
+    for (int level = 0; level < MAX_LEVELS; level++) {
+        printf("Quantum for level %d in units of %d ms (0 to keep %d): ",
+               level, QUANTUM_UNIT_MS, ml_queue.time_quantum[level]);
+        if (scanf("%d", &value) == 1 && value > 0) {
+            ml_queue.time_quantum[level] = value;
+        }
+        while (getchar() != '\n');
+    }
+    
+    printf("Boost interval in ms (0 to keep %d, -1 to disable): ", mlfq_config.boost_interval_ms);
+    if (scanf("%d", &value) == 1 && value != 0) {
+        mlfq_config.boost_interval_ms = value < 0 ? 0 : value;
+    }
+    while (getchar() != '\n');
+    
+    printf("CPU-bound threshold in %% of a quantum (0 to keep %d): ", mlfq_config.cpu_bound_pct);
+    if (scanf("%d", &value) == 1 && value > 0 && value <= 100) {
+        mlfq_config.cpu_bound_pct = value;
+    }
+    while (getchar() != '\n');
+    
+    printf("MLFQ settings updated.\n");
+    ui_delay(2000);
+}
+
+// ##########################################
+// PROCESS TABLE BENCHMARK
+// ##########################################
+// Fills the process table and times PID and name lookups against the
+// linear scans they replaced.
+
+static int scan_process_by_pid(int pid) {
+    for (int i = 0; i < process_table_used; i++) {
+        if (process_table[i].is_active && process_table[i].pid == pid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void run_table_benchmark(long max_entries) {
+    const long lookups = 200000;
+    
+    printf("%s Process Table Benchmark (%ld lookups per size)\n\n", OS_NAME, lookups);
+    printf("%-10s %16s %16s %16s %16s\n", "Entries", "Insert ns/op", "PID ns/op",
+           "Name ns/op", "Scan ns/op");
+    
+    for (long entries = 1000; ; entries *= 10) {
+        if (entries > max_entries) {
+            entries = max_entries;
+        }
+        
+        max_tasks = (int)entries;
+        initialize_process_table();
+        
+        char name[TASK_NAME_LENGTH];
+        long long start = monotonic_ns();
+        for (long i = 0; i < entries; i++) {
+            snprintf(name, sizeof(name), "Task %ld", i);
+            int index = process_table_insert(name);
+            process_table_set_pid(index, (int)(100000 + i * 7));
+        }
+        double insert_ns = (double)(monotonic_ns() - start) / entries;
+        
+        unsigned long state = 12345;
+        long found = 0;
+        start = monotonic_ns();
+        for (long i = 0; i < lookups; i++) {
+            long target = (long)(next_random(&state) % entries);
+            found += find_process_by_pid((int)(100000 + target * 7)) >= 0;
+        }
+        double pid_ns = (double)(monotonic_ns() - start) / lookups;
+        
+        start = monotonic_ns();
+        for (long i = 0; i < lookups; i++) {
+            snprintf(name, sizeof(name), "Task %lu", next_random(&state) % entries);
+            found += find_process_by_name(name, 0) >= 0;
+        }
+        double name_ns = (double)(monotonic_ns() - start) / lookups;
+        
+        // The old linear scan, on fewer lookups since it is O(n)
+        long scan_lookups = lookups / (entries / 1000 + 1) + 1;
+        start = monotonic_ns();
+        for (long i = 0; i < scan_lookups; i++) {
+            long target = (long)(next_random(&state) % entries);
+            found += scan_process_by_pid((int)(100000 + target * 7)) >= 0;
+        }
+        double scan_ns = (double)(monotonic_ns() - start) / scan_lookups;
+        
+        if (found != 2 * lookups + scan_lookups) {
+            printf("Lookup mismatch: %ld found\n", found);
+        }
+        printf("%-10ld %16.1f %16.1f %16.1f %16.1f\n", entries, insert_ns, pid_ns, name_ns, scan_ns);
+        
+        destroy_process_table();
+        if (entries >= max_entries) {
+            break;
+        }
+    }
+}
+
+// ##########################################
+// PROCESS TABLE LOCK BENCHMARK
+// ##########################################
+// Threads launch, terminate and list processes on one shared table, once
+// with every access behind the named POSIX semaphore the table used to have
+// (readers need it too) and once with the futex writer lock and lock-free
+// seqlock readers. Every lookup and list is checked, and at the end the
+// table must hold exactly the processes launched and not terminated.
+
+#define LOCK_BENCH_SLOTS 64     // Processes one thread keeps at most
+
+typedef struct {
+    int thread_id;
+    int use_semaphore;
+    long long deadline_ns;
+    long operations;
+    long errors;                // Lookups that missed, torn list rows
+    int live;
+    int slots[LOCK_BENCH_SLOTS];
+    int pids[LOCK_BENCH_SLOTS];
+} LockBenchArgs;
+
+static sem_t* bench_table_semaphore;
+
+static void bench_table_lock(int use_semaphore) {
+    if (use_semaphore) {
+        while (sem_wait(bench_table_semaphore) == -1 && errno == EINTR);
+    } else {
+        table_write_lock();
+    }
+}
+
+static void bench_table_unlock(int use_semaphore) {
+    if (use_semaphore) {
+        sem_post(bench_table_semaphore);
+    } else {
+        table_write_unlock();
+    }
+}
+
+// A row is torn if its name does not belong to its PID
+static int bench_row_torn(int pid, const char* name) {
+    char expected[TASK_NAME_LENGTH];
+    snprintf(expected, sizeof(expected), "P%d", pid);
+    return pid != -1 && strcmp(name, expected) != 0;
+}
+
+static void* table_lock_bench_thread(void* arg) {
+    LockBenchArgs* args = (LockBenchArgs*)arg;
+    unsigned long state = 977 + args->thread_id;
+    int next_pid = args->thread_id * 10000000;
+    char name[TASK_NAME_LENGTH];
+    
+    while (monotonic_ns() < args->deadline_ns) {
+        for (int op = 0; op < 64; op++) {
+            int choice = (int)(next_random(&state) % 10);
+            if (args->live == 0 || (choice < 4 && args->live < LOCK_BENCH_SLOTS)) {
+                int pid = ++next_pid;
+                snprintf(name, sizeof(name), "P%d", pid);
+                bench_table_lock(args->use_semaphore);
+                int index = process_table_insert(name);
+                if (index >= 0) {
+                    process_table_set_pid(index, pid);
+                }
+                bench_table_unlock(args->use_semaphore);
+                if (index >= 0) {
+                    args->slots[args->live] = index;
+                    args->pids[args->live++] = pid;
+                }
+            } else if (choice < 8 || args->live == LOCK_BENCH_SLOTS) {
+                int victim = (int)(next_random(&state) % args->live);
+                bench_table_lock(args->use_semaphore);
+                if (find_process_by_pid(args->pids[victim]) != args->slots[victim]) {
+                    args->errors++;
+                }
+                process_table_remove(args->slots[victim]);
+                bench_table_unlock(args->use_semaphore);
+                args->live--;
+                args->slots[victim] = args->slots[args->live];
+                args->pids[victim] = args->pids[args->live];
+            } else if (args->use_semaphore) {
+                bench_table_lock(1);
+                for (int i = 0; i < process_table_used; i++) {
+                    if (process_table[i].is_active) {
+                        args->errors += bench_row_torn(process_table[i].pid, process_table[i].name);
+                    }
+                }
+                bench_table_unlock(1);
+            } else {
+                int count = 0;
+                ProcessRow* rows = snapshot_processes(&count);
+                for (int i = 0; i < count; i++) {
+                    args->errors += bench_row_torn(rows[i].pid, rows[i].name);
+                }
+                free(rows);
+            }
+            args->operations++;
+        }
+    }
+    return NULL;
+}
+
+// One timed run; returns operations per second and counts failed checks
+static double run_table_lock_round(int threads, int use_semaphore, long* errors) {
+    const long long duration_ns = 200000000LL;
+    LockBenchArgs* args = calloc(threads, sizeof(LockBenchArgs));
+    pthread_t* ids = calloc(threads, sizeof(pthread_t));
+    if (args == NULL || ids == NULL) {
+        perror("Failed to allocate benchmark threads");
+        free(args);
+        free(ids);
+        return 0;
+    }
+    
+    initialize_process_table();
+    long long start = monotonic_ns();
+    for (int t = 0; t < threads; t++) {
+        args[t].thread_id = t;
+        args[t].use_semaphore = use_semaphore;
+        args[t].deadline_ns = start + duration_ns;
+        pthread_create(&ids[t], NULL, table_lock_bench_thread, &args[t]);
+    }
+    
+    long operations = 0;
+    int live = 0;
+    *errors = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+        operations += args[t].operations;
+        *errors += args[t].errors;
+        live += args[t].live;
+        // Every process a thread still owns must be found where it left it
+        for (int i = 0; i < args[t].live; i++) {
+            *errors += find_process_by_pid(args[t].pids[i]) != args[t].slots[i];
+        }
+    }
+    double seconds = (monotonic_ns() - start) / 1e9;
+    
+    int active = 0;
+    for (int i = 0; i < process_table_used; i++) {
+        active += process_table[i].is_active;
+    }
+    if (active != live || process_count != live) {
+        (*errors)++;
+    }
+    
+    destroy_process_table();
+    free(args);
+    free(ids);
+    return operations / seconds;
+}
+
+void run_table_lock_benchmark(int max_threads) {
+    if (max_threads > 64) {
+        max_threads = 64;
+    }
+    
+    bench_table_semaphore = sem_open("/nexos_bench_sem", O_CREAT, 0644, 1);
+    if (bench_table_semaphore == SEM_FAILED) {
+        perror("Failed to create semaphore");
+        return;
+    }
+    
+    int saved_max_tasks = max_tasks;
+    max_tasks = LOCK_BENCH_SLOTS * max_threads;
+    
+    printf("%s Process Table Lock Benchmark (40%% launch, 40%% terminate, 20%% list)\n\n", OS_NAME);
+    printf("%-8s %18s %18s %10s\n", "Threads", "Semaphore ops/s", "Futex+seq ops/s", "Checks");
+    
+    for (int threads = 1; threads <= max_threads; threads = next_thread_count(threads, max_threads)) {
+        long sem_errors, futex_errors;
+        double semaphore = run_table_lock_round(threads, 1, &sem_errors);
+        double futex = run_table_lock_round(threads, 0, &futex_errors);
+        printf("%-8d %18.0f %18.0f %10s\n", threads, semaphore, futex,
+               sem_errors + futex_errors == 0 ? "ok" : "FAILED");
+    }
+    
+    max_tasks = saved_max_tasks;
+    sem_close(bench_table_semaphore);
+    sem_unlink("/nexos_bench_sem");
+}
+
+// ##########################################
+// LAUNCH LATENCY BENCHMARK
+// ##########################################
+// Launches a trivial program with each launch path the OS has used and
+// times the call itself and the full launch-to-exit round trip. A ballast
+// of touched memory shows how fork() slows down as the parent grows.
+
+typedef enum {
+    LAUNCH_SYSTEM,          // system(path), as launch_task/resume_process did
+    LAUNCH_FORK_CLEAR_EXEC, // fork, system("clear") in the child, execl
+    LAUNCH_FORK_EXEC,       // fork and execl only
+    LAUNCH_SPAWN,           // posix_spawn via spawn_task
+    LAUNCH_CGROUP           // clone3 into a cgroup via spawn_task_in_cgroup
+} LaunchMethod;
+
+// The cgroup LAUNCH_CGROUP clones into: our own, -1 without cgroup v2
+static int launch_cgroup_fd = -1;
+
+static void open_launch_cgroup() {
+    char directory[MAX_PATH_LENGTH * 2];
+    if (launch_cgroup_fd == -1 && find_own_cgroup(directory, sizeof(directory))) {
+        launch_cgroup_fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+}
+
+// Whether the method can run here; clone3 needs a cgroup v2 to land in
+static int launch_available(LaunchMethod method) {
+    return method != LAUNCH_CGROUP || launch_cgroup_fd != -1;
+}
+
+static int compare_long_long(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Launch once; returns the round trip in ns and stores the call time
+static long long time_launch(LaunchMethod method, const char* path, long long* call_ns) {
+    long long start = monotonic_ns();
+    pid_t pid = -1;
+    
+    if (method == LAUNCH_SYSTEM) {
+        system(path);
+        *call_ns = monotonic_ns() - start;
+        return *call_ns;
+    }
+    
+    if (method == LAUNCH_SPAWN) {
+        pid = spawn_task(path, NULL);
+    } else if (method == LAUNCH_CGROUP) {
+        pid = spawn_task_in_cgroup(path, NULL, launch_cgroup_fd);
+    } else {
+        pid = fork();
+        if (pid == 0) {
+            if (method == LAUNCH_FORK_CLEAR_EXEC) {
+                system("clear > /dev/null 2>&1");
+            }
+            execl(path, path, NULL);
+            _exit(127);
+        }
+    }
+    *call_ns = monotonic_ns() - start;
+    
+    if (pid > 0) {
+        int status;
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+    }
+    return monotonic_ns() - start;
+}
+
+void run_launch_benchmark(long launches) {
+    const char* path = "/bin/true";
+    const char* names[] = { "system()", "fork + clear + execl", "fork + execl", "posix_spawn",
+                            "clone3 into cgroup" };
+    const int ballast_mb[] = { 0, 256 };
+    
+    long long* round_trips = malloc(launches * sizeof(long long));
+    if (round_trips == NULL) {
+        perror("Failed to allocate benchmark samples");
+        return;
+    }
+    
+    open_launch_cgroup();
+    printf("%s Launch Latency Benchmark (%ld launches of %s)\n\n", OS_NAME, launches, path);
+    printf("%-22s %8s %12s %12s %12s %12s\n", "Method", "Ballast", "Call us",
+           "p50 us", "p99 us", "Launches/s");
+    
+    for (size_t b = 0; b < sizeof(ballast_mb) / sizeof(ballast_mb[0]); b++) {
+        // Touched memory the parent drags through every fork
+        size_t ballast_bytes = (size_t)ballast_mb[b] << 20;
+        char* ballast = ballast_bytes > 0 ? malloc(ballast_bytes) : NULL;
+        if (ballast != NULL) {
+            memset(ballast, 1, ballast_bytes);
+        }
+        
+        for (int m = LAUNCH_SYSTEM; m <= LAUNCH_CGROUP; m++) {
+            if (!launch_available((LaunchMethod)m)) {
+                printf("%-22s %5d MB %12s   (no cgroup v2)\n", names[m], ballast_mb[b], "n/a");
+                continue;
+            }
+            long long call_total = 0, round_total = 0;
+            for (long i = 0; i < launches; i++) {
+                long long call_ns;
+                round_trips[i] = time_launch((LaunchMethod)m, path, &call_ns);
+                call_total += call_ns;
+                round_total += round_trips[i];
+            }
+            qsort(round_trips, launches, sizeof(long long), compare_long_long);
+            
+            printf("%-22s %5d MB %12.1f %12.1f %12.1f %12.0f\n", names[m], ballast_mb[b],
+                   call_total / 1000.0 / launches,
+                   round_trips[launches / 2] / 1000.0,
+                   round_trips[(launches * 99) / 100] / 1000.0,
+                   launches * 1e9 / round_total);
+        }
+        free(ballast);
+    }
+    free(round_trips);
+}
+
+// ##########################################
+// SCHEDULER SHARE CHECK
+// ##########################################
+// Two CPU-bound tasks compete for a single CPU slot through the real
+// dispatcher, once under FCFS and once under Round Robin. FCFS leaves the
+// slot to the first task until it exits; Round Robin has to split it.
+
+#define SHARE_CHECK_TASKS 2
+
+// CPU time each spinning task got in run_ms; returns 0 if a task did not start
+static int run_share_round(SchedulerType scheduler, const char* path, int run_ms, long cpu_ms[]) {
+    current_scheduler = scheduler;
+    init_multilevel_queue();
+    create_worker_threads();
+    
+    int indexes[SHARE_CHECK_TASKS];
+    int count = 0;
+    for (int t = 0; t < SHARE_CHECK_TASKS; t++) {
+        pid_t pid = spawn_task(path, NULL);
+        if (pid == -1) {
+            break;
+        }
+        char name[TASK_NAME_LENGTH];
+        snprintf(name, sizeof(name), "Spinner %d", t + 1);
+        
+        table_write_lock();
+        int index = process_table_insert(name);
+        process_table_set_pid(index, pid);
+        strcpy(process_table[index].task_path, path);
+        table_write_unlock();
+        
+        supervise_child(index, pid);
+        signal_task(pid, SIGSTOP);
+        enqueue_process(&process_table[index]);
+        indexes[count++] = index;
+    }
+    
+    sleep_ms(run_ms);
+    for (int t = 0; t < count; t++) {
+        cpu_ms[t] = read_process_cpu_ms(process_table[indexes[t]].pid);
+    }
+    
+    stop_children(indexes, count, term_timeout_ms);
+    for (int t = 0; t < count; t++) {
+        table_write_lock();
+        process_table_remove(indexes[t]);
+        table_write_unlock();
+    }
+    cleanup_worker_threads();
+    return count == SHARE_CHECK_TASKS;
+}
+
+int run_share_check(int run_ms) {
+    char path[] = "/tmp/nexos-spin-XXXXXX";
+    int fd = mkstemp(path);
+    const char* script = "#!/bin/sh\nwhile :; do :; done\n";
+    if (fd < 0 || write(fd, script, strlen(script)) != (ssize_t)strlen(script) || fchmod(fd, 0700) != 0) {
+        perror("Failed to write the spinning task");
+        if (fd >= 0) {
+            close(fd);
+            unlink(path);
+        }
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    
+    // The supervisor reads SIGCHLD through a signalfd
+    sigset_t child_signal;
+    sigemptyset(&child_signal);
+    sigaddset(&child_signal, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &child_signal, NULL);
+    
+    hardware.cpu_cores = 1;
+    max_tasks = SHARE_CHECK_TASKS;
+    initialize_process_table();
+    start_child_supervisor();
+    
+    SchedulerType schedulers[] = { SCHEDULER_FCFS, SCHEDULER_RR };
+    double first_share[2] = { 0, 0 };
+    int started = 1;
+    
+    printf("%s Scheduler Share Check (%d CPU-bound tasks, 1 CPU slot, %d ms)\n\n",
+           OS_NAME, SHARE_CHECK_TASKS, run_ms);
+    printf("%-28s %12s %12s %12s\n", "Scheduler", "Task 1 ms", "Task 2 ms", "Task 1 share");
+    for (int s = 0; s < 2 && started; s++) {
+        long cpu_ms[SHARE_CHECK_TASKS] = { 0, 0 };
+        started = run_share_round(schedulers[s], path, run_ms, cpu_ms);
+        long total = cpu_ms[0] + cpu_ms[1];
+        first_share[s] = total > 0 ? (double)cpu_ms[0] / total : 0;
+        printf("%-28s %12ld %12ld %11.0f%%\n", get_scheduler_name(schedulers[s]),
+               cpu_ms[0], cpu_ms[1], first_share[s] * 100);
+    }
+    
+    stop_child_supervisor();
+    destroy_multilevel_queue();
+    destroy_process_table();
+    unlink(path);
+    
+    // FCFS keeps the slot on one task, Round Robin alternates
+    int passed = started && first_share[0] > 0.9 && first_share[1] > 0.25 && first_share[1] < 0.75;
+    printf("\n%s\n", passed ? "OK: the schedulers share the CPU slot differently"
+                            : "FAILED: FCFS and Round Robin did not share the CPU slot as expected");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ##########################################
+// TASK REGISTRY BENCHMARK
+// ##########################################
+// Writes registries of growing size and times loading them and looking
+// applications up by name, next to the linear scan find_task_id used.
+// Loading 10000 applications is meant to take under a millisecond; the run
+// fails when the median load of that size misses it.
+
+#define REGISTRY_BENCH_LOADS 21
+#define REGISTRY_TARGET_TASKS 10000
+#define REGISTRY_TARGET_US 1000
+
+static int write_bench_registry(const char* path, long tasks) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "# name | path | ram_mb | hdd_gb | priority | max_ram | max_hdd | max_cores\n");
+    for (long i = 0; i < tasks; i++) {
+        int ram = 64 << (i % 4);
+        fprintf(file, "Application %ld | ./tasks/app%ld.sh | %d | %ld | %ld | %d | %ld | %ld\n",
+                i, i % 1000, ram, 1 + i % 20, i % 4, 2 * ram, 1 + i % 20, 1 + i % 2);
+    }
+    return fclose(file);
+}
+
+int run_registry_benchmark(long tasks) {
+    const long lookups = 200000;
+    double target_p50_us = -1;
+    if (tasks > 1000000) {
+        tasks = 1000000;
+    }
+    
+    char path[] = "/tmp/nexos-registry-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    
+    printf("%s Task Registry Benchmark (%d loads, %ld lookups per size)\n\n",
+           OS_NAME, REGISTRY_BENCH_LOADS, lookups);
+    printf("%-10s %10s %14s %14s %14s %14s\n", "Tasks", "File KB", "Load us p50",
+           "Load us min", "Lookup ns/op", "Scan ns/op");
+    
+    for (long size = 10; ; size *= 10) {
+        if (size > tasks) {
+            size = tasks;
+        }
+        if (write_bench_registry(path, size) != 0) {
+            perror(path);
+            break;
+        }
+        struct stat st;
+        stat(path, &st);
+        
+        long long loads[REGISTRY_BENCH_LOADS];
+        for (int l = 0; l < REGISTRY_BENCH_LOADS; l++) {
+            TaskRegistry registry;
+            long long start = monotonic_ns();
+            int loaded = load_task_registry(path, &registry);
+            loads[l] = monotonic_ns() - start;
+            if (loaded != size) {
+                printf("Loaded %d of %ld tasks\n", loaded, size);
+            }
+            if (loaded > 0) {
+                install_task_registry(&registry);
+            }
+        }
+        qsort(loads, REGISTRY_BENCH_LOADS, sizeof(long long), compare_long_long);
+        
+        char name[TASK_NAME_LENGTH];
+        unsigned long state = 12345;
+        long found = 0;
+        long long start = monotonic_ns();
+        for (long i = 0; i < lookups; i++) {
+            snprintf(name, sizeof(name), "application %lu", next_random(&state) % size);
+            found += find_registered_task(name) >= 0;
+        }
+        double lookup_ns = (double)(monotonic_ns() - start) / lookups;
+        
+        // Menus used to strcasecmp their way down the whole list; large
+        // registries get fewer of those lookups to keep the run short
+        long scan_lookups = lookups / (size / 100 + 1) + 1;
+        start = monotonic_ns();
+        for (long i = 0; i < scan_lookups; i++) {
+            snprintf(name, sizeof(name), "application %lu", next_random(&state) % size);
+            for (int t = 0; t < num_available_tasks; t++) {
+                if (strcasecmp(available_tasks[t].name, name) == 0) {
+                    found++;
+                    break;
+                }
+            }
+        }
+        double scan_ns = (double)(monotonic_ns() - start) / scan_lookups;
+        
+        if (found != lookups + scan_lookups) {
+            printf("Lookup mismatch: %ld found\n", found);
+        }
+        printf("%-10ld %10.1f %14.1f %14.1f %14.1f %14.1f\n", size, st.st_size / 1024.0,
+               loads[REGISTRY_BENCH_LOADS / 2] / 1000.0, loads[0] / 1000.0, lookup_ns, scan_ns);
+        if (size == REGISTRY_TARGET_TASKS) {
+            target_p50_us = loads[REGISTRY_BENCH_LOADS / 2] / 1000.0;
+        }
+        if (size >= tasks) {
+            break;
+        }
+    }
+    unlink(path);
+    
+    if (target_p50_us < 0) {
+        return EXIT_SUCCESS;
+    }
+    int met = target_p50_us < REGISTRY_TARGET_US;
+    printf("\n%s: %d applications load in %.1f us (p50), target %d us\n", met ? "OK" : "MISSED",
+           REGISTRY_TARGET_TASKS, target_p50_us, REGISTRY_TARGET_US);
+    return met ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ##########################################
+// TERMINAL MULTIPLEXER BENCHMARK
+// ##########################################
+// Runs one interactive task (cat) next to 0 up to <n> tasks that write as
+// fast as they can (yes), each on its own pseudo-terminal, and times how
+// long a keystroke takes to come back through the console thread. Also
+// reports how much output was drained and how evenly the chatty tasks
+// were served.
+
+#define CONSOLE_BENCH_ECHOES 200
+
+static pid_t start_bench_console(int index, const char* path) {
+    char tty_path[64];
+    int master_fd = open_console(tty_path, sizeof(tty_path));
+    if (master_fd == -1) {
+        perror("Failed to open a pseudo-terminal");
+        return -1;
+    }
+    pid_t pid = spawn_task(path, tty_path);
+    if (pid == -1) {
+        close(master_fd);
+        return -1;
+    }
+    set_console(index, master_fd);
+    return pid;
+}
+
+static unsigned long long console_head(int index) {
+    pthread_mutex_lock(&consoles[index].lock);
+    unsigned long long head = consoles[index].head;
+    pthread_mutex_unlock(&consoles[index].lock);
+    return head;
+}
+
+// One round with a given number of chatty tasks; returns 0 on success
+static int run_console_round(int chatty, long long* echo_ns, double* drained_mb_s,
+                             double* min_share, double* max_share) {
+    pid_t* pids = malloc((chatty + 1) * sizeof(pid_t));
+    unsigned long long* heads = malloc((chatty + 1) * sizeof(unsigned long long));
+    if (pids == NULL || heads == NULL) {
+        free(pids);
+        free(heads);
+        return -1;
+    }
+    
+    int started = 0, failed = 0;
+    for (int i = 0; i <= chatty && !failed; i++) {
+        pids[i] = start_bench_console(i, i == 0 ? "/bin/cat" : "/usr/bin/yes");
+        failed = pids[i] == -1;
+        started += !failed;
+    }
+    
+    if (!failed) {
+        sleep_ms(100); // Let the chatty tasks fill their terminals
+        for (int i = 1; i <= chatty; i++) {
+            heads[i] = console_head(i);
+        }
+        long long start = monotonic_ns();
+        
+        for (int e = 0; e < CONSOLE_BENCH_ECHOES && !failed; e++) {
+            // The terminal echoes the key at once; a newline now and then
+            // keeps cat's line short
+            char key = e % 64 == 63 ? '\n' : 'x';
+            unsigned long long before = console_head(0);
+            long long sent = monotonic_ns();
+            pthread_mutex_lock(&consoles[0].lock);
+            failed = consoles[0].master_fd == -1 || write(consoles[0].master_fd, &key, 1) != 1;
+            pthread_mutex_unlock(&consoles[0].lock);
+            while (!failed && console_head(0) == before) {
+                if (monotonic_ns() - sent > 1000000000LL) {
+                    failed = 1; // No echo within a second
+                }
+                sched_yield();
+            }
+            echo_ns[e] = monotonic_ns() - sent;
+        }
+        
+        double seconds = (monotonic_ns() - start) / 1e9;
+        unsigned long long total = 0, least = ULLONG_MAX, most = 0;
+        for (int i = 1; i <= chatty; i++) {
+            unsigned long long drained = console_head(i) - heads[i];
+            total += drained;
+            least = drained < least ? drained : least;
+            most = drained > most ? drained : most;
+        }
+        double mean = chatty > 0 ? (double)total / chatty : 0;
+        *drained_mb_s = total / seconds / (1024.0 * 1024.0);
+        *min_share = mean > 0 ? least / mean : 0;
+        *max_share = mean > 0 ? most / mean : 0;
+    }
+    
+    for (int i = 0; i < started; i++) {
+        kill(pids[i], SIGKILL);
+        while (waitpid(pids[i], NULL, 0) == -1 && errno == EINTR);
+        set_console(i, -1);
+    }
+    free(pids);
+    free(heads);
+    return failed ? -1 : 0;
+}
+
+void run_console_benchmark(int max_chatty) {
+    long long echo_ns[CONSOLE_BENCH_ECHOES];
+    
+    max_tasks = max_chatty + 1;
+    start_console_multiplexer();
+    
+    printf("%s Terminal Multiplexer Benchmark (%d keystrokes per round)\n\n", OS_NAME, CONSOLE_BENCH_ECHOES);
+    printf("%-8s %14s %10s %10s %12s %12s\n", "Chatty", "Drained MB/s", "Min share", "Max share",
+           "Echo p50 us", "Echo p99 us");
+    
+    for (int chatty = 0; chatty <= max_chatty; chatty = chatty == 0 ? 1 : next_thread_count(chatty, max_chatty)) {
+        double drained = 0, min_share = 0, max_share = 0;
+        if (run_console_round(chatty, echo_ns, &drained, &min_share, &max_share) != 0) {
+            printf("%-8d %14s\n", chatty, "FAILED");
             break;
         }
+        qsort(echo_ns, CONSOLE_BENCH_ECHOES, sizeof(long long), compare_long_long);
+        printf("%-8d %14.1f %9.0f%% %9.0f%% %12.1f %12.1f\n", chatty, drained,
+               min_share * 100, max_share * 100,
+               echo_ns[CONSOLE_BENCH_ECHOES / 2] / 1000.0,
+               echo_ns[(CONSOLE_BENCH_ECHOES * 99) / 100] / 1000.0);
+    }
+    
+    stop_console_multiplexer();
+}
+
+// ##########################################
+// TRACING BENCHMARK
+// ##########################################
+// Records <n> events on 1 up to 8 threads at once, with tracing off and on,
+// and times one dump of the full rings
+
+#define TRACE_BENCH_MAX_THREADS 8
+
+typedef struct {
+    long events;
+    long long elapsed_ns;
+} TraceBenchArgs;
+
+static void* trace_bench_thread(void* arg) {
+    TraceBenchArgs* bench = (TraceBenchArgs*)arg;
+    struct timespec start, end;
+    
+    // CPU time of this thread, so threads sharing a host CPU are not charged for each other
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    for (long i = 0; i < bench->events; i++) {
+        trace_event(TRACE_ENQUEUE, (int)i, (int)(i % MAX_LEVELS), 0);
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    bench->elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+    return NULL;
+}
+
+static double time_trace_threads(int threads, long events) {
+    pthread_t ids[TRACE_BENCH_MAX_THREADS];
+    TraceBenchArgs args[TRACE_BENCH_MAX_THREADS];
+    long long total_ns = 0;
+    
+    for (int t = 0; t < threads; t++) {
+        args[t].events = events;
+        args[t].elapsed_ns = 0;
+        pthread_create(&ids[t], NULL, trace_bench_thread, &args[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+        total_ns += args[t].elapsed_ns;
+    }
+    return (double)total_ns / ((double)threads * events);
+}
+
+void run_trace_benchmark(long events) {
+    printf("%s Tracing Benchmark (%ld events per thread, %d-event rings)\n\n",
+           OS_NAME, events, TRACE_RING_EVENTS);
+    printf("%-8s %-14s %-14s\n", "Threads", "Off (ns/ev)", "On (ns/ev)");
+    
+    trace_start_ns = monotonic_ns();
+    trace_start_ticks = trace_clock();
+    for (int threads = 1; threads <= TRACE_BENCH_MAX_THREADS; threads *= 2) {
+        tracing_enabled = 0;
+        double off = time_trace_threads(threads, events);
+        tracing_enabled = 1;
+        double on = time_trace_threads(threads, events);
+        printf("%-8d %-14.1f %-14.1f\n", threads, off, on);
+    }
+    
+    // Dump what the last round left behind
+    char* buffer = NULL;
+    size_t size = 0;
+    FILE* out = open_memstream(&buffer, &size);
+    if (out != NULL) {
+        long long start = monotonic_ns();
+        write_trace(out);
+        fclose(out);
+        printf("\nDump of %d rings: %.1f ms, %.1f MB of JSON\n",
+               trace_ring_count,
+               (monotonic_ns() - start) / 1e6, size / 1e6);
+        free(buffer);
+    }
+    
+    tracing_enabled = 0;
+    for (int r = 0; r < trace_ring_count; r++) {
+        free(trace_rings[r].events);
+        trace_rings[r].events = NULL;
+    }
+}
+
+// ##########################################
+// PROCESS ACCOUNTING BENCHMARK
+// ##########################################
+// Starts <n> sleeping children and times the supervisor's sampling pass over
+// all of them, to check the Task Manager can refresh every second
+
+#define USAGE_BENCH_MAX_TASKS 4096
+
+void run_usage_benchmark(long tasks) {
+    if (tasks > USAGE_BENCH_MAX_TASKS) {
+        tasks = USAGE_BENCH_MAX_TASKS;
+    }
+    
+    pid_t* pids = malloc(tasks * sizeof(pid_t));
+    if (pids == NULL) {
+        perror("Failed to allocate PIDs");
+        return;
+    }
+    
+    char* const argv[] = { "sleep", "60", NULL };
+    long started = 0;
+    for (long i = 0; i < tasks; i++) {
+        if (posix_spawn(&pids[started], "/bin/sleep", NULL, NULL, argv, environ) == 0) {
+            started++;
+        }
+    }
+    if (started == 0) {
+        fprintf(stderr, "Could not start /bin/sleep\n");
+        free(pids);
+        return;
+    }
+    
+    printf("%s Process Accounting Benchmark (%ld live processes, stat + status + io each)\n\n",
+           OS_NAME, started);
+    
+    TaskUsage usage;
+    long rss_kb;
+    long sampled = 0;
+    const int passes = 20;
+    long long start = monotonic_ns();
+    for (int pass = 0; pass < passes; pass++) {
+        for (long i = 0; i < started; i++) {
+            sampled += read_task_usage(pids[i], &usage, &rss_kb);
+        }
+    }
+    double pass_ms = (monotonic_ns() - start) / 1e6 / passes;
+    
+    printf("Pass over all processes: %.2f ms (%.1f us per process, %ld/%ld sampled)\n",
+           pass_ms, pass_ms * 1000.0 / started, sampled / passes, started);
+    printf("Supervisor sampling every %d ms: %.2f%% of one CPU\n",
+           USAGE_SAMPLE_MS, pass_ms * 100.0 / USAGE_SAMPLE_MS);
+    printf("Last process: %ld ms CPU, max RSS %ld KB, %ld/%ld context switches, %lld bytes read\n",
+           usage.user_ms + usage.system_ms, usage.max_rss_kb, usage.voluntary_switches,
+           usage.involuntary_switches, usage.read_bytes);
+    
+    for (long i = 0; i < started; i++) {
+        kill(pids[i], SIGKILL);
+    }
+    for (long i = 0; i < started; i++) {
+        waitpid(pids[i], NULL, 0);
+    }
+    free(pids);
+}
+
+// ##########################################
+// RAM ALLOCATOR BENCHMARK
+// ##########################################
+// Churns task-sized allocations through every placement algorithm at high
+// occupancy and reports latency, fragmentation and how often a 256 MB task
+// (Minesweeper) could not be placed although enough RAM was free in total.
+
+void run_alloc_benchmark(long operations, int ram_mb, unsigned long seed) {
+    RamAllocatorType types[] = { RAM_FIRST_FIT, RAM_BEST_FIT, RAM_WORST_FIT, RAM_NEXT_FIT, RAM_BUDDY };
+    int* live_base = malloc((ram_mb + 1) * sizeof(int));
+    int* live_size = malloc((ram_mb + 1) * sizeof(int));
+    if (live_base == NULL || live_size == NULL) {
+        perror("Failed to allocate benchmark state");
+        free(live_base);
+        free(live_size);
+        return;
+    }
+    
+    printf("%s RAM Allocator Benchmark (%ld operations on %d MB)\n\n", OS_NAME, operations, ram_mb);
+    printf("%-10s %10s %10s %10s %10s %10s %14s\n", "Allocator", "Alloc ns", "Failed",
+           "Ext frag", "Int frag", "Holes", "256 MB blocked");
+    
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        RamAllocator ram;
+        ram_allocator_init(&ram, types[t], ram_mb);
+        unsigned long state = seed * 2654435761UL + 1;
+        int live = 0;
+        long long big_attempts = 0, big_blocked = 0;
+        double external_sum = 0, internal_sum = 0, holes_sum = 0;
+        long samples = 0;
+        
+        for (long op = 0; op < operations; op++) {
+            // Keep the RAM around 90% full: allocate below, free above
+            int want_alloc = live == 0 || (ram.free_mb > ram_mb / 10 && next_random(&state) % 100 < 55);
+            if (want_alloc) {
+                const Task* task = &available_tasks[next_random(&state) % num_available_tasks];
+                int size = task->ram_required;
+                int base = ram_alloc(&ram, size);
+                if (size == 256) {
+                    big_attempts++;
+                    if (base < 0 && ram.free_mb >= size) {
+                        big_blocked++;
+                    }
+                }
+                if (base >= 0) {
+                    live_base[live] = base;
+                    live_size[live] = size;
+                    live++;
+                }
+            } else {
+                int victim = (int)(next_random(&state) % live);
+                ram_free(&ram, live_base[victim], live_size[victim]);
+                live--;
+                live_base[victim] = live_base[live];
+                live_size[victim] = live_size[live];
+            }
+            
+            if (op % 64 == 0) {
+                RamStats stats;
+                ram_allocator_stats(&ram, &stats);
+                external_sum += stats.external;
+                internal_sum += stats.internal;
+                holes_sum += stats.holes;
+                samples++;
+            }
+        }
+        
+        long long attempts = ram.allocations + ram.failures;
+        printf("%-10s %10.1f %9.2f%% %9.1f%% %9.1f%% %10.1f %13.1f%%\n",
+               ram_allocator_name(types[t]),
+               attempts > 0 ? (double)ram.alloc_ns / attempts : 0.0,
+               attempts > 0 ? 100.0 * ram.failures / attempts : 0.0,
+               samples > 0 ? 100.0 * external_sum / samples : 0.0,
+               samples > 0 ? 100.0 * internal_sum / samples : 0.0,
+               samples > 0 ? holes_sum / samples : 0.0,
+               big_attempts > 0 ? 100.0 * big_blocked / big_attempts : 0.0);
+        ram_allocator_destroy(&ram);
+    }
+    
+    free(live_base);
+    free(live_size);
+}
+
+// ##########################################
+// RESOURCE ACCOUNTING BENCHMARK
+// ##########################################
+// Launcher threads hammer the resource pool with reserve/release pairs:
+// the CAS counters alone, the same counters behind a mutex (the old
+// allocate_resources) and full reservations including RAM placement.
+
+typedef enum {
+    ACCOUNT_CAS,
+    ACCOUNT_MUTEX,
+    ACCOUNT_RESERVATION
+} AccountingMethod;
+
+typedef struct {
+    AccountingMethod method;
+    long long deadline_ns;
+    long long operations;
+    long long failures;
+} AccountingBenchArgs;
+
+pthread_mutex_t bench_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+ResourceCounts bench_pool;
+
+static void* accounting_bench_thread(void* arg) {
+    AccountingBenchArgs* args = (AccountingBenchArgs*)arg;
+    long long operations = 0, failures = 0;
+    
+    do {
+        for (int i = 0; i < 256; i++) {
+            if (args->method == ACCOUNT_CAS) {
+                if (take_resources(64, 1, 1)) {
+                    adjust_resources(64, 1, 1);
+                } else {
+                    failures++;
+                }
+            } else if (args->method == ACCOUNT_MUTEX) {
+                pthread_mutex_lock(&bench_pool_mutex);
+                int taken = bench_pool.ram_mb >= 64 && bench_pool.hdd_gb >= 1 && bench_pool.cores > 0;
+                if (taken) {
+                    bench_pool.ram_mb -= 64;
+                    bench_pool.hdd_gb -= 1;
+                    bench_pool.cores--;
+                }
+                pthread_mutex_unlock(&bench_pool_mutex);
+                if (taken) {
+                    pthread_mutex_lock(&bench_pool_mutex);
+                    bench_pool.ram_mb += 64;
+                    bench_pool.hdd_gb += 1;
+                    bench_pool.cores++;
+                    pthread_mutex_unlock(&bench_pool_mutex);
+                } else {
+                    failures++;
+                }
+            } else {
+                ResourceReservation reservation;
+                if (reserve_resources(&reservation, 64, 1)) {
+                    release_reservation(&reservation);
+                    release_reservation(&reservation); // Must be a no-op
+                } else {
+                    failures++;
+                }
+            }
+            operations++;
+        }
+    } while (monotonic_ns() < args->deadline_ns);
+    
+    args->operations = operations;
+    args->failures = failures;
+    return NULL;
+}
+
+void run_resource_benchmark(int max_threads) {
+    const long long duration_ns = 200000000LL; // 200 ms per run
+    ResourceCounts pool = { 64 * 1024, 64 * 1024, POOL_CORES_MAX };
+    
+    if (max_threads > 64) {
+        max_threads = 64;
+    }
+    
+    AccountingBenchArgs* args = calloc(max_threads, sizeof(AccountingBenchArgs));
+    pthread_t* threads = calloc(max_threads, sizeof(pthread_t));
+    if (args == NULL || threads == NULL) {
+        perror("Failed to allocate benchmark threads");
+        free(args);
+        free(threads);
+        return;
+    }
+    
+    // Reservations place their RAM like real launches do
+    ram_allocator_init(&ram_allocator, RAM_FIRST_FIT, pool.ram_mb);
+    
+    printf("%s Resource Accounting Benchmark (reserve + release of 64 MB, 1 GB, 1 core)\n\n", OS_NAME);
+    printf("%-8s %16s %16s %16s %8s\n", "Threads", "CAS (Mops/s)", "Mutex (Mops/s)", "Reserve (Mops/s)", "Pool");
+    
+    for (int threads_used = 1; threads_used <= max_threads; threads_used = next_thread_count(threads_used, max_threads)) {
+        double mops[3];
+        int balanced = 1;
+        
+        for (int method = ACCOUNT_CAS; method <= ACCOUNT_RESERVATION; method++) {
+            init_resource_pool(pool.ram_mb, pool.hdd_gb, pool.cores);
+            bench_pool = pool;
+            
+            long long start = monotonic_ns();
+            for (int t = 0; t < threads_used; t++) {
+                args[t].method = (AccountingMethod)method;
+                args[t].deadline_ns = start + duration_ns;
+                if (pthread_create(&threads[t], NULL, accounting_bench_thread, &args[t]) != 0) {
+                    perror("Failed to create benchmark thread");
+                    threads_used = t;
+                    break;
+                }
+            }
+            
+            long long operations = 0, failures = 0;
+            for (int t = 0; t < threads_used; t++) {
+                pthread_join(threads[t], NULL);
+                operations += args[t].operations;
+                failures += args[t].failures;
+            }
+            double seconds = (monotonic_ns() - start) / 1e9;
+            mops[method] = operations / seconds / 1e6;
+            
+            // Everything taken must have come back exactly once
+            ResourceCounts left = method == ACCOUNT_MUTEX ? bench_pool : available_resources();
+            if (failures > 0 || left.ram_mb != pool.ram_mb || left.hdd_gb != pool.hdd_gb ||
+                left.cores != pool.cores) {
+                balanced = 0;
+            }
+        }
+        
+        printf("%-8d %16.2f %16.2f %16.2f %8s\n", threads_used,
+               mops[ACCOUNT_CAS], mops[ACCOUNT_MUTEX], mops[ACCOUNT_RESERVATION],
+               balanced ? "ok" : "LEAKED");
+    }
+    
+    ram_allocator_destroy(&ram_allocator);
+    free(args);
+    free(threads);
+}
+
+// ##########################################
+// DEADLOCK AVOIDANCE BENCHMARK
+// ##########################################
+// Drives random requests and releases of thousands of processes through the
+// claim engine in both modes. Reports the cost per request, how often the
+// Banker's fast path applies, the incremental safety check next to the
+// textbook O(n^2) one, and the cost of a wait-for graph detection pass.
+
+// Textbook safety check: rescan all processes until none can finish
+static int naive_is_safe(const ClaimTable* table, unsigned char* done) {
+    int work[NUM_RESOURCE_TYPES];
+    int remaining = table->active_count;
+    memcpy(work, table->available, sizeof(work));
+    memset(done, 0, table->capacity);
+    
+    for (int progress = 1; progress && remaining > 0; ) {
+        progress = 0;
+        for (int id = 0; id < table->capacity; id++) {
+            if (table->status[id] == CLAIM_UNUSED || done[id]) {
+                continue;
+            }
+            int fits = 1;
+            for (int r = 0; r < NUM_RESOURCE_TYPES && fits; r++) {
+                fits = claim_need(table, id, r) <= work[r];
+            }
+            if (fits) {
+                for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+                    work[r] += CLAIM_AT(table, alloc, id, r);
+                }
+                done[id] = 1;
+                remaining--;
+                progress = 1;
+            }
+        }
+    }
+    return remaining == 0;
+}
+
+// Random request/release churn; returns ns per operation
+static double churn_claims(ClaimTable* table, int operations, unsigned long* state) {
+    int n = table->capacity;
+    long long start = monotonic_ns();
+    
+    for (int op = 0; op < operations; op++) {
+        int id = (int)(next_random(state) % n);
+        int amount[NUM_RESOURCE_TYPES];
+        
+        if (next_random(state) % 10 < 4) {
+            for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+                amount[r] = (CLAIM_AT(table, alloc, id, r) + 1) / 2;
+            }
+            claim_release(table, id, amount);
+            continue;
+        }
+        if (table->status[id] == CLAIM_WAITING) {
+            if (table->mode == DEADLOCK_DETECT) {
+                continue; // Stays blocked, the detector looks at these
+            }
+            table->status[id] = CLAIM_ACTIVE; // Gives up and asks again later
+        }
+        for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+            int need = claim_need(table, id, r);
+            amount[r] = need > 0 ? (int)(next_random(state) % (unsigned long)(need / 2 + 1)) : 0;
+        }
+        claim_request(table, id, amount);
+    }
+    return (double)(monotonic_ns() - start) / operations;
+}
+
+void run_deadlock_benchmark(long max_processes) {
+    printf("%s Deadlock Avoidance Benchmark (random requests and releases)\n\n", OS_NAME);
+    printf("%-9s %7s %9s %7s %7s %7s %9s %9s %9s %10s %9s %10s\n", "Processes", "Ops", "Avoid ns",
+           "Fast", "Prefix", "Full", "Check us", "Full us", "Naive us", "Detect ns", "Detect us", "Deadlocked");
+    
+    for (long n = 100; n <= max_processes; n *= 10) {
+        // Fewer operations for big tables keep every size within seconds
+        int operations = (int)(20000000 / n);
+        operations = operations > 200000 ? 200000 : (operations < 2000 ? 2000 : operations);
+        // Enough for everybody to run, not for everybody's maximum at once
+        int total[NUM_RESOURCE_TYPES] = { (int)(n * 96), (int)(n * 4), (int)(n / 2 + 4) };
+        ClaimTable avoid, detect;
+        unsigned char* done = malloc(n);
+        if (done == NULL) {
+            perror("Failed to allocate benchmark state");
+            return;
+        }
+        
+        claim_table_init(&avoid, (int)n, total, DEADLOCK_AVOID);
+        claim_table_init(&detect, (int)n, total, DEADLOCK_DETECT);
+        unsigned long state = 12345;
+        for (int id = 0; id < n; id++) {
+            int max[NUM_RESOURCE_TYPES] = {
+                64 + (int)(next_random(&state) % 449),
+                1 + (int)(next_random(&state) % 16),
+                1 + (int)(next_random(&state) % 4)
+            };
+            claim_register(&avoid, id, max);
+            claim_register(&detect, id, max);
+        }
+        
+        // Start from a loaded machine: everybody holds about the same share of
+        // its claim and roughly two maximum claims are left free
+        long long claimed[NUM_RESOURCE_TYPES] = { 0 };
+        for (int id = 0; id < n; id++) {
+            for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+                claimed[r] += CLAIM_AT(&avoid, max, id, r);
+            }
+        }
+        int reserve[NUM_RESOURCE_TYPES] = { 2 * 512, 2 * 16, 2 * 4 };
+        avoid.mode = DEADLOCK_DETECT; // Fill without checks; the result is safe by construction
+        for (int id = 0; id < n; id++) {
+            int initial[NUM_RESOURCE_TYPES];
+            for (int r = 0; r < NUM_RESOURCE_TYPES; r++) {
+                double share = (double)(total[r] - reserve[r]) / claimed[r];
+                double exact = CLAIM_AT(&avoid, max, id, r) * (share < 1.0 ? share : 1.0);
+                initial[r] = (int)(exact + (next_random(&state) % 1000) / 1000.0); // Round randomly
+            }
+            claim_request(&avoid, id, initial);
+            claim_request(&detect, id, initial);
+        }
+        avoid.mode = DEADLOCK_AVOID;
+        if (!claim_is_safe(&avoid)) {
+            printf("ERROR: The loaded machine is not in a safe state!\n");
+        }
+        avoid.requests = avoid.grants = avoid.waits = 0;
+        avoid.fast_paths = avoid.prefix_checks = avoid.full_checks = avoid.check_ns = 0;
+        
+        unsigned long avoid_state = 1, detect_state = 1;
+        double avoid_ns = churn_claims(&avoid, operations, &avoid_state);
+        double detect_ns = churn_claims(&detect, operations, &detect_state);
+        
+        long long checks = avoid.prefix_checks + avoid.full_checks;
+        long long decided = avoid.fast_paths + checks;
+        double check_us = checks > 0 ? avoid.check_ns / 1e3 / checks : 0.0;
+        double share = decided > 0 ? 100.0 / decided : 0.0;
+        
+        // A full check from scratch next to the textbook one, which is
+        // quadratic and stops being timed once it gets slow
+        int full_runs = n <= 1000 ? 50 : 3;
+        long long full_start = monotonic_ns();
+        for (int i = 0; i < full_runs; i++) {
+            claim_is_safe(&avoid);
+        }
+        double full_us = (monotonic_ns() - full_start) / 1e3 / full_runs;
+        char naive[32] = "-";
+        if (n <= 10000) {
+            int runs = n <= 1000 ? 50 : 3;
+            long long start = monotonic_ns();
+            for (int i = 0; i < runs; i++) {
+                naive_is_safe(&avoid, done);
+            }
+            snprintf(naive, sizeof(naive), "%.1f", (monotonic_ns() - start) / 1e3 / runs);
+        }
+        
+        int runs = 20, deadlocked = 0;
+        long long start = monotonic_ns();
+        for (int i = 0; i < runs; i++) {
+            deadlocked = detect_deadlock(&detect, NULL);
+        }
+        double detect_us = (monotonic_ns() - start) / 1e3 / runs;
+        
+        printf("%-9ld %7d %9.0f %6.1f%% %6.1f%% %6.1f%% %9.1f %9.1f %9s %10.0f %9.1f %10d\n", n, operations,
+               avoid_ns, avoid.fast_paths * share, avoid.prefix_checks * share, avoid.full_checks * share,
+               check_us, full_us, naive, detect_ns, detect_us, deadlocked);
+        if (!claim_is_safe(&avoid)) {
+            printf("ERROR: Banker's state became unsafe!\n");
+        }
+        
+        claim_table_destroy(&avoid);
+        claim_table_destroy(&detect);
+        free(done);
+    }
+}
+
+#ifdef NEXOS_BENCH
+// ##########################################
+// BENCHMARK SUITE
+// ##########################################
+// `make bench` builds main.c with -DNEXOS_BENCH into nexos-bench, whose main
+// runs this suite instead of the OS. Each case takes a warm-up sample and
+// then --samples timed samples of the kernel's own hot paths; the results
+// go to stdout as a table and optionally to --json/--csv files with
+// percentiles, so runs of two releases can be compared mechanically.
+
+#define BENCH_DEFAULT_SAMPLES 200
+#define BENCH_MAX_RESULTS 32
+#define BENCH_MAX_THREADS 8
+#define BENCH_QUEUE_BATCH 1024      // Processes enqueued and drained per sample
+#define BENCH_RESERVE_BATCH 1024    // reserve/release pairs per thread and sample
+#define BENCH_LOOKUP_BATCH 1000     // Lookups per sample
+#define BENCH_TABLE_ENTRIES 10000
+
+typedef struct {
+    char name[48];
+    const char* unit;
+    int samples;
+    double min, p50, p90, p99, max, mean;
+} BenchResult;
+
+static BenchResult bench_results[BENCH_MAX_RESULTS];
+static int bench_result_count = 0;
+static const char* bench_filter = NULL;
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int bench_selected(const char* name) {
+    return bench_filter == NULL || strstr(name, bench_filter) != NULL;
+}
+
+// Sort the samples and keep their distribution under name
+static void bench_record(const char* name, const char* unit, double* samples, int count) {
+    if (count == 0 || bench_result_count >= BENCH_MAX_RESULTS) {
+        return;
+    }
+    qsort(samples, count, sizeof(double), compare_double);
+    
+    BenchResult* result = &bench_results[bench_result_count++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->unit = unit;
+    result->samples = count;
+    result->min = samples[0];
+    result->p50 = samples[(count - 1) / 2];
+    result->p90 = samples[(int)((count - 1) * 0.90)];
+    result->p99 = samples[(int)((count - 1) * 0.99)];
+    result->max = samples[count - 1];
+    result->mean = 0;
+    for (int i = 0; i < count; i++) {
+        result->mean += samples[i] / count;
+    }
+    
+    printf("%-28s %-7s %10.1f %10.1f %10.1f %10.1f %10.1f\n", result->name, unit,
+           result->min, result->p50, result->p90, result->p99, result->max);
+    fflush(stdout);
+}
+
+// enqueue_process + dequeue_process of a batch of PCBs on one core
+static void bench_queue(int samples) {
+    SchedulerType policies[] = { SCHEDULER_FCFS, SCHEDULER_SJF, SCHEDULER_PRIORITY,
+                                 SCHEDULER_RR, SCHEDULER_MLFQ };
+    const char* names[] = { "fcfs", "sjf", "priority", "rr", "mlfq" };
+    double* values = malloc(samples * sizeof(double));
+    PCB* pcbs = calloc(BENCH_QUEUE_BATCH, sizeof(PCB));
+    if (values == NULL || pcbs == NULL) {
+        perror("Failed to allocate benchmark state");
+        free(values);
+        free(pcbs);
+        return;
+    }
+    
+    unsigned long state = 42;
+    for (int i = 0; i < BENCH_QUEUE_BATCH; i++) {
+        pcbs[i].pid = 100000 + i;
+        pcbs[i].priority = (int)(next_random(&state) % 4);
+        pcbs[i].burst_estimate_ms = 1 + (long)(next_random(&state) % 1000);
+    }
+    
+    int saved_queues = num_worker_queues;
+    SchedulerType saved_scheduler = current_scheduler;
+    num_worker_queues = 1;
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        char name[48];
+        snprintf(name, sizeof(name), "queue/%s", names[p]);
+        if (!bench_selected(name)) {
+            continue;
+        }
+        
+        current_scheduler = policies[p];
+        init_multilevel_queue();
+        for (int s = -1; s < samples; s++) {
+            long long start = monotonic_ns();
+            for (int i = 0; i < BENCH_QUEUE_BATCH; i++) {
+                enqueue_process(&pcbs[i]);
+            }
+            int drained = 0;
+            while (dequeue_process(0) != NULL) {
+                drained++;
+            }
+            long long elapsed = monotonic_ns() - start;
+            
+            if (drained != BENCH_QUEUE_BATCH) {
+                printf("ERROR: %s drained %d of %d processes\n", name, drained, BENCH_QUEUE_BATCH);
+            }
+            if (s >= 0) {
+                values[s] = (double)elapsed / BENCH_QUEUE_BATCH;
+            }
+        }
+        destroy_multilevel_queue();
+        bench_record(name, "ns/op", values, samples);
+    }
+    
+    num_worker_queues = saved_queues;
+    current_scheduler = saved_scheduler;
+    free(pcbs);
+    free(values);
+}
+
+typedef struct {
+    int samples;
+    double* values;
+    pthread_barrier_t* start;
+} ReserveBenchArgs;
+
+static void* reserve_bench_thread(void* arg) {
+    ReserveBenchArgs* args = (ReserveBenchArgs*)arg;
+    pthread_barrier_wait(args->start);
+    
+    for (int s = -1; s < args->samples; s++) {
+        long long start = monotonic_ns();
+        for (int i = 0; i < BENCH_RESERVE_BATCH; i++) {
+            ResourceReservation reservation;
+            if (reserve_resources(&reservation, 64, 1)) {
+                release_reservation(&reservation);
+            }
+        }
+        if (s >= 0) {
+            args->values[s] = (double)(monotonic_ns() - start) / BENCH_RESERVE_BATCH;
+        }
+    }
+    return NULL;
+}
+
+// reserve_resources + release_reservation from 1 up to 8 threads at once
+static void bench_resources(int samples) {
+    double* values = malloc((size_t)samples * BENCH_MAX_THREADS * sizeof(double));
+    if (values == NULL) {
+        perror("Failed to allocate benchmark state");
+        return;
+    }
+    
+    for (int threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+        char name[48];
+        snprintf(name, sizeof(name), "resources/threads-%d", threads);
+        if (!bench_selected(name)) {
+            continue;
+        }
+        
+        init_resource_pool(64 * 1024, 64 * 1024, POOL_CORES_MAX);
+        ram_allocator_init(&ram_allocator, RAM_FIRST_FIT, 64 * 1024);
+        
+        pthread_t ids[BENCH_MAX_THREADS];
+        ReserveBenchArgs args[BENCH_MAX_THREADS];
+        pthread_barrier_t start;
+        pthread_barrier_init(&start, NULL, threads);
+        for (int t = 0; t < threads; t++) {
+            args[t].samples = samples;
+            args[t].values = values + (size_t)t * samples;
+            args[t].start = &start;
+            pthread_create(&ids[t], NULL, reserve_bench_thread, &args[t]);
+        }
+        for (int t = 0; t < threads; t++) {
+            pthread_join(ids[t], NULL);
+        }
+        pthread_barrier_destroy(&start);
+        ram_allocator_destroy(&ram_allocator);
+        
+        // Every thread's samples are samples of the same operation
+        bench_record(name, "ns/op", values, samples * threads);
+    }
+    free(values);
+}
+
+// Insert, PID and name lookups in a table of BENCH_TABLE_ENTRIES processes
+static void bench_table(int samples) {
+    int run_insert = bench_selected("table/insert");
+    int run_pid = bench_selected("table/pid-lookup");
+    int run_name = bench_selected("table/name-lookup");
+    if (!run_insert && !run_pid && !run_name) {
+        return;
     }
     
-    if (index == -1) {
-        // No empty slot found
-        printf("ERROR: No empty slot in process table!\n");
-        // Return the resources
-        pthread_mutex_lock(&resource_mutex);
-        hardware.available_ram += ram_required;
-        hardware.available_hdd += hdd_required;
-        hardware.available_cores++;
-        pthread_mutex_unlock(&resource_mutex);
-        sem_post(process_semaphore);
-        sleep(2);
+    double* values = malloc(samples * sizeof(double));
+    if (values == NULL) {
+        perror("Failed to allocate benchmark state");
         return;
     }
     
-    // Set up information in the process table
-    process_table[index].is_active = 1;
-    process_table[index].is_minimized = 0;
-    process_table[index].ram_required = ram_required;
-    process_table[index].hdd_required = hdd_required;
-    process_table[index].priority = available_tasks[task_id].priority;
-    process_table[index].start_time = time(NULL);
-    strcpy(process_table[index].name, available_tasks[task_id].name);
-    strcpy(process_table[index].task_path, available_tasks[task_id].path);
+    int saved_max_tasks = max_tasks;
+    char name[TASK_NAME_LENGTH];
+    max_tasks = BENCH_TABLE_ENTRIES;
+    initialize_process_table();
+    for (int i = 0; i < BENCH_TABLE_ENTRIES - BENCH_LOOKUP_BATCH; i++) {
+        snprintf(name, sizeof(name), "Task %d", i);
+        process_table_set_pid(process_table_insert(name), 100000 + i * 7);
+    }
     
-    process_count++;
-    sem_post(process_semaphore);
+    // Fill the last slots and empty them again
+    if (run_insert) {
+        int indexes[BENCH_LOOKUP_BATCH];
+        for (int s = -1; s < samples; s++) {
+            long long start = monotonic_ns();
+            for (int i = 0; i < BENCH_LOOKUP_BATCH; i++) {
+                snprintf(name, sizeof(name), "Extra %d", i);
+                indexes[i] = process_table_insert(name);
+                process_table_set_pid(indexes[i], 10 + i);
+            }
+            long long elapsed = monotonic_ns() - start;
+            for (int i = 0; i < BENCH_LOOKUP_BATCH; i++) {
+                process_table_remove(indexes[i]);
+            }
+            if (s >= 0) {
+                values[s] = (double)elapsed / BENCH_LOOKUP_BATCH;
+            }
+        }
+        bench_record("table/insert", "ns/op", values, samples);
+    }
+    
+    unsigned long state = 12345;
+    long entries = BENCH_TABLE_ENTRIES - BENCH_LOOKUP_BATCH;
+    long found = 0, lookups = 0;
+    if (run_pid) {
+        for (int s = -1; s < samples; s++) {
+            long long start = monotonic_ns();
+            for (int i = 0; i < BENCH_LOOKUP_BATCH; i++) {
+                found += find_process_by_pid((int)(100000 + (next_random(&state) % entries) * 7)) >= 0;
+            }
+            long long elapsed = monotonic_ns() - start;
+            lookups += BENCH_LOOKUP_BATCH;
+            if (s >= 0) {
+                values[s] = (double)elapsed / BENCH_LOOKUP_BATCH;
+            }
+        }
+        bench_record("table/pid-lookup", "ns/op", values, samples);
+    }
+    if (run_name) {
+        for (int s = -1; s < samples; s++) {
+            long long start = monotonic_ns();
+            for (int i = 0; i < BENCH_LOOKUP_BATCH; i++) {
+                snprintf(name, sizeof(name), "Task %lu", next_random(&state) % entries);
+                found += find_process_by_name(name, 0) >= 0;
+            }
+            long long elapsed = monotonic_ns() - start;
+            lookups += BENCH_LOOKUP_BATCH;
+            if (s >= 0) {
+                values[s] = (double)elapsed / BENCH_LOOKUP_BATCH;
+            }
+        }
+        bench_record("table/name-lookup", "ns/op", values, samples);
+    }
+    if (found != lookups) {
+        printf("ERROR: %ld of %ld lookups found their process\n", found, lookups);
+    }
     
-    // Use fork and exec to launch the task
-    pid_t pid = fork();
+    destroy_process_table();
+    max_tasks = saved_max_tasks;
+    free(values);
+}
+
+// Launch-to-exit round trip of /bin/true through each launch path
+static void bench_launch(int samples) {
+    const LaunchMethod methods[] = { LAUNCH_SYSTEM, LAUNCH_FORK_EXEC, LAUNCH_SPAWN, LAUNCH_CGROUP };
+    const char* names[] = { "launch/system", "launch/fork-execl", "launch/posix_spawn",
+                            "launch/clone3-cgroup" };
+    double* values = malloc(samples * sizeof(double));
+    if (values == NULL) {
+        perror("Failed to allocate benchmark state");
+        return;
+    }
     
-    if (pid == -1) {
-        // Fork failed
-        perror("fork failed");
-        
-        // Free resources and update process table
-        if (sem_wait(process_semaphore) < 0) {
-            perror("sem_wait failed");
+    open_launch_cgroup();
+    for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+        if (!bench_selected(names[m]) || !launch_available(methods[m])) {
+            continue;
+        }
+        for (int s = -1; s < samples; s++) {
+            long long call_ns;
+            long long round_trip = time_launch(methods[m], "/bin/true", &call_ns);
+            if (s >= 0) {
+                values[s] = round_trip / 1000.0;
+            }
+        }
+        bench_record(names[m], "us", values, samples);
+    }
+    free(values);
+}
+
+static int write_bench_json(const char* path, int samples) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        return -1;
+    }
+    
+    fprintf(out, "{\n  \"suite\": \"%s\",\n  \"cpus\": %ld,\n  \"samples\": %d,\n  \"results\": [",
+            OS_NAME, sysconf(_SC_NPROCESSORS_ONLN), samples);
+    for (int i = 0; i < bench_result_count; i++) {
+        const BenchResult* r = &bench_results[i];
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"samples\": %d, "
+                "\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"mean\": %.3f}",
+                i == 0 ? "" : ",", r->name, r->unit, r->samples,
+                r->min, r->p50, r->p90, r->p99, r->max, r->mean);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    return fclose(out);
+}
+
+static int write_bench_csv(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        return -1;
+    }
+    
+    fprintf(out, "name,unit,samples,min,p50,p90,p99,max,mean\n");
+    for (int i = 0; i < bench_result_count; i++) {
+        const BenchResult* r = &bench_results[i];
+        fprintf(out, "%s,%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", r->name, r->unit, r->samples,
+                r->min, r->p50, r->p90, r->p99, r->max, r->mean);
+    }
+    return fclose(out);
+}
+
+int run_bench_suite(int argc, char* argv[]) {
+    const char* json_path = NULL;
+    const char* csv_path = NULL;
+    int samples = BENCH_DEFAULT_SAMPLES;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [--samples <n>] [--filter <text>] [--json <file>] [--csv <file>]\n", argv[0]);
+            return EXIT_SUCCESS;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--samples") == 0) {
+            samples = atoi(argv[++i]);
+            if (samples < 1) {
+                fprintf(stderr, "--samples must be at least 1\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--filter") == 0) {
+            bench_filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv_path = argv[++i];
         } else {
-            process_table[index].is_active = 0;
-            process_table[index].is_minimized = 0;
-            process_count--;
-            sem_post(process_semaphore);
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return EXIT_FAILURE;
         }
+    }
+    
+    printf("%s Benchmark Suite (%d samples per case, after one warm-up)\n\n", OS_NAME, samples);
+    printf("%-28s %-7s %10s %10s %10s %10s %10s\n", "Case", "Unit", "Min", "p50", "p90", "p99", "Max");
+    printf("------------------------------------------------------------------------------------------\n");
+    
+    bench_queue(samples);
+    bench_resources(samples);
+    bench_table(samples);
+    bench_launch(samples);
+    
+    if (json_path != NULL && write_bench_json(json_path, samples) != 0) {
+        perror(json_path);
+        return EXIT_FAILURE;
+    }
+    if (csv_path != NULL && write_bench_csv(csv_path) != 0) {
+        perror(csv_path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+#endif
+
+// ##########################################
+// BATCH CONTROL MODE
+// ##########################################
+// --batch replays OS commands from a file or stdin instead of the menus.
+// Launched applications are registered minimized, like the boot-time Clock,
+// since a batch run has no terminal to hand to a task.
+
+// Application by 1-based menu number or case-insensitive name; -1 if unknown
+static int find_task_id(const char* name) {
+    char* end;
+    long number = strtol(name, &end, 10);
+    if (*end == '\0' && number >= 1 && number <= num_available_tasks) {
+        return (int)number - 1;
+    }
+    return find_registered_task(name);
+}
+
+// Running process by PID or application name, -1 if there is none
+static int find_batch_process(const char* target) {
+    char* end;
+    long pid = strtol(target, &end, 10);
+    int index = *end == '\0' ? lookup_process_by_pid((int)pid) : -1;
+    if (index < 0 && find_task_id(target) >= 0) {
+        index = find_process_by_name(available_tasks[find_task_id(target)].name, 0);
+    }
+    return index;
+}
+
+// Split "<pid|app> <ram_mb> <hdd_gb> <cores>"; the name may contain spaces
+static int parse_claim_arguments(char* argument, int* index, ResourceCounts* amount) {
+    int values[NUM_RESOURCE_TYPES];
+    for (int r = NUM_RESOURCE_TYPES - 1; r >= 0; r--) {
+        char* space = strrchr(argument, ' ');
+        char* end;
+        if (space == NULL) {
+            printf("ERROR: Expected <pid|app> <ram_mb> <hdd_gb> <cores>\n");
+            return 0;
+        }
+        long value = strtol(space + 1, &end, 10);
+        if (*end != '\0' || value < 0) {
+            printf("ERROR: Invalid amount '%s'\n", space + 1);
+            return 0;
+        }
+        values[r] = (int)value;
+        while (space > argument && space[-1] == ' ') {
+            space--;
+        }
+        *space = '\0';
+    }
+    
+    *index = find_batch_process(argument);
+    if (*index < 0) {
+        printf("ERROR: No running process '%s'\n", argument);
+        return 0;
+    }
+    amount->ram_mb = values[RESOURCE_RAM];
+    amount->hdd_gb = values[RESOURCE_HDD];
+    amount->cores = values[RESOURCE_CORES];
+    return 1;
+}
+
+static void print_batch_claims() {
+    int count = 0;
+    ProcessRow* rows = snapshot_processes(&count);
+    pthread_mutex_lock(&claim_mutex);
+    unsigned char* deadlocked = calloc(claim_table.capacity, 1);
+    int stuck = deadlocked != NULL ? detect_deadlock(&claim_table, deadlocked) : 0;
+    
+    printf("%-7s %-22s %15s %15s %15s %s\n", "PID", "NAME", "HELD", "MAX", "PENDING", "STATUS");
+    for (int r = 0; r < count; r++) {
+        int i = rows[r].index;
+        if (claim_table.status[i] == CLAIM_UNUSED) {
+            continue;
+        }
+        char held[32], max[32], pending[32];
+        snprintf(held, sizeof(held), "%d/%d/%d", CLAIM_AT(&claim_table, alloc, i, 0),
+                 CLAIM_AT(&claim_table, alloc, i, 1), CLAIM_AT(&claim_table, alloc, i, 2));
+        snprintf(max, sizeof(max), "%d/%d/%d", CLAIM_AT(&claim_table, max, i, 0),
+                 CLAIM_AT(&claim_table, max, i, 1), CLAIM_AT(&claim_table, max, i, 2));
+        snprintf(pending, sizeof(pending), "%d/%d/%d", CLAIM_AT(&claim_table, pending, i, 0),
+                 CLAIM_AT(&claim_table, pending, i, 1), CLAIM_AT(&claim_table, pending, i, 2));
+        printf("%-7d %-22s %15s %15s %15s %s\n", rows[r].pid, rows[r].name,
+               held, max, claim_table.status[i] == CLAIM_WAITING ? pending : "-",
+               deadlocked != NULL && deadlocked[i] ? "deadlocked"
+               : claim_table.status[i] == CLAIM_WAITING ? "waiting" : "running");
+    }
+    printf("%s: free %d MB/%d GB/%d cores, %lld requests, %lld granted, %lld waited, "
+           "%lld fast path, %lld safety checks, %d deadlocked\n",
+           deadlock_mode_name(claim_table.mode), claim_table.available[RESOURCE_RAM],
+           claim_table.available[RESOURCE_HDD], claim_table.available[RESOURCE_CORES],
+           claim_table.requests, claim_table.grants, claim_table.waits,
+           claim_table.fast_paths, claim_table.prefix_checks + claim_table.full_checks, stuck);
+    free(deadlocked);
+    pthread_mutex_unlock(&claim_mutex);
+    free(rows);
+}
+
+static void print_batch_processes() {
+    printf("%-7s %-22s %8s %8s %8s %8s %8s %s\n", "PID", "NAME", "RAM", "RSS", "CPU ms",
+           "HDD", "PRIO", "STATUS");
+    int count = 0;
+    ProcessRow* rows = snapshot_processes(&count);
+    for (int i = 0; i < count; i++) {
+        printf("%-7d %-22s %8d %8ld %8ld %8d %8d %s\n", rows[i].pid,
+               rows[i].name, rows[i].ram_required,
+               rows[i].rss_kb / 1024, rows[i].cpu_ms,
+               rows[i].hdd_required, rows[i].priority,
+               rows[i].is_minimized ? "minimized" : "active");
+    }
+    free(rows);
+    printf("%d process(es)\n", count);
+}
+
+// Run one batch command; returns 0 on success, -1 on error, 1 to stop
+static int run_batch_command(char* line) {
+    char* command = strtok(line, " \t");
+    char* argument = strtok(NULL, "");
+    if (argument != NULL) {
+        while (*argument == ' ' || *argument == '\t') {
+            argument++;
+        }
+    }
+    
+    if (strcmp(command, "quit") == 0 || strcmp(command, "shutdown") == 0) {
+        return 1;
+    } else if (strcmp(command, "list") == 0) {
+        print_batch_processes();
+    } else if (strcmp(command, "status") == 0) {
+        ResourceCounts available = available_resources();
+        int free_slots = hardware.cpu_cores - __atomic_load_n(&dispatched_count, __ATOMIC_RELAXED);
+        printf("mode %s, scheduler %s, RAM %d/%d MB, HDD %d/%d GB, cores %d/%d, processes %d\n",
+               is_kernel_mode ? "kernel" : "user", get_scheduler_name(current_scheduler),
+               available.ram_mb, hardware.ram_gb * 1024,
+               available.hdd_gb, hardware.hdd_gb,
+               free_slots, hardware.cpu_cores, process_count);
+    } else if (strcmp(command, "memory") == 0) {
+        RamStats stats;
+        pthread_mutex_lock(&ram_allocator_mutex);
+        ram_allocator_stats(&ram_allocator, &stats);
+        long long allocations = ram_allocator.allocations + ram_allocator.failures;
+        double alloc_ns = allocations > 0 ? (double)ram_allocator.alloc_ns / allocations : 0.0;
+        pthread_mutex_unlock(&ram_allocator_mutex);
+        printf("allocator %s, free %d MB in %d holes, largest %d MB, external %.1f%%, internal %.1f%%, "
+               "%.0f ns/alloc, %lld failed\n",
+               ram_allocator_name(ram_allocator_type), stats.free_mb, stats.holes, stats.largest_free_mb,
+               stats.external * 100, stats.internal * 100, alloc_ns, ram_allocator.failures);
+    } else if (strcmp(command, "launch") == 0 && argument != NULL) {
+        int task_id = find_task_id(argument);
+        if (task_id < 0) {
+            printf("ERROR: Unknown application '%s'\n", argument);
+            return -1;
+        }
+        if (is_application_running(available_tasks[task_id].name)) {
+            printf("ERROR: %s is already running!\n", available_tasks[task_id].name);
+            return -1;
+        }
+        int index = launch_task_background(task_id);
+        if (index < 0) {
+            return -1;
+        }
+        printf("Launched %s in slot %d\n", available_tasks[task_id].name, index);
+    } else if (strcmp(command, "terminate") == 0 && argument != NULL) {
+        if (!is_kernel_mode) {
+            printf("ERROR: Cannot terminate processes in User Mode!\n");
+            return -1;
+        }
+        int index = find_batch_process(argument);
+        if (index < 0) {
+            printf("ERROR: No running process '%s'\n", argument);
+            return -1;
+        }
+        terminate_process(index);
+    } else if (strcmp(command, "request") == 0 && argument != NULL) {
+        int index;
+        ResourceCounts amount;
+        if (!parse_claim_arguments(argument, &index, &amount)) {
+            return -1;
+        }
+        ClaimResult result = request_task_resources(index, amount);
+        if (result == CLAIM_INVALID) {
+            printf("ERROR: %s asked for more than its maximum claim\n", process_table[index].name);
+            return -1;
+        }
+        printf("%s %s %d MB, %d GB, %d core(s)\n", process_table[index].name,
+               result == CLAIM_GRANTED ? "was granted" : "is waiting for",
+               amount.ram_mb, amount.hdd_gb, amount.cores);
+    } else if (strcmp(command, "release") == 0 && argument != NULL) {
+        int index;
+        ResourceCounts amount;
+        if (!parse_claim_arguments(argument, &index, &amount)) {
+            return -1;
+        }
+        release_task_resources(index, amount);
+        printf("%s released resources\n", process_table[index].name);
+    } else if (strcmp(command, "usage") == 0) {
+        print_usage_table();
+    } else if (strcmp(command, "cores") == 0) {
+        print_core_stats();
+    } else if (strcmp(command, "metrics") == 0) {
+        write_metrics(stdout);
+    } else if (strcmp(command, "trace") == 0) {
+        const char* path = argument != NULL ? argument : trace_file_path;
+        if (!tracing_enabled || path == NULL) {
+            printf("ERROR: Tracing is off, start with --trace-file <path>\n");
+            return -1;
+        }
+        if (export_trace_file(path) != 0) {
+            perror(path);
+            return -1;
+        }
+        printf("Trace written to %s\n", path);
+    } else if (strcmp(command, "claims") == 0) {
+        print_batch_claims();
+    } else if (strcmp(command, "mode") == 0 && argument != NULL) {
+        if (strcmp(argument, "kernel") == 0) {
+            is_kernel_mode = 1;
+        } else if (strcmp(argument, "user") == 0) {
+            is_kernel_mode = 0;
+        } else {
+            printf("ERROR: Unknown mode '%s'\n", argument);
+            return -1;
+        }
+        printf("Switched to %s mode.\n", is_kernel_mode ? "Kernel" : "User");
+    } else if (strcmp(command, "scheduler") == 0 && argument != NULL) {
+        SchedulerType scheduler;
+        if (!is_kernel_mode) {
+            printf("ERROR: Cannot change scheduler in User Mode!\n");
+            return -1;
+        }
+        if (!parse_policy_name(argument, &scheduler)) {
+            printf("ERROR: Unknown scheduler '%s'\n", argument);
+            return -1;
+        }
+        if (scheduler != current_scheduler) {
+            current_scheduler = scheduler;
+            __atomic_add_fetch(&scheduler_epoch, 1, __ATOMIC_RELEASE);
+        }
+        printf("CPU Scheduler changed to %s.\n", get_scheduler_name(current_scheduler));
+    } else if (strcmp(command, "sleep") == 0 && argument != NULL) {
+        sleep_ms(atoi(argument));
+    } else {
+        printf("ERROR: Invalid command '%s'\n", command);
+        return -1;
+    }
+    return 0;
+}
+
+// Returns the exit status of the batch run: failure if any command failed
+int run_batch_commands(const char* path) {
+    FILE* input = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (input == NULL) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    
+    char line[256];
+    long commands = 0, failures = 0, line_number = 0;
+    long long start = monotonic_ns();
+    
+    while (fgets(line, sizeof(line), input) != NULL) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        line[strcspn(line, "\r\n")] = '\0';
         
-        // Free resources allocated to this process
-        free_resources(index);
-        
-        sleep(2);
-        return;
-    } else if (pid == 0) {
-        // Child process
-        // Clear the screen before launching the task
-        system("clear");
-        
-        // Execute the task
-        execl(available_tasks[task_id].path, available_tasks[task_id].path, NULL);
+        char* text = line;
+        while (*text == ' ' || *text == '\t') {
+            text++;
+        }
+        size_t length = strlen(text);
+        while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t')) {
+            text[--length] = '\0';
+        }
+        if (length == 0) {
+            continue;
+        }
         
-        // If execl fails
-        perror("execl failed");
-        exit(EXIT_FAILURE);
+        commands++;
+        reload_task_registry_if_changed();
+        int result = run_batch_command(text);
+        if (result == 1) {
+            break;
+        }
+        if (result < 0) {
+            failures++;
+            fprintf(stderr, "%s:%ld: command failed\n", path, line_number);
+        }
+    }
+    
+    double seconds = (monotonic_ns() - start) / 1e9;
+    printf("Batch finished: %ld commands, %ld failed, %.3f s (%.0f commands/s)\n",
+           commands, failures, seconds, seconds > 0 ? commands / seconds : 0.0);
+    
+    if (input != stdin) {
+        fclose(input);
+    }
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// ##########################################
+// VIRTUAL MEMORY MANAGER
+// ##########################################
+// Replays a reference string through per-process page tables, a TLB and a
+// frame pool sized from the simulated RAM. A reference is packed into 64
+// bits as (process << 48) | virtual page number.
+
+#define PT_LEAF_BITS 10
+#define PT_LEAF_ENTRIES (1 << PT_LEAF_BITS)
+#define TLB_WAYS 4
+#define VM_PROC_SHIFT 48
+#define VM_VPN_MASK ((1ULL << VM_PROC_SHIFT) - 1)
+
+static const char* replacement_policy_name(ReplacementPolicy policy) {
+    switch (policy) {
+        case REPLACE_FIFO: return "FIFO";
+        case REPLACE_LRU: return "LRU";
+        case REPLACE_CLOCK: return "Clock";
+        case REPLACE_SECOND_CHANCE: return "Second chance";
+    }
+    return "Unknown";
+}
+
+static int parse_replacement_policy(const char* name, ReplacementPolicy* policy) {
+    if (strcmp(name, "fifo") == 0) {
+        *policy = REPLACE_FIFO;
+    } else if (strcmp(name, "lru") == 0) {
+        *policy = REPLACE_LRU;
+    } else if (strcmp(name, "clock") == 0) {
+        *policy = REPLACE_CLOCK;
+    } else if (strcmp(name, "second-chance") == 0) {
+        *policy = REPLACE_SECOND_CHANCE;
     } else {
-        // Parent process
-        // Update the PID in the process table
-        if (sem_wait(process_semaphore) < 0) {
-            perror("sem_wait failed");
+        fprintf(stderr, "Unknown replacement policy: %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+static void page_table_init(PageTable* table, unsigned long long pages) {
+    table->leaf_count = (uint32_t)((pages + PT_LEAF_ENTRIES - 1) >> PT_LEAF_BITS);
+    table->leaves = calloc(table->leaf_count, sizeof(uint32_t*));
+    if (table->leaves == NULL) {
+        perror("Failed to allocate page table");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void page_table_free(PageTable* table) {
+    for (uint32_t i = 0; i < table->leaf_count; i++) {
+        free(table->leaves[i]);
+    }
+    free(table->leaves);
+    table->leaves = NULL;
+    table->leaf_count = 0;
+}
+
+// Entry of a virtual page, allocating its leaf on first touch
+static inline uint32_t* page_table_entry(PageTable* table, uint64_t vpn) {
+    uint32_t** leaf = &table->leaves[vpn >> PT_LEAF_BITS];
+    if (*leaf == NULL) {
+        *leaf = calloc(PT_LEAF_ENTRIES, sizeof(uint32_t));
+        if (*leaf == NULL) {
+            perror("Failed to allocate page table leaf");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return &(*leaf)[vpn & (PT_LEAF_ENTRIES - 1)];
+}
+
+// Synthetic reference string with the usual locality: most references stay
+// in the page just used, many fall in a hot working set that drifts slowly,
+// and a few hit anywhere in the address space. Processes take turns in
+// slices of a few thousand references, like a time-shared CPU.
+static uint64_t* generate_vm_references(long count, const VmConfig* config, unsigned long seed) {
+    uint64_t* refs = malloc(count * sizeof(uint64_t));
+    if (refs == NULL) {
+        perror("Failed to allocate reference string");
+        return NULL;
+    }
+    
+    unsigned long long pages = (unsigned long long)config->space_mb * 1024 / config->page_kb;
+    unsigned long long hot_pages = pages / 64 > 0 ? pages / 64 : 1;
+    unsigned long long* hot_base = calloc(config->procs, sizeof(unsigned long long));
+    unsigned long long* last_page = calloc(config->procs, sizeof(unsigned long long));
+    if (hot_base == NULL || last_page == NULL) {
+        perror("Failed to allocate reference string");
+        exit(EXIT_FAILURE);
+    }
+    
+    unsigned long state = seed * 2654435761UL + 1;
+    int proc = 0;
+    for (long i = 0; i < count; i++) {
+        if (i % 4096 == 0) {
+            proc = (int)(next_random(&state) % config->procs);
+        }
+        
+        unsigned long roll = next_random(&state) % 100;
+        unsigned long long page;
+        if (roll < 75) {
+            page = last_page[proc];
+        } else if (roll < 97) {
+            page = hot_base[proc] + next_random(&state) % hot_pages;
         } else {
-            process_table[index].pid = pid;
-            sem_post(process_semaphore);
+            page = next_random(&state) % pages;
+            if (next_random(&state) % 30000 == 0) {
+                // Now and then the working set moves on
+                hot_base[proc] = next_random(&state) % (pages - hot_pages + 1);
+            }
         }
         
-        printf("Started %s with PID %d\n", available_tasks[task_id].name, pid);
+        page %= pages;
+        last_page[proc] = page;
+        refs[i] = ((uint64_t)proc << VM_PROC_SHIFT) | page;
+    }
+    
+    free(hot_base);
+    free(last_page);
+    return refs;
+}
+
+// Recorded reference string: "<process> <address>" or "<address>" per line,
+// addresses in decimal or 0x-hex. Process numbers are returned in procs_out.
+static uint64_t* load_vm_references(const char* path, const VmConfig* config,
+                                    long* count_out, int* procs_out) {
+    size_t length;
+    char* text = read_whole_file(path, &length);
+    if (text == NULL) {
+        return NULL;
+    }
+    
+    long capacity = 1 << 20, count = 0;
+    uint64_t* refs = malloc(capacity * sizeof(uint64_t));
+    unsigned long long page_bytes = (unsigned long long)config->page_kb * 1024;
+    int procs = 1;
+    
+    for (char* line = text; refs != NULL && line < text + length; ) {
+        char* end = strchr(line, '\n');
+        if (end == NULL) {
+            end = text + length;
+        }
+        *end = '\0';
         
-        // Wait for the child process to finish
-        int status;
-        waitpid(pid, &status, 0);
+        char* cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') {
+            cursor++;
+        }
+        if (*cursor != '\0' && *cursor != '#') {
+            unsigned long long first = strtoull(cursor, &cursor, 0);
+            unsigned long long second;
+            char* rest = cursor;
+            second = strtoull(cursor, &rest, 0);
+            
+            unsigned long long proc = 0, address = first;
+            if (rest != cursor) {
+                proc = first;
+                address = second;
+            }
+            if (proc >= 65535) {
+                fprintf(stderr, "%s: process number %llu too large\n", path, proc);
+                free(refs);
+                free(text);
+                return NULL;
+            }
+            if ((int)proc + 1 > procs) {
+                procs = (int)proc + 1;
+            }
+            
+            if (count == capacity) {
+                capacity *= 2;
+                uint64_t* grown = realloc(refs, capacity * sizeof(uint64_t));
+                if (grown == NULL) {
+                    free(refs);
+                    refs = NULL;
+                    break;
+                }
+                refs = grown;
+            }
+            refs[count++] = (proc << VM_PROC_SHIFT) | ((address / page_bytes) & VM_VPN_MASK);
+        }
+        line = end + 1;
+    }
+    
+    free(text);
+    if (refs == NULL) {
+        perror("Failed to allocate reference string");
+        return NULL;
+    }
+    *count_out = count;
+    *procs_out = procs;
+    return refs;
+}
+
+// Replay a reference string with one replacement policy
+void simulate_paging(const uint64_t* refs, long count, int procs, ReplacementPolicy policy,
+                     const VmConfig* config, VmResult* result) {
+    uint32_t frames = (uint32_t)(config->ram_mb * 1024 / config->page_kb);
+    unsigned long long pages = (unsigned long long)config->space_mb * 1024 / config->page_kb;
+    
+    // Every process has its own page table, hung off a PCB like the OS does
+    PCB* pcbs = calloc(procs, sizeof(PCB));
+    PageTable* tables = calloc(procs, sizeof(PageTable));
+    uint64_t* frame_page = malloc(frames * sizeof(uint64_t));   // Packed reference held by a frame
+    uint8_t* referenced = calloc(frames, sizeof(uint8_t));
+    uint32_t* lru_prev = policy == REPLACE_LRU ? malloc(frames * sizeof(uint32_t)) : NULL;
+    uint32_t* lru_next = policy == REPLACE_LRU ? malloc(frames * sizeof(uint32_t)) : NULL;
+    uint32_t* ring = policy == REPLACE_SECOND_CHANCE ? malloc(frames * sizeof(uint32_t)) : NULL;
+    
+    int tlb_sets = config->tlb_entries / TLB_WAYS > 0 ? config->tlb_entries / TLB_WAYS : 1;
+    uint64_t* tlb_tag = calloc(tlb_sets * TLB_WAYS, sizeof(uint64_t));  // Reference + 1, 0 is empty
+    uint32_t* tlb_frame = calloc(tlb_sets * TLB_WAYS, sizeof(uint32_t));
+    uint8_t* tlb_victim = calloc(tlb_sets, sizeof(uint8_t));
+    
+    if (pcbs == NULL || tables == NULL || frame_page == NULL || referenced == NULL ||
+        (policy == REPLACE_LRU && (lru_prev == NULL || lru_next == NULL)) ||
+        (policy == REPLACE_SECOND_CHANCE && ring == NULL) ||
+        tlb_tag == NULL || tlb_frame == NULL || tlb_victim == NULL) {
+        perror("Failed to allocate memory manager");
+        exit(EXIT_FAILURE);
+    }
+    
+    for (int p = 0; p < procs; p++) {
+        page_table_init(&tables[p], pages);
+        pcbs[p].page_table = &tables[p];
+        pcbs[p].pid = p;
+        snprintf(pcbs[p].name, TASK_NAME_LENGTH, "%s", available_tasks[p % num_available_tasks].name);
+    }
+    
+    memset(result, 0, sizeof(*result));
+    uint32_t used_frames = 0;
+    uint32_t hand = 0;                       // FIFO and Clock hand
+    uint32_t lru_head = UINT32_MAX, lru_tail = UINT32_MAX;
+    uint32_t ring_head = 0, ring_count = 0;  // Second-chance queue
+    unsigned int set_mask = (unsigned int)tlb_sets - 1;
+    int sets_are_pow2 = (tlb_sets & (tlb_sets - 1)) == 0;
+    
+    long long start = monotonic_ns();
+    
+    for (long i = 0; i < count; i++) {
+        uint64_t ref = refs[i];
+        int proc = (int)(ref >> VM_PROC_SHIFT);
+        uint64_t vpn = ref & VM_VPN_MASK;
+        if (vpn >= pages) {
+            // Recorded addresses beyond the address space wrap around
+            vpn %= pages;
+            ref = ((uint64_t)proc << VM_PROC_SHIFT) | vpn;
+        }
         
-        // Check the exit status to see if we need to minimize instead of close
-        if (WIFEXITED(status) && WEXITSTATUS(status) == 10) {
-            // Application requested to be minimized
-            if (sem_wait(process_semaphore) < 0) {
-                perror("sem_wait failed");
-            } else {
-                process_table[index].is_minimized = 1;
-                sem_post(process_semaphore);
-                printf("%s was minimized. You can resume it later.\n", available_tasks[task_id].name);
-                sleep(2);
+        // TLB lookup
+        unsigned int set = (unsigned int)(vpn ^ ((uint64_t)proc * 0x9E3779B1u));
+        set = sets_are_pow2 ? (set & set_mask) : (set % (unsigned int)tlb_sets);
+        uint64_t* tags = &tlb_tag[set * TLB_WAYS];
+        uint32_t frame = UINT32_MAX;
+        for (int w = 0; w < TLB_WAYS; w++) {
+            if (tags[w] == ref + 1) {
+                frame = tlb_frame[set * TLB_WAYS + w];
+                break;
             }
+        }
+        
+        if (frame != UINT32_MAX) {
+            result->tlb_hits++;
         } else {
-            // Application exited normally, free resources
-            if (sem_wait(process_semaphore) < 0) {
-                perror("sem_wait failed");
+            uint32_t* entry = page_table_entry(pcbs[proc].page_table, vpn);
+            if (*entry != 0) {
+                frame = *entry - 1;
             } else {
-                process_table[index].is_active = 0;
-                process_table[index].is_minimized = 0;
-                process_count--;
-                sem_post(process_semaphore);
+                // Page fault: take a free frame or evict a victim
+                result->faults++;
+                int fresh = used_frames < frames;
+                if (fresh) {
+                    frame = used_frames++;
+                } else {
+                    result->evictions++;
+                    switch (policy) {
+                        case REPLACE_FIFO:
+                            // Frames were filled in order and each victim is
+                            // refilled at once, so the oldest page cycles
+                            frame = hand;
+                            hand = hand + 1 == frames ? 0 : hand + 1;
+                            break;
+                        case REPLACE_LRU:
+                            frame = lru_tail;
+                            break;
+                        case REPLACE_CLOCK:
+                            while (referenced[hand]) {
+                                referenced[hand] = 0;
+                                hand = hand + 1 == frames ? 0 : hand + 1;
+                            }
+                            frame = hand;
+                            hand = hand + 1 == frames ? 0 : hand + 1;
+                            break;
+                        case REPLACE_SECOND_CHANCE:
+                            // Referenced pages move from the head to the tail
+                            for (;;) {
+                                uint32_t candidate = ring[ring_head];
+                                ring_head = ring_head + 1 == frames ? 0 : ring_head + 1;
+                                ring_count--;
+                                if (!referenced[candidate]) {
+                                    frame = candidate;
+                                    break;
+                                }
+                                referenced[candidate] = 0;
+                                uint32_t tail = ring_head + ring_count;
+                                ring[tail >= frames ? tail - frames : tail] = candidate;
+                                ring_count++;
+                            }
+                            break;
+                    }
+                    
+                    // Unmap the victim and shoot down its TLB entry
+                    uint64_t victim = frame_page[frame];
+                    int victim_proc = (int)(victim >> VM_PROC_SHIFT);
+                    uint64_t victim_vpn = victim & VM_VPN_MASK;
+                    *page_table_entry(pcbs[victim_proc].page_table, victim_vpn) = 0;
+                    unsigned int victim_set = (unsigned int)(victim_vpn ^ ((uint64_t)victim_proc * 0x9E3779B1u));
+                    victim_set = sets_are_pow2 ? (victim_set & set_mask) : (victim_set % (unsigned int)tlb_sets);
+                    for (int w = 0; w < TLB_WAYS; w++) {
+                        if (tlb_tag[victim_set * TLB_WAYS + w] == victim + 1) {
+                            tlb_tag[victim_set * TLB_WAYS + w] = 0;
+                        }
+                    }
+                }
+                
+                frame_page[frame] = ref;
+                *entry = frame + 1;
+                referenced[frame] = 0;
+                if (policy == REPLACE_SECOND_CHANCE) {
+                    uint32_t tail = ring_head + ring_count;
+                    ring[tail >= frames ? tail - frames : tail] = frame;
+                    ring_count++;
+                } else if (policy == REPLACE_LRU && fresh) {
+                    // Link a new frame in at the tail, it moves to the head below
+                    lru_prev[frame] = lru_tail;
+                    lru_next[frame] = UINT32_MAX;
+                    if (lru_tail != UINT32_MAX) {
+                        lru_next[lru_tail] = frame;
+                    } else {
+                        lru_head = frame;
+                    }
+                    lru_tail = frame;
+                }
             }
             
-            // Free resources allocated to this process
-            free_resources(index);
-            
-            printf("%s was closed.\n", available_tasks[task_id].name);
-            sleep(2);
+            // Refill the TLB
+            uint8_t way = tlb_victim[set];
+            tlb_victim[set] = (uint8_t)((way + 1) % TLB_WAYS);
+            tags[way] = ref + 1;
+            tlb_frame[set * TLB_WAYS + way] = frame;
         }
         
-        // Clear the screen after the task finishes
-        system("clear");
+        // The hardware sets the accessed bit; LRU keeps exact recency
+        referenced[frame] = 1;
+        if (policy == REPLACE_LRU && frame != lru_head) {
+            uint32_t prev = lru_prev[frame], next = lru_next[frame];
+            lru_next[prev] = next;
+            if (next != UINT32_MAX) {
+                lru_prev[next] = prev;
+            } else {
+                lru_tail = prev;
+            }
+            lru_prev[frame] = UINT32_MAX;
+            lru_next[frame] = lru_head;
+            lru_prev[lru_head] = frame;
+            lru_head = frame;
+        }
+    }
+    
+    result->wall_seconds = (monotonic_ns() - start) / 1e9;
+    result->references = count;
+    
+    for (int p = 0; p < procs; p++) {
+        page_table_free(&tables[p]);
+    }
+    free(pcbs);
+    free(tables);
+    free(frame_page);
+    free(referenced);
+    free(lru_prev);
+    free(lru_next);
+    free(ring);
+    free(tlb_tag);
+    free(tlb_frame);
+    free(tlb_victim);
+}
+
+// Write a synthetic reference string as "<process> <address>" lines
+void generate_vm_trace(long count, const VmConfig* config, unsigned long seed) {
+    uint64_t* refs = generate_vm_references(count, config, seed);
+    if (refs == NULL) {
+        return;
+    }
+    
+    unsigned long long page_bytes = (unsigned long long)config->page_kb * 1024;
+    printf("# NexOS reference string: %ld references, %d processes, %lld MB each\n",
+           count, config->procs, config->space_mb);
+    for (long i = 0; i < count; i++) {
+        printf("%d 0x%llx\n", (int)(refs[i] >> VM_PROC_SHIFT),
+               (unsigned long long)(refs[i] & VM_VPN_MASK) * page_bytes);
+    }
+    free(refs);
+}
+
+void run_vm_simulator(const char* trace_path, long synthetic_refs, const char* policy_name,
+                      const VmConfig* config, unsigned long seed) {
+    long count = synthetic_refs;
+    int procs = config->procs;
+    uint64_t* refs = trace_path != NULL
+                   ? load_vm_references(trace_path, config, &count, &procs)
+                   : generate_vm_references(count, config, seed);
+    if (refs == NULL) {
+        return;
     }
+    
+    ReplacementPolicy policies[] = { REPLACE_FIFO, REPLACE_LRU, REPLACE_CLOCK, REPLACE_SECOND_CHANCE };
+    int num_policies = sizeof(policies) / sizeof(policies[0]);
+    if (strcmp(policy_name, "all") != 0) {
+        if (!parse_replacement_policy(policy_name, &policies[0])) {
+            free(refs);
+            return;
+        }
+        num_policies = 1;
+    }
+    
+    long long frames = config->ram_mb * 1024 / config->page_kb;
+    printf("%s Virtual Memory Simulator\n", OS_NAME);
+    printf("References: %ld from %s, %d processes x %lld MB virtual\n", count,
+           trace_path != NULL ? trace_path : "synthetic generator", procs, config->space_mb);
+    printf("Memory: %lld MB in %lld frames of %d KB, TLB: %d entries, %d-way\n\n",
+           config->ram_mb, frames, config->page_kb, config->tlb_entries, TLB_WAYS);
+    printf("%-14s %14s %12s %14s %12s %16s\n", "Policy", "Faults", "Fault rate",
+           "Evictions", "TLB hits", "Accesses/s");
+    printf("------------------------------------------------------------------------------------\n");
+    
+    for (int p = 0; p < num_policies; p++) {
+        VmResult result;
+        simulate_paging(refs, count, procs, policies[p], config, &result);
+        printf("%-14s %14lld %11.3f%% %14lld %11.2f%% %16.0f\n",
+               replacement_policy_name(policies[p]), result.faults,
+               count > 0 ? 100.0 * result.faults / count : 0.0, result.evictions,
+               count > 0 ? 100.0 * result.tlb_hits / count : 0.0,
+               result.wall_seconds > 0 ? count / result.wall_seconds : 0.0);
+    }
+    
+    free(refs);
 }
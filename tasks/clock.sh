@@ -7,7 +7,7 @@
 # This task displays the current time and system uptime
 # Implements standard close and minimize functionality:
 # - When the task is closed, it exits with code 0
-# - When the task is minimized, it exits with code 10
+# - When the task is minimized, it stops itself with SIGTSTP and NexOS keeps it
 # ----------------
 
 # ##########################################
@@ -61,7 +61,7 @@ while true; do
             2)
                 echo "Minimizing task..."
                 sleep 1
-                exit 10  # Special exit code for minimize
+                kill -TSTP $$  # Stop; NexOS keeps the task and resumes it here
                 ;;
             *)
                 echo "Invalid option. Continuing..."
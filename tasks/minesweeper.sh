@@ -11,6 +11,10 @@
 # GAME LAUNCH
 # ##########################################
 # Launch minesweeper in a new terminal window
+# - The game runs in that window's own shell, outside the process group
+#   NexOS gives this task, so it cannot minimize with kill -TSTP $$ like the
+#   other tasks: NexOS would never see the stop. Its minimize option keeps
+#   the old exit code 10 and only leaves the game window.
 gnome-terminal -- bash -c "
 echo '=== NexOS Minesweeper ==='
 echo 'Type \"options\" for menu or Enter moves to play'
@@ -231,7 +235,7 @@ while ((game_over == 0)); do
             2)
                 echo 'Minimizing task...'
                 sleep 1
-                exit 10  # Special exit code for minimize
+                exit 10  # Old minimize code; see GAME LAUNCH
                 ;;
             *)
                 echo 'Invalid option. Continuing...'
@@ -483,7 +487,7 @@ while ((game_over == 0)); do
             2)
                 echo 'Minimizing task...'
                 sleep 1
-                exit 10  # Special exit code for minimize
+                exit 10  # Old minimize code; see GAME LAUNCH
                 ;;
             *)
                 echo 'Invalid option. Continuing...'
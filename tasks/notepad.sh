@@ -144,7 +144,7 @@ while true; do
             2)
                 echo "Minimizing task..."
                 sleep 1
-                exit 10  # Special exit code for minimize
+                kill -TSTP $$  # Stop; NexOS keeps the task and resumes it here
                 ;;
             *)
                 echo "Invalid option. Continuing..."